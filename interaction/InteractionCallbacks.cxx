@@ -3,6 +3,7 @@
 #include "vtkCamera.h"
 #include "vtkCell.h"
 #include "vtkCellPicker.h"
+#include "vtkDataArray.h"
 #include "vtkInteractorStyle.h"
 #include "vtkPointData.h"
 #include "vtkRenderWindow.h"
@@ -101,8 +102,15 @@ void InteractionCallbacks::VolumeSelectLabel(vtkObject* caller, unsigned long ev
 	int pick = Pick(rwi);
 
 	if (pick) {
-		// Get the label for the pick event
+		// Get the label for the pick event, or the nearest region if the picked data has no labels
 		unsigned short label = PickLabel();
+
+		if (label == 0) {
+			double p[3];
+			PickPosition(p);
+			label = vis->PickNearestLabel(p);
+		}
+
 		vis->SelectRegion(label);
 		vis->Render();
 	}
@@ -298,8 +306,13 @@ unsigned short InteractionCallbacks::PickLabel() {
 
 	if (!data) return 0;
 
+	// Surfaces carry their label as point scalars
+	vtkDataArray* scalars = data->GetPointData()->GetScalars();
+
+	if (!scalars) return 0;
+
 	vtkCell* cell = data->GetCell(picker->GetCellId());
-	vtkVariant value = data->GetPointData()->GetAbstractArray(0)->GetVariantValue(cell->GetPointId(0));
+	vtkVariant value = scalars->GetVariantValue(cell->GetPointId(0));
 
 	return value.ToUnsignedShort();
 }
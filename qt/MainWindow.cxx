@@ -89,6 +89,12 @@ MainWindow::MainWindow() {
 	// Settings dialog
 	settingsDialog = new SettingsDialog(this, visualizationContainer);
 	QObject::connect(settingsDialog, &SettingsDialog::enableDotAnnotationChanged, this, &MainWindow::on_enableDotAnnotationChanged);
+	QObject::connect(settingsDialog, &SettingsDialog::autosaveIntervalChanged, this, &MainWindow::on_autosaveIntervalChanged);
+
+	// Autosave timer
+	autosaveTimer = new QTimer(this);
+	QObject::connect(autosaveTimer, &QTimer::timeout, this, &MainWindow::on_autosave);
+	on_autosaveIntervalChanged(settingsDialog->getAutosaveInterval());
 
 	// Feedback dialog
 	feedbackDialog = new FeedbackDialog(this, visualizationContainer);
@@ -157,6 +163,9 @@ MainWindow::~MainWindow() {
 }
 
 void MainWindow::updateRegions(RegionCollection* regions) {
+	// Voxel counts for all regions in one pass
+	if (visualizationContainer) visualizationContainer->UpdateLabelIndex();
+
 	regionTable->update(regions);
 
 	updateLabels(regions);
@@ -208,7 +217,7 @@ void MainWindow::on_actionOpen_Image_File_triggered() {
 	QString file = QFileDialog::getOpenFileName(this,
 		"Open Volume",
 		getDefaultDirectory(defaultDirectoryKey),
-		"All files (*.*);;NIfTI (*.nii);;TIFF (*.tif *.tiff);;VTK XML ImageData (*.vti)");
+		"All files (*.*);;NIfTI (*.nii *.nii.gz);;TIFF (*.tif *.tiff);;VTK XML ImageData (*.vti);;NRRD (*.nrrd *.nhdr);;Bricked volume (*.bvol)");
 
 	// Check for file
 	if (file == "") {
@@ -322,7 +331,7 @@ void MainWindow::on_actionOpen_Segmentation_File_triggered() {
 	QString file = QFileDialog::getOpenFileName(this,
 		"Open Segmentation Data",
 		getDefaultDirectory(defaultDirectoryKey),
-		"All files (*.*);;NIfTI (*.nii);;TIFF (*.tif *.tiff);;VTK XML ImageData (*.vti)");
+		"All files (*.*);;NIfTI (*.nii *.nii.gz);;TIFF (*.tif *.tiff);;VTK XML ImageData (*.vti);;NRRD (*.nrrd *.nhdr);;Bricked volume (*.bvol)");
 
 	// Check for file
 	if (file == "") {
@@ -338,6 +347,8 @@ void MainWindow::on_actionOpen_Segmentation_File_triggered() {
 		segmentationPath = file;
 
 		setSegmentationNameLabel(QFileInfo(file).fileName());
+
+		recoverEdits();
 	}
 	else {
 		QMessageBox errorMessage;
@@ -410,6 +421,8 @@ void MainWindow::on_actionOpen_Segmentation_Stack_triggered() {
 		segmentationPath = directory.absolutePath();
 
 		setSegmentationNameLabel(directory.dirName());
+
+		recoverEdits();
 	}
 	else {
 		QMessageBox errorMessage;
@@ -444,7 +457,7 @@ void MainWindow::on_actionSave_Image_Data_As_triggered() {
 	QString file = QFileDialog::getSaveFileName(this,
 		"Save Image Data",
 		getDefaultDirectory(defaultDirectoryKey),
-		"All files (*.*);;TIFF (*.tif);;NIfTI (*.nii);;VTK XML ImageData (*.vti)");
+		"All files (*.*);;TIFF (*.tif);;NIfTI (*.nii *.nii.gz);;VTK XML ImageData (*.vti);;Bricked volume (*.bvol)");
 
 	// Check for file
 	if (file == "") {
@@ -521,7 +534,7 @@ void MainWindow::on_actionSave_Segmentation_Data_As_triggered() {
 	QString file = QFileDialog::getSaveFileName(this,
 		"Save Segmentation Data",
 		getDefaultDirectory(defaultDirectoryKey),
-		"All files (*.*);;TIFF (*.tif);;NIfTI (*.nii);;VTK XML ImageData (*.vti)");
+		"All files (*.*);;TIFF (*.tif);;NIfTI (*.nii *.nii.gz);;VTK XML ImageData (*.vti);;Bricked volume (*.bvol)");
 
 	// Check for file
 	if (file == "") {
@@ -838,6 +851,19 @@ void MainWindow::on_brushRadiusSpinBox_valueChanged(int value) {
 	visualizationContainer->SetBrushRadius(value);
 }
 
+void MainWindow::on_autosaveIntervalChanged(int minutes) {
+	if (minutes > 0) {
+		autosaveTimer->start(minutes * 60 * 1000);
+	}
+	else {
+		autosaveTimer->stop();
+	}
+}
+
+void MainWindow::on_autosave() {
+	visualizationContainer->Autosave();
+}
+
 void MainWindow::on_enableDotAnnotationChanged(bool enable) {
 	// Enable apply dot annotation
 	actionApply_Dot_Annotation->setEnabled(enable);
@@ -1043,6 +1069,32 @@ void MainWindow::setImageNameLabel(QString name) {
 	imageNameLabel->setText("Image: " + name);
 }
 
+void MainWindow::recoverEdits() {
+	if (!visualizationContainer->HasEditJournal()) return;
+
+	QMessageBox message;
+	message.setIcon(QMessageBox::Warning);
+	message.setText("Unsaved edits found.");
+	message.setInformativeText(
+		"This segmentation has edits from a session that did not close normally.\n\n"
+		"Do you want to recover them?"
+	);
+	message.setStandardButtons(QMessageBox::Yes | QMessageBox::No);
+	message.setDefaultButton(QMessageBox::Yes);
+
+	if (message.exec() == QMessageBox::Yes) {
+		if (visualizationContainer->RecoverEdits()) return;
+
+		QMessageBox errorMessage;
+		errorMessage.setIcon(QMessageBox::Warning);
+		errorMessage.setText("Could not recover edits.");
+		errorMessage.setInformativeText("The edit journal does not match the segmentation data.");
+		errorMessage.exec();
+	}
+
+	visualizationContainer->DiscardEditJournal();
+}
+
 void MainWindow::setSegmentationNameLabel(QString name) {
 	segmentationNameLabel->setText("Segmentation: " + name);
 }
@@ -8,6 +8,7 @@
 #include <QMainWindow>
 #include <QProgressDialog>
 #include <QSettings>
+#include <QTimer>
 
 #include <string>
 
@@ -145,6 +146,8 @@ public slots:
 	virtual void on_brushRadiusUp();
 
 	virtual void on_enableDotAnnotationChanged(bool enable);
+	virtual void on_autosaveIntervalChanged(int minutes);
+	virtual void on_autosave();
 
 signals:
 
@@ -172,6 +175,9 @@ protected:
 	QString getDefaultDirectory(QString key);
 	void setDefaultDirectory(QString key, QString fileName);
 
+	// Offer to recover edits journaled by a session that did not close normally
+	void recoverEdits();
+
 	// Filename labels
 	void setImageNameLabel(QString name);
 	void setSegmentationNameLabel(QString name);
@@ -197,6 +203,9 @@ protected:
 	SettingsDialog* settingsDialog;
 	FeedbackDialog* feedbackDialog;
 
+	// Autosave
+	QTimer* autosaveTimer;
+
 	// Disable menus
 	void enableMenus(bool enable = true);
 
@@ -1,5 +1,7 @@
 #include "SettingsDialog.h"
 
+#include <QSettings>
+
 #include "VisualizationContainer.h"
 #include "SliceView.h"
 #include "VolumeView.h"
@@ -21,6 +23,22 @@ SettingsDialog::SettingsDialog(QWidget* parent, VisualizationContainer* visualiz
 	QObject::connect(flipXButton, &QPushButton::clicked, this, [this]() { on_flipAxisButton(0); });
 	QObject::connect(flipYButton, &QPushButton::clicked, this, [this]() { on_flipAxisButton(1); });
 	QObject::connect(flipZButton, &QPushButton::clicked, this, [this]() { on_flipAxisButton(2); });
+
+	// Brick cache size persists between sessions
+	brickCacheSizeKey = "brick_cache_size";
+
+	QSettings settings;
+	visualizationContainer->SetBrickCacheSize(settings.value(brickCacheSizeKey, visualizationContainer->GetBrickCacheSize()).toInt());
+
+	// Autosave settings also persist, with the interval applied by the main window
+	autosaveIntervalKey = "autosave_interval";
+	autosaveRetentionKey = "autosave_retention";
+
+	visualizationContainer->SetAutosaveRetention(settings.value(autosaveRetentionKey, visualizationContainer->GetAutosaveRetention()).toInt());
+
+	// Not dependent on the data, so set here
+	autosaveIntervalSpinBox->setValue(getAutosaveInterval());
+	autosaveRetentionSpinBox->setValue(visualizationContainer->GetAutosaveRetention());
 }
 
 SettingsDialog::~SettingsDialog() {
@@ -64,6 +82,14 @@ void SettingsDialog::initializeSettings() {
 
 	// Dot size
 	dotSizeSpinBox->setValue(sliceView->GetDotSize());
+
+	// Brick cache size
+	brickCacheSizeSpinBox->setValue(visualizationContainer->GetBrickCacheSize());
+}
+
+int SettingsDialog::getAutosaveInterval() {
+	QSettings settings;
+	return settings.value(autosaveIntervalKey, 5).toInt();
 }
 
 void SettingsDialog::on_windowSpinBox_valueChanged(double value) {
@@ -102,6 +128,27 @@ void SettingsDialog::on_neighborRadiusSpinBox_valueChanged(double value) {
 	visualizationContainer->SetNeighborRadius(value);
 }
 
+void SettingsDialog::on_brickCacheSizeSpinBox_valueChanged(int value) {
+	visualizationContainer->SetBrickCacheSize(value);
+
+	QSettings settings;
+	settings.setValue(brickCacheSizeKey, value);
+}
+
+void SettingsDialog::on_autosaveIntervalSpinBox_valueChanged(int value) {
+	QSettings settings;
+	settings.setValue(autosaveIntervalKey, value);
+
+	emit autosaveIntervalChanged(value);
+}
+
+void SettingsDialog::on_autosaveRetentionSpinBox_valueChanged(int value) {
+	visualizationContainer->SetAutosaveRetention(value);
+
+	QSettings settings;
+	settings.setValue(autosaveRetentionKey, value);
+}
+
 void SettingsDialog::on_voxelSizeSpinBox() {
 	visualizationContainer->SetVoxelSize(
 		xSizeSpinBox->value(),
@@ -12,6 +12,9 @@ public:
 	virtual ~SettingsDialog();
 
 	void initializeSettings();
+
+	// Minutes between autosaves, zero if disabled
+	int getAutosaveInterval();
 	
 public slots:
 	// Menu events
@@ -33,6 +36,11 @@ public slots:
 
 	virtual void on_neighborRadiusSpinBox_valueChanged(double value);
 
+	virtual void on_brickCacheSizeSpinBox_valueChanged(int value);
+
+	virtual void on_autosaveIntervalSpinBox_valueChanged(int value);
+	virtual void on_autosaveRetentionSpinBox_valueChanged(int value);
+
 	virtual void on_voxelSizeSpinBox();
 
 	virtual void on_windowLevelChanged(double window, double level);
@@ -49,9 +57,14 @@ public slots:
 
 signals:
 	void enableDotAnnotationChanged(bool enable);
+	void autosaveIntervalChanged(int minutes);
 
 protected:
 	VisualizationContainer* visualizationContainer;
+
+	QString brickCacheSizeKey;
+	QString autosaveIntervalKey;
+	QString autosaveRetentionKey;
 };
 
 #endif
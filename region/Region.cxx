@@ -12,28 +12,31 @@
 #include <vtkTextActor.h>
 #include <vtkRenderer.h>
 #include <vtkTextProperty.h>
-#include <vtkThreshold.h>
 
 #include <vtkOutlineFilter.h>
 #include <vtkPolyDataMapper.h>
 
-#include "vtkImageDataCells.h"
-
 #include "LabelColors.h"
+#include "RegionCollection.h"
+#include "VoxelIterator.h"
 #include "RegionInfo.h"
 #include "RegionSurface.h"
-#include "RegionOutline.h"
-#include "RegionVoxelOutlines.h"
 #include "RegionHighlight3D.h"
 #include "RegionCenter3D.h"
 #include "RegionCenter2D.h"
 
 Region::Region(unsigned short regionLabel, double regionColor[3], vtkImageData* inputData, const int* regionExtent) {
+	statsValid = false;
+	showText = false;
+	showCenter = false;
+
 	visible = false;
 	modified = false;
 	done = false;
 	verified = false;
 
+	collection = nullptr;
+
 	// Input data info
 	data = inputData;
 	
@@ -45,20 +48,11 @@ Region::Region(unsigned short regionLabel, double regionColor[3], vtkImageData*
 	color[1] = regionColor[1];
 	color[2] = regionColor[2];
 
-	// Text
-	CreateText();
-	text->SetInput(LabelString().c_str());
-	text->GetTextProperty()->SetColor(color);
-
 	voi = vtkSmartPointer<vtkExtractVOI>::New();
 	voi->SetInputDataObject(data);
 
-	vtkSmartPointer<vtkImageDataCells> cells = vtkSmartPointer<vtkImageDataCells>::New();
-	cells->SetInputConnection(voi->GetOutputPort());
-
-	threshold = vtkSmartPointer<vtkThreshold>::New();
-	threshold->ThresholdBetween(label, label);
-	threshold->SetInputConnection(cells->GetOutputPort());
+	// Render components are created on demand
+	InitializeComponents();
 
 	// Initialize the extent for this region
 	if (regionExtent) {
@@ -68,15 +62,6 @@ Region::Region(unsigned short regionLabel, double regionColor[3], vtkImageData*
 		ComputeExtent();
 	}
 
-	voi->Update();
-
-	surface = new RegionSurface(this, color);
-	outline = new RegionOutline(this, color);
-	voxelOutlines = new RegionVoxelOutlines(this, color);
-	highlight3D = new RegionHighlight3D(this, color);
-	center3D = new RegionCenter3D(this, color);
-	center2D = new RegionCenter2D(this, color);
-
 #ifdef SHOW_REGION_BOX
 	// Outline for testing bounding box
 	vtkSmartPointer<vtkOutlineFilter> boxFilter = vtkSmartPointer<vtkOutlineFilter>::New();
@@ -94,43 +79,43 @@ Region::Region(unsigned short regionLabel, double regionColor[3], vtkImageData*
 #endif
 }
 
-Region::Region(const RegionInfo& info, vtkImageData* inputData) {
+Region::Region(const RegionInfo& info, vtkImageData* inputData, const int* regionExtent) {
+	statsValid = false;
+	showText = false;
+	showCenter = false;
+
+	collection = nullptr;
+
 	// Input data info
 	data = inputData;
 
 	voi = vtkSmartPointer<vtkExtractVOI>::New();
 	voi->SetInputDataObject(data);
 
-	// Text
-	CreateText();
-
-	SetInfo(info);
+	// Render components are created on demand
+	InitializeComponents();
 
-	text->SetInput(LabelString().c_str());
-	text->GetTextProperty()->SetColor(color);
+	if (regionExtent && info.extent[0] < 0) {
+		RegionInfo extentInfo = info;
 
-	vtkSmartPointer<vtkImageDataCells> cells = vtkSmartPointer<vtkImageDataCells>::New();
-	cells->SetInputConnection(voi->GetOutputPort());
-
-	threshold = vtkSmartPointer<vtkThreshold>::New();
-	threshold->ThresholdBetween(label, label);
-	threshold->SetInputConnection(cells->GetOutputPort());
-
-	voi->Update();
+		for (int i = 0; i < 6; i++) {
+			extentInfo.extent[i] = regionExtent[i];
+		}
 
-	surface = new RegionSurface(this, color);
-	outline = new RegionOutline(this, color);
-	voxelOutlines = new RegionVoxelOutlines(this, color);
-	highlight3D = new RegionHighlight3D(this, color);
-	center3D = new RegionCenter3D(this, color);
-	center2D = new RegionCenter2D(this, color);
+		SetInfo(extentInfo);
+	}
+	else {
+		SetInfo(info);
+	}
 }
 	
 Region::~Region() {
 	ClearLabels();
 
-	while (text->GetNumberOfConsumers() > 0) {
-		vtkRenderer::SafeDownCast(text->GetConsumer(0))->RemoveActor(text);
+	if (text) {
+		while (text->GetNumberOfConsumers() > 0) {
+			vtkRenderer::SafeDownCast(text->GetConsumer(0))->RemoveActor(text);
+		}
 	}
 
 #ifdef SHOW_REGION_BOX
@@ -140,8 +125,6 @@ Region::~Region() {
 #endif
 
 	delete surface;
-	delete outline;
-	delete voxelOutlines;
 	delete highlight3D;
 	delete center3D;
 	delete center2D;
@@ -151,8 +134,8 @@ vtkAlgorithmOutput* Region::GetOutput() {
 	return voi->GetOutputPort();
 }
 
-vtkAlgorithmOutput* Region::GetCells() {
-	return threshold->GetOutputPort();
+vtkImageData* Region::GetLabelData() {
+	return data;
 }
 
 vtkSmartPointer<vtkTable> Region::GetPointTable() {	
@@ -170,18 +153,13 @@ vtkSmartPointer<vtkTable> Region::GetPointTable() {
 	z->SetNumberOfComponents(1);
 	z->SetName("z");
 
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			for (int k = extent[4]; k <= extent[5]; k++) {
-				unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, k));
-				if (*p == label) {
-					x->InsertNextValue(i);
-					y->InsertNextValue(j);
-					z->InsertNextValue(k);
-				}
-			}
+	VoxelIterator::ForEach<unsigned short>(data, extent, [&](int i, int j, int k, unsigned short& value) {
+		if (value == label) {
+			x->InsertNextValue(i);
+			y->InsertNextValue(j);
+			z->InsertNextValue(k);
 		}
-	}
+	});
 
 	table->AddColumn(x);
 	table->AddColumn(y);
@@ -191,36 +169,74 @@ vtkSmartPointer<vtkTable> Region::GetPointTable() {
 }
 
 RegionSurface* Region::GetSurface() {
-	return surface;
-}
-
-RegionOutline* Region::GetOutline() {
-	return outline;
-}
+	if (!surface) surface = new RegionSurface(this, CurrentColor());
 
-RegionVoxelOutlines* Region::GetVoxelOutlines() {
-	return voxelOutlines;
+	return surface;
 }
 
 RegionHighlight3D* Region::GetHighlight3D() {
+	if (!highlight3D) highlight3D = new RegionHighlight3D(this, CurrentColor());
+
 	return highlight3D;
 }
 
 RegionCenter3D* Region::GetCenter3D() {
+	if (!center3D) {
+		center3D = new RegionCenter3D(this, CurrentColor());
+		center3D->GetActor()->SetVisibility(showCenter);
+	}
+
 	return center3D;
 }
 
 RegionCenter2D* Region::GetCenter2D() {
+	if (!center2D) {
+		center2D = new RegionCenter2D(this, CurrentColor());
+		center2D->GetActor()->SetVisibility(showCenter);
+	}
+
 	return center2D;
 }
 
 vtkSmartPointer<vtkTextActor> Region::GetText() {
+	if (!text) {
+		CreateText();
+		text->SetInput(LabelString().c_str());
+		text->GetTextProperty()->SetColor(CurrentColor());
+		text->SetVisibility(showText);
+	}
+
 	return text;
 }
 
+bool Region::HasSurface() {
+	return surface != nullptr;
+}
+
+bool Region::HasHighlight3D() {
+	return highlight3D != nullptr;
+}
+
+bool Region::HasCenter3D() {
+	return center3D != nullptr;
+}
+
+bool Region::HasCenter2D() {
+	return center2D != nullptr;
+}
+
+bool Region::HasText() {
+	return text != nullptr;
+}
+
+void Region::ReleaseHighlight3D() {
+	delete highlight3D;
+	highlight3D = nullptr;
+}
+
 vtkSmartPointer<vtkImageData> Region::GetZSlice(int z) {
 	int extent[6];
-	voi->GetOutput()->GetExtent(extent);
+	voi->GetVOI(extent);
 	extent[4] = extent[5] = z;
 
 	vtkSmartPointer<vtkExtractVOI> slice = vtkSmartPointer<vtkExtractVOI>::New();
@@ -243,6 +259,7 @@ void Region::SetExtent(int newExtent[6]) {
 	}
 
 	UpdateExtent();
+	InvalidateSurface();
 }
 
 void Region::UpdateExtent(int x, int y, int z) {
@@ -302,24 +319,18 @@ void Region::ShrinkExtent(const int startExtent[6]) {
 
 	bool hasVoxel = false;
 
-	for (int i = startExtent[0]; i <= startExtent[1]; i++) {
-		for (int j = startExtent[2]; j <= startExtent[3]; j++) {
-			for (int k = startExtent[4]; k <= startExtent[5]; k++) {
-				unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, k));
-
-				if (*p == label) {
-					if (i < extent[0]) extent[0] = i;
-					if (i > extent[1]) extent[1] = i;
-					if (j < extent[2]) extent[2] = j;
-					if (j > extent[3]) extent[3] = j;
-					if (k < extent[4]) extent[4] = k;
-					if (k > extent[5]) extent[5] = k;
-
-					hasVoxel = true;
-				}
-			}
+	VoxelIterator::ForEach<unsigned short>(data, startExtent, [&](int i, int j, int k, unsigned short& value) {
+		if (value == label) {
+			if (i < extent[0]) extent[0] = i;
+			if (i > extent[1]) extent[1] = i;
+			if (j < extent[2]) extent[2] = j;
+			if (j > extent[3]) extent[3] = j;
+			if (k < extent[4]) extent[4] = k;
+			if (k > extent[5]) extent[5] = k;
+
+			hasVoxel = true;
 		}
-	}
+	});
 
 	// Fix extent if no voxels with this label
 	if (!hasVoxel) {
@@ -347,8 +358,12 @@ void Region::UpdateExtent() {
 	padExtent[4] = std::max(dataExtent[4], extent[4] - padding);
 	padExtent[5] = std::min(dataExtent[5], extent[5] + padding);
 
+	// Surfaces are contoured per brick, independent of the extent, and voxel edits invalidate
+	// their own bricks
 	voi->SetVOI(padExtent);
 
+	if (collection) collection->UpdateExtent(this);
+
 	//text->SetPosition(
 //		(padExtent[1] - padExtent[0]) / 2,
 //		(padExtent[3] - padExtent[2]) / 2
@@ -377,6 +392,7 @@ void Region::InitializeExtent(const int* regionExtent) {
 	extent[5] = regionExtent[5];
 
 	UpdateExtent();
+	InvalidateSurface();
 }
 
 void Region::ComputeExtent() {
@@ -430,22 +446,39 @@ void Region::SetColor(double r, double g, double b) {
 	UpdateColor();	
 }
 
-void Region::UpdateColor() {
-	double* currentColor = 
+void Region::SetCollection(RegionCollection* regionCollection) {
+	collection = regionCollection;
+}
+
+void Region::InvalidateSurface() {
+	if (surface) surface->InvalidateContour();
+}
+
+void Region::InvalidateSurface(int x, int y, int z) {
+	if (surface) surface->InvalidateContour(x, y, z);
+}
+
+double* Region::CurrentColor() {
+	return
 		verified ? LabelColors::verifiedColor :
 		done ? LabelColors::doneColor :
 		color;
+}
 
-	text->GetTextProperty()->SetColor(currentColor);
-	surface->GetActor()->GetProperty()->SetColor(currentColor);
-	outline->GetActor()->GetProperty()->SetColor(currentColor);
-	voxelOutlines->GetActor()->GetProperty()->SetColor(currentColor);
-	highlight3D->GetActor()->GetProperty()->SetColor(currentColor);
-	center3D->GetActor()->GetProperty()->SetColor(currentColor);
-	center2D->GetActor()->GetProperty()->SetColor(currentColor);
+void Region::UpdateColor() {
+	double* currentColor = CurrentColor();
+
+	// Components not yet created pick up the color when created
+	if (text) text->GetTextProperty()->SetColor(currentColor);
+	if (surface) surface->GetActor()->GetProperty()->SetColor(currentColor);
+	if (highlight3D) highlight3D->GetActor()->GetProperty()->SetColor(currentColor);
+	if (center3D) center3D->GetActor()->GetProperty()->SetColor(currentColor);
+	if (center2D) center2D->GetActor()->GetProperty()->SetColor(currentColor);
 }
 
 void Region::ShowText(bool show) {
+	showText = show;
+
 	if (!text) return;
 
 	if (show) {
@@ -474,9 +507,24 @@ void Region::ShowText(bool show) {
 	}
 }
 
+bool Region::GetShowCenter() {
+	return showCenter;
+}
+
 void Region::ShowCenter(bool show) {
-	center2D->GetActor()->SetVisibility(show);
-	center3D->GetActor()->SetVisibility(show);
+	showCenter = show;
+
+	if (show) {
+		if (center2D) center2D->GetActor()->VisibilityOn();
+		if (center3D) center3D->GetActor()->VisibilityOn();
+	}
+	else {
+		// Only needed in dot mode
+		delete center2D;
+		delete center3D;
+		center2D = nullptr;
+		center3D = nullptr;
+	}
 }
 
 unsigned short Region::GetLabel() {
@@ -488,35 +536,25 @@ const double* Region::GetColor() {
 }
 
 const double* Region::GetDisplayedColor() {
-	return surface->GetActor()->GetProperty()->GetColor();
+	return CurrentColor();
 }
 
 int Region::GetNumVoxels() {
-	voi->Update();
-
-	vtkImageData* voiData = voi->GetOutput();
-	unsigned short* scalars = static_cast<unsigned short*>(voiData->GetScalarPointer());
-	int numPoints = voiData->GetNumberOfPoints();
-
-	int numVoxels = 0;
-	for (int i = 0; i < numPoints; i++) {
-		if (scalars[i] == label) numVoxels++;
-	}
+	if (!statsValid) UpdateVoxelStats();
 
 	return numVoxels;
 }
 
 int Region::GetNumVoxels(int slice) {
-	int numVoxels = 0;
+	int sliceExtent[6] = { extent[0], extent[1], extent[2], extent[3], slice, slice };
 
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, slice));
-			if (*p == label) numVoxels++;
-		}
-	}
+	int sliceVoxels = 0;
 
-	return numVoxels;
+	VoxelIterator::ForEach<unsigned short>(data, sliceExtent, [&](int, int, int, unsigned short& value) {
+		if (value == label) sliceVoxels++;
+	});
+
+	return sliceVoxels;
 }
 
 const int* Region::GetExtent() {
@@ -529,6 +567,10 @@ void Region::GetExtent(int outExtent[6]) {
 	}
 }
 
+void Region::GetPaddedExtent(int outExtent[6]) {
+	voi->GetVOI(outExtent);
+}
+
 double* Region::GetCenter() {
 	center[0] = (extent[0] + extent[1]) / 2.0;
 	center[1] = (extent[2] + extent[3]) / 2.0;
@@ -537,46 +579,49 @@ double* Region::GetCenter() {
 }
 
 double Region::GetLength() {
-	return voi->GetOutput()->GetLength();
+	// Diagonal of the padded extent, without executing the pipeline
+	int voiExtent[6];
+	voi->GetVOI(voiExtent);
+
+	const double* spacing = data->GetSpacing();
+
+	double length2 = 0.0;
+	for (int i = 0; i < 3; i++) {
+		double d = (voiExtent[2 * i + 1] - voiExtent[2 * i]) * spacing[i];
+		length2 += d * d;
+	}
+
+	return sqrt(length2);
 }
 
 double Region::GetXYDistance(int x, int y, int z) {
 	double distance2 = VTK_DOUBLE_MAX;
 
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, z));
-			if (*p == label) {
-				double dx = x - i;
-				double dy = y - j;
-				double d2 = dx * dx + dy * dy;
+	int sliceExtent[6] = { extent[0], extent[1], extent[2], extent[3], z, z };
 
-				if (d2 < distance2) distance2 = d2;
-			}
+	VoxelIterator::ForEach<unsigned short>(data, sliceExtent, [&](int i, int j, int, unsigned short& value) {
+		if (value == label) {
+			double dx = x - i;
+			double dy = y - j;
+			double d2 = dx * dx + dy * dy;
+
+			if (d2 < distance2) distance2 = d2;
 		}
-	}
+	});
 
 	return sqrt(distance2);
 }
 
 bool Region::GetSeed(double point[3]) {
 	int extent[6];
-	voi->GetOutput()->GetExtent(extent);
+	voi->GetVOI(extent);
 
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			for (int k = extent[4]; k <= extent[5]; k++) {
-				unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, k));
-				if (*p == 0) {
-					int ijk[3] = { i, j, k };
+	int ijk[3];
+	if (VoxelIterator::Find<unsigned short>(data, extent, [](unsigned short value) { return value == 0; }, ijk)) {
+		vtkIdType id = data->ComputePointId(ijk);
+		data->GetPoint(id, point);
 
-					vtkIdType id = voi->GetOutput()->ComputePointId(ijk);
-					voi->GetOutput()->GetPoint(id, point);
-
-					return true;
-				}
-			}
-		}
+		return true;
 	}
 
 	return false;
@@ -584,20 +629,15 @@ bool Region::GetSeed(double point[3]) {
 
 bool Region::GetSeed(double point[3], int z) {
 	int extent[6];
-	voi->GetOutput()->GetExtent(extent);
-
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, z));
-			if (*p == 0) {
-				int ijk[3] = { i, j, z };
+	voi->GetVOI(extent);
+	extent[4] = extent[5] = z;
 
-				vtkIdType id = voi->GetOutput()->ComputePointId(ijk);
-				voi->GetOutput()->GetPoint(id, point);
+	int ijk[3];
+	if (VoxelIterator::Find<unsigned short>(data, extent, [](unsigned short value) { return value == 0; }, ijk)) {
+		vtkIdType id = data->ComputePointId(ijk);
+		data->GetPoint(id, point);
 
-				return true;
-			}
-		}
+		return true;
 	}
 
 	return false;
@@ -606,6 +646,7 @@ bool Region::GetSeed(double point[3], int z) {
 void Region::SetInfo(const RegionInfo& info) {
 	label = info.label;
 
+
 	for (int i = 0; i < 3; i++) {
 		color[i] = info.color[i];
 	}
@@ -622,6 +663,67 @@ void Region::SetInfo(const RegionInfo& info) {
 	done = info.done;
 	verified = info.verified;
 	comment = info.comment;
+
+	if (info.numVoxels >= 0) {
+		SetVoxelStats(info.numVoxels);
+	}
+	else {
+		InvalidateVoxelStats();
+	}
+
+	// Labels may have been restored
+	InvalidateSurface();
+}
+
+bool Region::HasVoxelStats() {
+	return statsValid;
+}
+
+void Region::SetVoxelStats(int count) {
+	numVoxels = count;
+
+	statsValid = true;
+}
+
+void Region::ClearVoxelStats() {
+	numVoxels = 0;
+
+	statsValid = true;
+}
+
+void Region::InvalidateVoxelStats() {
+	statsValid = false;
+}
+
+void Region::AddVoxel(int x, int y, int z) {
+	UpdateExtent(x, y, z);
+	InvalidateSurface(x, y, z);
+
+	if (!statsValid) return;
+
+	numVoxels++;
+}
+
+void Region::RemoveVoxel(int x, int y, int z) {
+	InvalidateSurface(x, y, z);
+
+	if (!statsValid) return;
+
+	numVoxels--;
+}
+
+void Region::UpdateVoxelStats() {
+	voi->Update();
+
+	vtkImageData* voiData = voi->GetOutput();
+	const unsigned short* scalars = static_cast<unsigned short*>(voiData->GetScalarPointer());
+	vtkIdType numPoints = voiData->GetNumberOfPoints();
+
+	ClearVoxelStats();
+
+	for (vtkIdType i = 0; i < numPoints; i++) {
+		if (scalars[i] == label) numVoxels++;
+	}
 }
 
 bool Region::HasComment() {
@@ -635,7 +737,7 @@ const std::string& Region::GetComment() {
 void Region::SetComment(const std::string& commentString) {
 	comment = commentString;
 
-	text->SetInput(LabelString().c_str());
+	if (text) text->SetInput(LabelString().c_str());
 }
 
 void Region::ApplyDot(double dotSize) {
@@ -656,21 +758,27 @@ void Region::ApplyDot(double dotSize) {
 	SetExtent(ext);
 	voi->Update();
 
-	center3D->Update();
-	center2D->Update(center2D->GetActor()->GetPosition()[2], dotSize);
+	SetVoxelStats(1);
+
+	if (center3D) center3D->Update();
+	if (center2D) center2D->Update(center2D->GetActor()->GetPosition()[2], dotSize);
 }
 
 void Region::ClearLabels() {
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			for (int k = extent[4]; k <= extent[5]; k++) {
-				unsigned short* p = static_cast<unsigned short*>(data->GetScalarPointer(i, j, k));
-				if (*p == label) *p = 0;
-			}
-		}
-	}
+	VoxelIterator::ForEach<unsigned short>(data, extent, [&](int, int, int, unsigned short& value) {
+		if (value == label) value = 0;
+	});
 
 	data->Modified();
+
+	InvalidateSurface();
+}
+
+void Region::InitializeComponents() {
+	surface = nullptr;
+	highlight3D = nullptr;
+	center3D = nullptr;
+	center2D = nullptr;
 }
 
 void Region::CreateText() {
@@ -14,14 +14,10 @@ class vtkImageData;
 class vtkPlane;
 class vtkTable;
 class vtkTextActor;
-class vtkThreshold;
-
-class vtkImageDataCells;
 
+class RegionCollection;
 class RegionInfo;
 class RegionSurface;
-class RegionOutline;
-class RegionVoxelOutlines;
 class RegionHighlight3D;
 class RegionCenter3D;
 class RegionCenter2D;
@@ -30,23 +26,31 @@ class Feedback;
 class Region {
 public:
 	Region(unsigned short regionLabel, double regionColor[3], vtkImageData* data, const int* regionExtent = nullptr);
-	Region(const RegionInfo& info, vtkImageData* data);
+	// Region extent is used if the info has no extent
+	Region(const RegionInfo& info, vtkImageData* data, const int* regionExtent = nullptr);
 	~Region();
 
 	vtkAlgorithmOutput* GetOutput();
-	vtkAlgorithmOutput* GetCells();
+	vtkImageData* GetLabelData();
 
 	vtkSmartPointer<vtkTable> GetPointTable();
 
+	// Render components are created on first use
 	RegionSurface* GetSurface();
-	RegionOutline* GetOutline();
-	RegionVoxelOutlines* GetVoxelOutlines();
 	RegionHighlight3D* GetHighlight3D();
 	RegionCenter3D* GetCenter3D();
 	RegionCenter2D* GetCenter2D();
 	vtkSmartPointer<vtkTextActor> GetText();
 	vtkSmartPointer<vtkImageData> GetZSlice(int z);
 
+	bool HasSurface();
+	bool HasHighlight3D();
+	bool HasCenter3D();
+	bool HasCenter2D();
+	bool HasText();
+
+	void ReleaseHighlight3D();
+
 #ifdef SHOW_REGION_BOX
 	vtkSmartPointer<vtkActor> GetBox();
 #endif
@@ -74,6 +78,8 @@ public:
 
 	void ShowText(bool show);
 
+	// Centers are released when hidden
+	bool GetShowCenter();
 	void ShowCenter(bool show);
 
 	unsigned short GetLabel();
@@ -81,41 +87,61 @@ public:
 	int GetNumVoxels(int slice);
 	const int* GetExtent();
 	void GetExtent(int outExtent[6]);
+	void GetPaddedExtent(int outExtent[6]);
 	double* GetCenter();
 	double GetLength();
 
 	double GetXYDistance(int x, int y, int z);
 
+	// First unlabeled voxel of the padded extent in memory order (x fastest), which is the
+	// extent's minimum corner when the padding around the region is unlabeled
 	bool GetSeed(double point[3]);
 	bool GetSeed(double point[3], int z);
 
 	void SetInfo(const RegionInfo& info);
 
+	// Voxel stats are kept up to date by label edits once set or computed
+	bool HasVoxelStats();
+	void SetVoxelStats(int count);
+	void ClearVoxelStats();
+	void InvalidateVoxelStats();
+	void AddVoxel(int x, int y, int z);
+	void RemoveVoxel(int x, int y, int z);
+
 	bool HasComment();
 	const std::string& GetComment();
 	void SetComment(const std::string& commentString);
 
 	void ApplyDot(double dotSize);
 
+	// Collection to notify of extent changes
+	void SetCollection(RegionCollection* regionCollection);
+
 protected:
 	unsigned short label;
 	double color[3];
 	int extent[6];
 	double center[3];
 
+	// Voxel stats
+	bool statsValid;
+	int numVoxels;
+
 	bool visible;
 	bool modified;
 	bool done;
 	bool verified;
 	std::string comment;
 
+	bool showText;
+	bool showCenter;
+
 	vtkSmartPointer<vtkImageData> data;
 	vtkSmartPointer<vtkExtractVOI> voi;
-	vtkSmartPointer<vtkThreshold> threshold;
+
+	RegionCollection* collection;
 
 	RegionSurface* surface;
-	RegionOutline* outline;
-	RegionVoxelOutlines* voxelOutlines;
 	RegionHighlight3D* highlight3D;
 	RegionCenter3D* center3D;
 	RegionCenter2D* center2D;
@@ -129,10 +155,17 @@ protected:
 	void ShrinkExtent(const int startExtent[6]);
 	void UpdateExtent();
 
+	void UpdateVoxelStats();
+
 	void ClearLabels();
 
+	void InvalidateSurface();
+	void InvalidateSurface(int x, int y, int z);
+
+	double* CurrentColor();
 	void UpdateColor();
 
+	void InitializeComponents();
 	void CreateText();
 
 	std::string LabelString();
@@ -0,0 +1,472 @@
+#include "RegionAdjacency.h"
+
+#include <algorithm>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#include "VoxelIterator.h"
+
+namespace {
+	void GrowExtent(int extent[6], int x, int y, int z) {
+		extent[0] = std::min(extent[0], x);
+		extent[1] = std::max(extent[1], x);
+		extent[2] = std::min(extent[2], y);
+		extent[3] = std::max(extent[3], y);
+		extent[4] = std::min(extent[4], z);
+		extent[5] = std::max(extent[5], z);
+	}
+
+	// Mean of a voxel and the voxel at the offset
+	template <class T>
+	double GetMean(const T* p, vtkIdType offset) {
+		return ((double)p[0] + (double)p[offset]) / 2;
+	}
+
+	// Offsets to the 13 voxels after a voxel in memory order that touch it at a face, edge or corner
+	const int contactOffsets[13][3] = {
+		{ 1, 0, 0 },
+		{ -1, 1, 0 }, { 0, 1, 0 }, { 1, 1, 0 },
+		{ -1, -1, 1 }, { 0, -1, 1 }, { 1, -1, 1 },
+		{ -1, 0, 1 }, { 0, 0, 1 }, { 1, 0, 1 },
+		{ -1, 1, 1 }, { 0, 1, 1 }, { 1, 1, 1 }
+	};
+
+	// Normal axis of the face for face contacts, -1 for edge and corner contacts
+	const int contactAxes[13] = { 0, -1, 1, -1, -1, -1, -1, -1, 2, -1, -1, -1, -1 };
+
+	vtkIdType GetOffset(const vtkIdType increments[3], int contact) {
+		const int* o = contactOffsets[contact];
+
+		return o[0] * increments[0] + o[1] * increments[1] + o[2] * increments[2];
+	}
+
+	bool Contains(const int extent[6], const int v[3]) {
+		return v[0] >= extent[0] && v[0] <= extent[1] &&
+			v[1] >= extent[2] && v[1] <= extent[3] &&
+			v[2] >= extent[4] && v[2] <= extent[5];
+	}
+
+	void CountContact(vtkIdType faces[3], vtkIdType& corners, int contact, int count) {
+		int axis = contactAxes[contact];
+
+		if (axis >= 0) faces[axis] += count;
+		else corners += count;
+	}
+}
+
+RegionAdjacency::RegionAdjacency() {
+	valid = false;
+}
+
+RegionAdjacency::~RegionAdjacency() {
+}
+
+void RegionAdjacency::Build(vtkImageData* labels, vtkImageData* data) {
+	this->labels = labels;
+	this->data = data;
+
+	Clear();
+}
+
+void RegionAdjacency::Update() {
+	if (!valid) Rebuild();
+}
+
+void RegionAdjacency::Rebuild() {
+	edges.clear();
+	neighbors.clear();
+
+	if (!labels || !data) return;
+
+	const int* extent = labels->GetExtent();
+
+	// Contacts between each voxel and the voxels after it, with one edge map per thread
+	vtkSMPThreadLocal<std::unordered_map<unsigned int, Edge>> localEdges;
+
+	vtkSMPTools::For(extent[4], extent[5] + 1, [&](vtkIdType begin, vtkIdType end) {
+		std::unordered_map<unsigned int, Edge>& local = localEdges.Local();
+
+		int sliceExtent[6] = { extent[0], extent[1], extent[2], extent[3], (int)begin, (int)end - 1 };
+
+		ForEachContact(sliceExtent, [&](unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity) {
+			// Contacts from below the slices belong to the previous range
+			if (z < begin) return;
+
+			const int* o = contactOffsets[contact];
+			int n[3] = { x + o[0], y + o[1], z + o[2] };
+
+			std::unordered_map<unsigned int, Edge>::iterator it = local.find(Key(a, b));
+
+			if (it == local.end()) {
+				Edge edge;
+				edge.faces[0] = edge.faces[1] = edge.faces[2] = 0;
+				edge.corners = 0;
+				edge.extent[0] = edge.extent[1] = x;
+				edge.extent[2] = edge.extent[3] = y;
+				edge.extent[4] = edge.extent[5] = z;
+				edge.minIntensity = intensity;
+				edge.minValid = true;
+
+				it = local.insert(std::make_pair(Key(a, b), edge)).first;
+			}
+
+			Edge& edge = it->second;
+
+			CountContact(edge.faces, edge.corners, contact, 1);
+			GrowExtent(edge.extent, x, y, z);
+			GrowExtent(edge.extent, n[0], n[1], n[2]);
+			edge.minIntensity = std::min(edge.minIntensity, intensity);
+		});
+	});
+
+	for (vtkSMPThreadLocal<std::unordered_map<unsigned int, Edge>>::iterator it = localEdges.begin(); it != localEdges.end(); ++it) {
+		for (const auto& local : *it) {
+			std::unordered_map<unsigned int, Edge>::iterator edge = edges.find(local.first);
+
+			if (edge == edges.end()) {
+				edges.insert(local);
+				continue;
+			}
+
+			for (int i = 0; i < 3; i++) {
+				edge->second.faces[i] += local.second.faces[i];
+			}
+
+			edge->second.corners += local.second.corners;
+
+			const int* e = local.second.extent;
+			GrowExtent(edge->second.extent, e[0], e[2], e[4]);
+			GrowExtent(edge->second.extent, e[1], e[3], e[5]);
+
+			edge->second.minIntensity = std::min(edge->second.minIntensity, local.second.minIntensity);
+		}
+	}
+
+	for (const auto& edge : edges) {
+		unsigned short a = edge.first >> 16;
+		unsigned short b = edge.first & 0xFFFF;
+
+		neighbors[a].insert(b);
+		neighbors[b].insert(a);
+	}
+
+	valid = true;
+}
+
+void RegionAdjacency::Clear() {
+	edges.clear();
+	neighbors.clear();
+
+	valid = false;
+}
+
+void RegionAdjacency::SetLabel(int x, int y, int z, unsigned short label) {
+	// Nothing to maintain until queried
+	if (!valid) return;
+
+	unsigned short* p = static_cast<unsigned short*>(labels->GetScalarPointer(x, y, z));
+	unsigned short old = *p;
+
+	if (old == label) return;
+
+	const int* extent = labels->GetExtent();
+	int v[3] = { x, y, z };
+
+	vtkIdType increments[3];
+	labels->GetIncrements(increments);
+
+	// All 26 neighbors, as the contact before and after the voxel for each offset
+	for (int contact = 0; contact < 13; contact++) {
+		const int* o = contactOffsets[contact];
+
+		for (int side = -1; side <= 1; side += 2) {
+			int n[3] = { x + side * o[0], y + side * o[1], z + side * o[2] };
+
+			if (!Contains(extent, n)) continue;
+
+			unsigned short neighbor = p[side * GetOffset(increments, contact)];
+
+			if (neighbor == 0) continue;
+
+			// Contacts are indexed by their lower voxel
+			const int* lower = side < 0 ? n : v;
+
+			double intensity = GetContactIntensity(lower[0], lower[1], lower[2], contact);
+
+			if (old != 0 && neighbor != old) RemoveContact(old, neighbor, lower[0], lower[1], lower[2], contact, intensity);
+			if (label != 0 && neighbor != label) AddContact(label, neighbor, lower[0], lower[1], lower[2], contact, intensity);
+		}
+	}
+}
+
+void RegionAdjacency::RemoveContacts(const int extent[6]) {
+	if (!valid) return;
+
+	ForEachContact(extent, [&](unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity) {
+		RemoveContact(a, b, x, y, z, contact, intensity);
+	});
+}
+
+void RegionAdjacency::AddContacts(const int extent[6]) {
+	if (!valid) return;
+
+	ForEachContact(extent, [&](unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity) {
+		AddContact(a, b, x, y, z, contact, intensity);
+	});
+}
+
+void RegionAdjacency::RemoveLabel(unsigned short label) {
+	std::unordered_map<unsigned short, std::set<unsigned short>>::iterator it = neighbors.find(label);
+
+	if (it == neighbors.end()) return;
+
+	for (unsigned short neighbor : it->second) {
+		edges.erase(Key(label, neighbor));
+
+		std::set<unsigned short>& other = neighbors[neighbor];
+		other.erase(label);
+
+		if (other.empty()) neighbors.erase(neighbor);
+	}
+
+	neighbors.erase(it);
+}
+
+std::vector<unsigned short> RegionAdjacency::GetNeighbors(unsigned short label) {
+	Update();
+
+	std::unordered_map<unsigned short, std::set<unsigned short>>::iterator it = neighbors.find(label);
+
+	if (it == neighbors.end()) return std::vector<unsigned short>();
+
+	return std::vector<unsigned short>(it->second.begin(), it->second.end());
+}
+
+bool RegionAdjacency::IsAdjacent(unsigned short a, unsigned short b) {
+	Update();
+
+	return edges.count(Key(a, b)) > 0;
+}
+
+vtkIdType RegionAdjacency::GetFaceCount(unsigned short a, unsigned short b) {
+	Update();
+
+	std::unordered_map<unsigned int, Edge>::iterator it = edges.find(Key(a, b));
+
+	if (it == edges.end()) return 0;
+
+	const vtkIdType* faces = it->second.faces;
+
+	return faces[0] + faces[1] + faces[2];
+}
+
+double RegionAdjacency::GetContactArea(unsigned short a, unsigned short b) {
+	Update();
+
+	std::unordered_map<unsigned int, Edge>::iterator it = edges.find(Key(a, b));
+
+	if (it == edges.end() || !labels) return 0.0;
+
+	const vtkIdType* faces = it->second.faces;
+	const double* s = labels->GetSpacing();
+
+	return faces[0] * s[1] * s[2] + faces[1] * s[0] * s[2] + faces[2] * s[0] * s[1];
+}
+
+double RegionAdjacency::GetMinBoundaryIntensity(unsigned short a, unsigned short b) {
+	Update();
+
+	std::unordered_map<unsigned int, Edge>::iterator it = edges.find(Key(a, b));
+
+	if (it == edges.end()) return VTK_DOUBLE_MAX;
+
+	if (!it->second.minValid) UpdateMinIntensity(a, b, it->second);
+
+	return it->second.minIntensity;
+}
+
+unsigned int RegionAdjacency::Key(unsigned short a, unsigned short b) {
+	return a < b ? ((unsigned int)a << 16) | b : ((unsigned int)b << 16) | a;
+}
+
+double RegionAdjacency::GetContactIntensity(int x, int y, int z, int contact) {
+	vtkDataArray* scalars = data ? data->GetPointData()->GetScalars() : nullptr;
+
+	if (!scalars) return 0.0;
+
+	vtkIdType increments[3];
+	data->GetIncrements(increments);
+
+	// Mean of the voxels on either side
+	switch (scalars->GetDataType()) {
+		vtkTemplateMacro(return GetMean(static_cast<VTK_TT*>(data->GetScalarPointer(x, y, z)), GetOffset(increments, contact)));
+	}
+
+	return 0.0;
+}
+
+void RegionAdjacency::AddContact(unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity) {
+	const int* o = contactOffsets[contact];
+	int n[3] = { x + o[0], y + o[1], z + o[2] };
+
+	std::unordered_map<unsigned int, Edge>::iterator it = edges.find(Key(a, b));
+
+	if (it == edges.end()) {
+		Edge edge;
+		edge.faces[0] = edge.faces[1] = edge.faces[2] = 0;
+		edge.extent[0] = edge.extent[1] = x;
+		edge.extent[2] = edge.extent[3] = y;
+		edge.extent[4] = edge.extent[5] = z;
+		edge.minIntensity = intensity;
+		edge.minValid = true;
+
+		it = edges.insert(std::make_pair(Key(a, b), edge)).first;
+
+		neighbors[a].insert(b);
+		neighbors[b].insert(a);
+	}
+
+	Edge& edge = it->second;
+
+	CountContact(edge.faces, edge.corners, contact, 1);
+	GrowExtent(edge.extent, x, y, z);
+	GrowExtent(edge.extent, n[0], n[1], n[2]);
+
+	if (edge.minValid) edge.minIntensity = std::min(edge.minIntensity, intensity);
+}
+
+void RegionAdjacency::RemoveContact(unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity) {
+	std::unordered_map<unsigned int, Edge>::iterator it = edges.find(Key(a, b));
+
+	if (it == edges.end()) return;
+
+	Edge& edge = it->second;
+
+	CountContact(edge.faces, edge.corners, contact, -1);
+
+	if (edge.faces[0] + edge.faces[1] + edge.faces[2] + edge.corners <= 0) {
+		edges.erase(it);
+
+		neighbors[a].erase(b);
+		neighbors[b].erase(a);
+
+		if (neighbors[a].empty()) neighbors.erase(a);
+		if (neighbors[b].empty()) neighbors.erase(b);
+
+		return;
+	}
+
+	// The minimum may have been this contact
+	if (edge.minValid && intensity <= edge.minIntensity) edge.minValid = false;
+}
+
+template <class Function>
+void RegionAdjacency::ForEachContact(const int extent[6], Function function) {
+	vtkDataArray* scalars = data ? data->GetPointData()->GetScalars() : nullptr;
+
+	if (!scalars) {
+		ForEachContact<unsigned short>(extent, false, function);
+		return;
+	}
+
+	switch (scalars->GetDataType()) {
+		vtkTemplateMacro(ForEachContact<VTK_TT>(extent, true, function));
+	}
+}
+
+template <class T, class Function>
+void RegionAdjacency::ForEachContact(const int extent[6], bool hasData, Function function) {
+	int e[6];
+	if (!VoxelIterator::ClampExtent(labels, extent, e)) return;
+
+	const int* dataExtent = labels->GetExtent();
+
+	vtkIdType increments[3];
+	labels->GetIncrements(increments);
+
+	vtkIdType dataIncrements[3] = { 0, 0, 0 };
+	if (hasData) data->GetIncrements(dataIncrements);
+
+	vtkIdType offsets[13];
+	vtkIdType dataOffsets[13];
+
+	for (int c = 0; c < 13; c++) {
+		offsets[c] = GetOffset(increments, c);
+		dataOffsets[c] = GetOffset(dataIncrements, c);
+	}
+
+	// Contacts to the voxels after each voxel, and to the voxels before it that are outside the extent
+	for (int z = e[4]; z <= e[5]; z++) {
+		for (int y = e[2]; y <= e[3]; y++) {
+			const unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(e[0], y, z));
+			const T* dataRow = hasData ? static_cast<T*>(data->GetScalarPointer(e[0], y, z)) : nullptr;
+
+			for (int x = e[0]; x <= e[1]; x++) {
+				const unsigned short* p = row + (x - e[0]);
+				unsigned short a = *p;
+
+				if (a == 0) continue;
+
+				const T* d = hasData ? dataRow + (x - e[0]) * dataIncrements[0] : nullptr;
+
+				// Voxels before an interior voxel are all in the extent
+				bool boundary = x == e[0] || x == e[1] || y == e[2] || y == e[3] || z == e[4] || z == e[5];
+
+				for (int c = 0; c < 13; c++) {
+					const int* o = contactOffsets[c];
+
+					int n[3] = { x + o[0], y + o[1], z + o[2] };
+
+					if (Contains(dataExtent, n)) {
+						unsigned short b = p[offsets[c]];
+
+						if (b != 0 && a != b) {
+							function(a, b, x, y, z, c, d ? GetMean(d, dataOffsets[c]) : 0.0);
+						}
+					}
+
+					if (!boundary) continue;
+
+					int q[3] = { x - o[0], y - o[1], z - o[2] };
+
+					if (Contains(dataExtent, q) && !Contains(e, q)) {
+						unsigned short b = p[-offsets[c]];
+
+						if (b != 0 && a != b) {
+							function(b, a, q[0], q[1], q[2], c, d ? GetMean(d - dataOffsets[c], dataOffsets[c]) : 0.0);
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+void RegionAdjacency::UpdateMinIntensity(unsigned short a, unsigned short b, Edge& edge) {
+	int extent[6];
+	std::copy(edge.extent, edge.extent + 6, extent);
+
+	edge.minIntensity = VTK_DOUBLE_MAX;
+	edge.extent[0] = edge.extent[2] = edge.extent[4] = VTK_INT_MAX;
+	edge.extent[1] = edge.extent[3] = edge.extent[5] = VTK_INT_MIN;
+
+	// The extent holds both voxels of all contacts of the edge, so contacts leaving it are of other edges
+	unsigned int key = Key(a, b);
+
+	ForEachContact(extent, [&](unsigned short l, unsigned short m, int x, int y, int z, int contact, double intensity) {
+		if (Key(l, m) != key) return;
+
+		const int* o = contactOffsets[contact];
+		int n[3] = { x + o[0], y + o[1], z + o[2] };
+
+		edge.minIntensity = std::min(edge.minIntensity, intensity);
+		GrowExtent(edge.extent, x, y, z);
+		GrowExtent(edge.extent, n[0], n[1], n[2]);
+	});
+
+	edge.minValid = true;
+}
@@ -0,0 +1,90 @@
+#ifndef RegionAdjacency_H
+#define RegionAdjacency_H
+
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+#include <vtkType.h>
+#include <vtkWeakPointer.h>
+
+class vtkImageData;
+
+// Graph of labels touching at a voxel face, edge or corner, so neighbors match a distance of zero.
+// Edges keep shared face counts, contact area, and the minimum intensity along the boundary. Built
+// in one pass on the first query and then kept up to date by label writes, so queries are
+// O(degree). A boundary minimum is recomputed over the boundary's extent only when a contact at
+// the minimum is removed.
+class RegionAdjacency {
+public:
+	RegionAdjacency();
+	~RegionAdjacency();
+
+	// Set the data, with the graph built on the next query
+	void Build(vtkImageData* labels, vtkImageData* data);
+
+	// Drop the graph, so it is built again on the next query
+	void Clear();
+
+	// Call before writing a label to a voxel
+	void SetLabel(int x, int y, int z, unsigned short label);
+
+	// Contacts with a voxel in the extent, called before and after writing labels there
+	void RemoveContacts(const int extent[6]);
+	void AddContacts(const int extent[6]);
+
+	// Call when all voxels of a label are cleared
+	void RemoveLabel(unsigned short label);
+
+	// Queries
+	std::vector<unsigned short> GetNeighbors(unsigned short label);
+	bool IsAdjacent(unsigned short a, unsigned short b);
+	vtkIdType GetFaceCount(unsigned short a, unsigned short b);
+	double GetContactArea(unsigned short a, unsigned short b);
+	double GetMinBoundaryIntensity(unsigned short a, unsigned short b);
+
+protected:
+	struct Edge {
+		// Shared faces by normal axis
+		vtkIdType faces[3];
+
+		// Voxels touching only at an edge or corner
+		vtkIdType corners;
+
+		// Voxels on either side of the contacts, grown as contacts are added
+		int extent[6];
+
+		double minIntensity;
+		bool minValid;
+	};
+
+	vtkWeakPointer<vtkImageData> labels;
+	vtkWeakPointer<vtkImageData> data;
+
+	bool valid;
+
+	std::unordered_map<unsigned int, Edge> edges;
+	std::unordered_map<unsigned short, std::set<unsigned short>> neighbors;
+
+	void Update();
+	void Rebuild();
+
+	static unsigned int Key(unsigned short a, unsigned short b);
+
+	double GetContactIntensity(int x, int y, int z, int contact);
+
+	// Contact between a voxel and one of the 13 voxels after it in memory order
+	void AddContact(unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity);
+	void RemoveContact(unsigned short a, unsigned short b, int x, int y, int z, int contact, double intensity);
+
+	// Called as function(a, b, x, y, z, contact, intensity) for contacts between different nonzero labels
+	template <class Function>
+	void ForEachContact(const int extent[6], Function function);
+
+	template <class T, class Function>
+	void ForEachContact(const int extent[6], bool hasData, Function function);
+
+	void UpdateMinIntensity(unsigned short a, unsigned short b, Edge& edge);
+};
+
+#endif
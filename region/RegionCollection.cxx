@@ -14,6 +14,9 @@ bool RegionCollection::Add(Region* region) {
 
 	regions.insert(std::pair<unsigned short, Region*>(region->GetLabel(), region));
 
+	tree.Insert(region->GetLabel(), region->GetExtent());
+	region->SetCollection(this);
+
 	return true;
 }
 
@@ -30,6 +33,10 @@ void RegionCollection::Remove(unsigned short label) {
 
 	Region* region = regions[label];
 
+	tree.Remove(label);
+	adjacency.RemoveLabel(label);
+	region->SetCollection(nullptr);
+
 	delete region;
 
 	regions.erase(label);
@@ -41,6 +48,9 @@ void RegionCollection::RemoveAll() {
 	}
 
 	regions.clear();
+
+	tree.Clear();
+	adjacency.Clear();
 }
 
 int RegionCollection::Size() {
@@ -67,3 +77,35 @@ unsigned short RegionCollection::GetNewLabel() {
 
 	return label;
 }
+
+void RegionCollection::FindRegions(const int extent[6], std::vector<Region*>& found) {
+	std::vector<unsigned short> labels;
+	tree.FindOverlapping(extent, labels);
+
+	GetRegions(labels, found);
+}
+
+void RegionCollection::FindRegions(const double point[3], const double normal[3], std::vector<Region*>& found) {
+	std::vector<unsigned short> labels;
+	tree.FindIntersectingPlane(point, normal, labels);
+
+	GetRegions(labels, found);
+}
+
+Region* RegionCollection::FindNearestRegion(const double point[3]) {
+	return Get(tree.FindNearest(point));
+}
+
+void RegionCollection::UpdateExtent(Region* region) {
+	tree.Update(region->GetLabel(), region->GetExtent());
+}
+
+RegionAdjacency* RegionCollection::GetAdjacency() {
+	return &adjacency;
+}
+
+void RegionCollection::GetRegions(const std::vector<unsigned short>& labels, std::vector<Region*>& found) {
+	for (unsigned short label : labels) {
+		found.push_back(Get(label));
+	}
+}
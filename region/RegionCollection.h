@@ -2,6 +2,10 @@
 #define RegionCollection_H
 
 #include <map>
+#include <vector>
+
+#include "RegionAdjacency.h"
+#include "RegionTree.h"
 
 class Region;
 
@@ -25,6 +29,17 @@ public:
 
 	unsigned short GetNewLabel();
 
+	// Spatial queries over region extents, in index coordinates
+	void FindRegions(const int extent[6], std::vector<Region*>& found);
+	void FindRegions(const double point[3], const double normal[3], std::vector<Region*>& found);
+	Region* FindNearestRegion(const double point[3]);
+
+	// Called by regions when their extent changes
+	void UpdateExtent(Region* region);
+
+	// Labels sharing voxel faces, kept up to date by label writes
+	RegionAdjacency* GetAdjacency();
+
 	// Traversal
 	typedef CollectionType::iterator Iterator;
 	Iterator Begin();
@@ -33,6 +48,12 @@ public:
 
 protected:
 	CollectionType regions;
+
+	RegionTree tree;
+
+	RegionAdjacency adjacency;
+
+	void GetRegions(const std::vector<unsigned short>& labels, std::vector<Region*>& found);
 };
 
 #endif
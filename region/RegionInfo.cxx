@@ -2,7 +2,7 @@
 
 #include "Region.h"
 
-RegionInfo::RegionInfo() : label(-1), visible(true), modified(false), done(false), verified(false), comment("") {
+RegionInfo::RegionInfo() : label(-1), numVoxels(-1), visible(true), modified(false), done(false), verified(false), comment("") {
 	color[0] = color[1] = color[2] = -1.0;
 	extent[0] = extent[1] = extent[2] = extent[3] = extent[4] = extent[5] = -1;
 }
@@ -18,6 +18,9 @@ RegionInfo::RegionInfo(Region* region) {
 		extent[i] = region->extent[i];
 	}
 
+	// Only store voxel stats if already known, to avoid scanning
+	numVoxels = region->statsValid ? region->numVoxels : -1;
+
 	visible = region->visible;
 	modified = region->modified;
 	done = region->done;
@@ -26,4 +29,31 @@ RegionInfo::RegionInfo(Region* region) {
 }
 	
 RegionInfo::~RegionInfo() {
+}
+
+unsigned short RegionInfo::GetLabel() const {
+	return label;
+}
+
+int RegionInfo::GetNumVoxels() const {
+	return numVoxels;
+}
+
+bool RegionInfo::operator==(const RegionInfo& other) const {
+	for (int i = 0; i < 3; i++) {
+		if (color[i] != other.color[i]) return false;
+	}
+
+	for (int i = 0; i < 6; i++) {
+		if (extent[i] != other.extent[i]) return false;
+	}
+
+	if (numVoxels != other.numVoxels) return false;
+
+	return label == other.label &&
+		visible == other.visible &&
+		modified == other.modified &&
+		done == other.done &&
+		verified == other.verified &&
+		comment == other.comment;
 }
\ No newline at end of file
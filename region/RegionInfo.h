@@ -3,6 +3,8 @@
 
 #include <vtkSmartPointer.h>
 
+#include <string>
+
 class Region;
 class RegionMetadataIO;
 
@@ -12,11 +14,21 @@ public:
 	RegionInfo(Region* region);
 	~RegionInfo();
 
+	unsigned short GetLabel() const;
+
+	// Negative if unknown
+	int GetNumVoxels() const;
+
+	bool operator==(const RegionInfo& other) const;
+
 protected:
 	unsigned short label;
 	double color[3];
 	int extent[6];
 
+	// Voxel count is negative if unknown
+	int numVoxels;
+
 	bool visible;
 	bool modified;
 	bool done;
@@ -1,104 +1,308 @@
 #include "RegionMetadataIO.h"
 
+#include <QDataStream>
+#include <QDateTime>
 #include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
 #include <QJsonDocument>
 #include <QJsonArray>
+#include <QJsonObject>
 
+#include <algorithm>
 #include <iostream>
 #include <string>
 
 #include "RegionInfo.h"
 
+namespace {
+	const quint32 magic = 0x5347524D;
+	const quint32 version = 3;
+
+	// Label, color, extent, voxel count, flags, and comment length
+	const qint64 minRecordSize = 2 + 3 * 8 + 6 * 4 + 4 + 1 + 4;
+
+	// Region flags in binary records
+	enum Flags {
+		Visible = 1,
+		Modified = 2,
+		Done = 4,
+		Verified = 8
+	};
+
+	bool EndsWith(const std::string& s, const std::string& suffix) {
+		return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+	}
+}
+
 RegionMetadataIO::RegionMetadataIO() {
 }
 
 RegionMetadataIO::~RegionMetadataIO() {
 }
 
-std::vector<RegionInfo> RegionMetadataIO::Read(std::string fileName) {
+std::vector<RegionInfo> RegionMetadataIO::Read(std::string fileName, const std::string& segmentationFileName) {
+	QFile file(fileName.c_str());
+
+	if (!file.open(QIODevice::ReadOnly)) {
+		std::cout << "No region metadata file found." << std::endl;
+		return std::vector<RegionInfo>();
+	}
+
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_5_0);
+
+	quint32 fileMagic;
+	stream >> fileMagic;
+
+	// Zero if not stored
+	qint64 fileStamp[2] = { 0, 0 };
+
+	std::vector<RegionInfo> regionData;
+
+	if (stream.status() == QDataStream::Ok && fileMagic == magic) {
+		regionData = ReadBinary(stream, fileStamp);
+	}
+	else {
+		// Legacy JSON
+		file.seek(0);
+
+		regionData = ReadJSON(file.readAll(), fileStamp);
+	}
+
+	qint64 stamp[2];
+	GetStamp(segmentationFileName, stamp);
+
+	if (fileStamp[0] != stamp[0] || fileStamp[1] != stamp[1]) {
+		// Written for other labels, so voxel stats may be stale
+		for (int i = 0; i < (int)regionData.size(); i++) {
+			regionData[i].numVoxels = -1;
+		}
+	}
+
+	return regionData;
+}
+
+bool RegionMetadataIO::Write(std::string fileName, const std::vector<RegionInfo>& regions, const std::string& segmentationFileName) {
+	qint64 stamp[2];
+	GetStamp(segmentationFileName, stamp);
+
+	// Replaced atomically on commit
+	QSaveFile file(fileName.c_str());
+
+	if (!file.open(QIODevice::WriteOnly)) {
+		std::cout << "Could not save region metadata file." << std::endl;
+		return false;
+	}
+
+	if (EndsWith(fileName, ".json")) {
+		file.write(WriteJSON(regions, stamp));
+	}
+	else {
+		QDataStream stream(&file);
+		stream.setVersion(QDataStream::Qt_5_0);
+
+		stream << magic << version << stamp[0] << stamp[1] << (quint32)regions.size();
+
+		for (int i = 0; i < (int)regions.size(); i++) {
+			WriteInfo(stream, regions[i]);
+		}
+	}
+
+	if (!file.commit()) {
+		std::cout << "Could not save region metadata file." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+std::string RegionMetadataIO::GetFileName(const std::string& segmentationFileName) {
+	std::string fileName = segmentationFileName + ".regions";
+	std::string jsonFileName = segmentationFileName + ".json";
+
+	return !QFile::exists(fileName.c_str()) && QFile::exists(jsonFileName.c_str()) ? jsonFileName : fileName;
+}
+
+void RegionMetadataIO::GetStamp(const std::string& segmentationFileName, qint64 stamp[2]) {
+	QFileInfo info(segmentationFileName.c_str());
+
+	stamp[0] = info.exists() ? info.size() : 0;
+	stamp[1] = info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+}
+
+void RegionMetadataIO::WriteInfo(QDataStream& stream, const RegionInfo& info) {
+	stream << (quint16)info.label;
+	stream << info.color[0] << info.color[1] << info.color[2];
+
+	for (int i = 0; i < 6; i++) {
+		stream << (qint32)info.extent[i];
+	}
+
+	stream << (qint32)info.numVoxels;
+
+	quint8 flags =
+		(info.visible ? Visible : 0) |
+		(info.modified ? Modified : 0) |
+		(info.done ? Done : 0) |
+		(info.verified ? Verified : 0);
+
+	stream << flags;
+	stream << QByteArray::fromStdString(info.comment);
+}
+
+void RegionMetadataIO::ReadInfo(QDataStream& stream, RegionInfo& info, bool hasCentroid) {
+	quint16 label;
+	stream >> label;
+	info.label = label;
+
+	stream >> info.color[0] >> info.color[1] >> info.color[2];
+
+	for (int i = 0; i < 6; i++) {
+		qint32 value;
+		stream >> value;
+		info.extent[i] = value;
+	}
+
+	qint32 numVoxels;
+	stream >> numVoxels;
+	info.numVoxels = numVoxels;
+
+	if (hasCentroid) {
+		double centroid[3];
+		stream >> centroid[0] >> centroid[1] >> centroid[2];
+	}
+
+	quint8 flags;
+	stream >> flags;
+
+	info.visible = (flags & Visible) != 0;
+	info.modified = (flags & Modified) != 0;
+	info.done = (flags & Done) != 0;
+
+	// Check done before setting as verified
+	info.verified = info.done && (flags & Verified) != 0;
+
+	QByteArray comment;
+	stream >> comment;
+	info.comment = comment.toStdString();
+}
+
+std::vector<RegionInfo> RegionMetadataIO::ReadBinary(QDataStream& stream, qint64 stamp[2]) {
+	std::vector<RegionInfo> regionData;
+
+	quint32 fileVersion, count;
+	stream >> fileVersion;
+
+	// Version 1 has no stamp, and versions before 3 have a centroid per region
+	if (fileVersion >= 2) stream >> stamp[0] >> stamp[1];
+
+	stream >> count;
+
+	if (stream.status() != QDataStream::Ok || fileVersion < 1 || fileVersion > version) {
+		std::cout << "Unsupported region metadata file." << std::endl;
+		return regionData;
+	}
+
+	// The count is not trusted, so only reserve what the remaining data could hold
+	QIODevice* device = stream.device();
+	qint64 maxCount = device ? device->bytesAvailable() / minRecordSize : 0;
+
+	regionData.reserve((size_t)std::min((qint64)count, maxCount));
+
+	for (quint32 i = 0; i < count; i++) {
+		RegionInfo region;
+		ReadInfo(stream, region, fileVersion < 3);
+
+		if (stream.status() != QDataStream::Ok) break;
+
+		regionData.push_back(region);
+	}
+
+	return regionData;
+}
+
+std::vector<RegionInfo> RegionMetadataIO::ReadJSON(const QByteArray& data, qint64 stamp[2]) {
 	// Return vector
 	std::vector<RegionInfo> regionData;
 
-	QFile file(fileName.c_str());
+	QJsonDocument document(QJsonDocument::fromJson(data));
+	QJsonObject json = document.object();
 
-	if (file.open(QIODevice::ReadOnly)) {
-		QJsonDocument document(QJsonDocument::fromJson(file.readAll()));
-		QJsonObject json = document.object();
+	if (json.contains("segmentationSize") && json.contains("segmentationModified")) {
+		stamp[0] = (qint64)json["segmentationSize"].toDouble();
+		stamp[1] = (qint64)json["segmentationModified"].toDouble();
+	}
 
-		if (json.contains("regions") && json["regions"].isArray()) {
-			QJsonArray regionObjects = json["regions"].toArray();
+	if (json.contains("regions") && json["regions"].isArray()) {
+		QJsonArray regionObjects = json["regions"].toArray();
 
-			for (int i = 0; i < regionObjects.size(); i++) {
-				QJsonObject regionObject = regionObjects[i].toObject();
+		regionData.reserve(regionObjects.size());
 
-				RegionInfo region;
+		for (int i = 0; i < regionObjects.size(); i++) {
+			QJsonObject regionObject = regionObjects[i].toObject();
 
-				if (regionObject.contains("label") && regionObject["label"].isDouble()) {
-					region.label = (unsigned short)regionObject["label"].toDouble();
-				}
-				else {
-					// Skip if no label
-					continue;
-				}
+			RegionInfo region;
 
-				if (regionObject.contains("visible") && regionObject["visible"].isBool()) {
-					region.visible = regionObject["visible"].toBool();
-				}
+			if (regionObject.contains("label") && regionObject["label"].isDouble()) {
+				region.label = (unsigned short)regionObject["label"].toDouble();
+			}
+			else {
+				// Skip if no label
+				continue;
+			}
 
-				if (regionObject.contains("modified") && regionObject["modified"].isBool()) {
-					region.modified = regionObject["modified"].toBool();
-				}
+			if (regionObject.contains("visible") && regionObject["visible"].isBool()) {
+				region.visible = regionObject["visible"].toBool();
+			}
 
-				if (regionObject.contains("done") && regionObject["done"].isBool()) {
-					region.done = regionObject["done"].toBool();
-				}
+			if (regionObject.contains("modified") && regionObject["modified"].isBool()) {
+				region.modified = regionObject["modified"].toBool();
+			}
 
-				if (regionObject.contains("verified") && regionObject["verified"].isBool()) {
-					// Check done before setting as verified
-					region.verified = region.done && regionObject["verified"].toBool();
-				}
+			if (regionObject.contains("done") && regionObject["done"].isBool()) {
+				region.done = regionObject["done"].toBool();
+			}
 
-				if (regionObject.contains("color") && regionObject["color"].isArray()) {
-					QJsonArray color = regionObject["color"].toArray();
+			if (regionObject.contains("verified") && regionObject["verified"].isBool()) {
+				// Check done before setting as verified
+				region.verified = region.done && regionObject["verified"].toBool();
+			}
+
+			if (regionObject.contains("color") && regionObject["color"].isArray()) {
+				QJsonArray color = regionObject["color"].toArray();
 
-					for (int i = 0; i < color.size() && i < 3; i++) {
-						region.color[i] = color[i].toDouble();
-					}
+				for (int i = 0; i < color.size() && i < 3; i++) {
+					region.color[i] = color[i].toDouble();
 				}
+			}
 
-				if (regionObject.contains("extent") && regionObject["extent"].isArray()) {
-					QJsonArray extent = regionObject["extent"].toArray();
+			if (regionObject.contains("extent") && regionObject["extent"].isArray()) {
+				QJsonArray extent = regionObject["extent"].toArray();
 
-					for (int i = 0; i < extent.size() && i < 6; i++) {
-						region.extent[i] = extent[i].toInt();
-					}
+				for (int i = 0; i < extent.size() && i < 6; i++) {
+					region.extent[i] = extent[i].toInt();
 				}
+			}
 
-				if (regionObject.contains("comment") && regionObject["comment"].isString()) {
-					region.comment = regionObject["comment"].toString().toStdString();
-				}
+			if (regionObject.contains("numVoxels") && regionObject["numVoxels"].isDouble()) {
+				region.numVoxels = regionObject["numVoxels"].toInt();
+			}
 
-				regionData.push_back(region);
+			if (regionObject.contains("comment") && regionObject["comment"].isString()) {
+				region.comment = regionObject["comment"].toString().toStdString();
 			}
+
+			regionData.push_back(region);
 		}
 	}
-	else {
-		std::cout << "No region metadata file found." << std::endl;
-	}
 
 	return regionData;
 }
 
-bool RegionMetadataIO::Write(std::string fileName, std::vector<RegionInfo> regions) {
-	QFile file(fileName.c_str());
-
-	if (!file.open(QIODevice::WriteOnly)) {
-		std::cout << "Could not save region metadata file." << std::endl;
-		return false;
-	}
-
+QByteArray RegionMetadataIO::WriteJSON(const std::vector<RegionInfo>& regions, const qint64 stamp[2]) {
 	QJsonArray regionObjects;
-	for (int i = 0; i < (int)regions.size(); i++) {		
+	for (int i = 0; i < (int)regions.size(); i++) {
 		QJsonObject regionObject;
 
 		regionObject["label"] = regions[i].label;
@@ -119,6 +323,11 @@ bool RegionMetadataIO::Write(std::string fileName, std::vector<RegionInfo> regio
 		}
 		regionObject["extent"] = extent;
 
+		// Voxel count, if known
+		if (regions[i].numVoxels >= 0) {
+			regionObject["numVoxels"] = regions[i].numVoxels;
+		}
+
 		regionObject["comment"] = QString::fromStdString(regions[i].comment);
 
 		regionObjects.append(regionObject);
@@ -126,10 +335,8 @@ bool RegionMetadataIO::Write(std::string fileName, std::vector<RegionInfo> regio
 
 	QJsonObject json;
 	json["regions"] = regionObjects;
+	json["segmentationSize"] = (double)stamp[0];
+	json["segmentationModified"] = (double)stamp[1];
 
-	QJsonDocument document(json);
-
-	file.write(document.toJson());
-
-	return true;
-}
\ No newline at end of file
+	return QJsonDocument(json).toJson();
+}
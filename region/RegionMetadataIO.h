@@ -4,18 +4,45 @@
 #include <string>
 #include <vector>
 
-#include <QJsonObject>
+#include <QByteArray>
+
+class QDataStream;
 
 class RegionInfo;
 
+// Region metadata sidecars. The binary format is read and written one region at a time and
+// includes cached voxel stats, so regions can be created without scanning voxels. The JSON
+// format is still read, and written for file names ending in .json.
+//
+// Sidecars store the size and modification time of the segmentation file they were written
+// with. If the segmentation file has changed since, e.g. after a crash between writing the two
+// or an external edit, voxel stats are read as unknown so they are computed from the labels.
 class RegionMetadataIO {
 public:
-	static std::vector<RegionInfo> Read(std::string fileName);
-	static bool Write(std::string fileName, std::vector<RegionInfo> regions);
+	// Detects the format from the file contents
+	static std::vector<RegionInfo> Read(std::string fileName, const std::string& segmentationFileName);
+
+	// Call after writing the segmentation file
+	static bool Write(std::string fileName, const std::vector<RegionInfo>& regions, const std::string& segmentationFileName);
+
+	// Sidecar for a segmentation file, using a legacy JSON sidecar if that is all there is
+	static std::string GetFileName(const std::string& segmentationFileName);
+
+	// Binary record for a single region, with a centroid to skip in records from older versions
+	static void WriteInfo(QDataStream& stream, const RegionInfo& info);
+	static void ReadInfo(QDataStream& stream, RegionInfo& info, bool hasCentroid = false);
 
 private:
 	RegionMetadataIO();
 	~RegionMetadataIO();
+
+	// Size and modification time of the segmentation file, zero if missing
+	static void GetStamp(const std::string& segmentationFileName, qint64 stamp[2]);
+
+	static std::vector<RegionInfo> ReadJSON(const QByteArray& data, qint64 stamp[2]);
+	static std::vector<RegionInfo> ReadBinary(QDataStream& stream, qint64 stamp[2]);
+
+	static QByteArray WriteJSON(const std::vector<RegionInfo>& regions, const qint64 stamp[2]);
 };
 
 #endif
@@ -1,50 +1,137 @@
 #include "RegionSurface.h"
 
 #include <vtkActor.h>
+#include <vtkCellArray.h>
 #include <vtkDiscreteFlyingEdges3D.h>
+#include <vtkFloatArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkImageData.h>
 #include <vtkLookupTable.h>
 #include <vtkPlane.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkPolyDataNormals.h>
 #include <vtkProperty.h>
 #include <vtkRenderer.h>
+#include <vtkSMPTools.h>
+#include <vtkTrivialProducer.h>
+#include <vtkUnsignedShortArray.h>
 #include <vtkWindowedSincPolyDataFilter.h>
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
 #include "Region.h"
 
+namespace {
+	// Bricks of label cells, matching the history bricks
+	const int brickSize = 32;
+
+	void GetBrickGrid(vtkImageData* labels, int numBricks[3]) {
+		for (int i = 0; i < 3; i++) {
+			int numCells = labels->GetDimensions()[i] - 1;
+
+			numBricks[i] = std::max(1, (numCells + brickSize - 1) / brickSize);
+		}
+	}
+
+	vtkIdType BrickKey(const int numBricks[3], int i, int j, int k) {
+		return i + numBricks[0] * ((vtkIdType)j + (vtkIdType)numBricks[1] * k);
+	}
+
+	void GetBrickIndex(const int numBricks[3], vtkIdType key, int b[3]) {
+		b[0] = key % numBricks[0];
+		b[1] = (key / numBricks[0]) % numBricks[1];
+		b[2] = key / ((vtkIdType)numBricks[0] * numBricks[1]);
+	}
+
+	// A brick and the bricks around it
+	void InsertNeighbors(const int numBricks[3], vtkIdType key, std::set<vtkIdType>& bricks) {
+		int b[3];
+		GetBrickIndex(numBricks, key, b);
+
+		for (int k = std::max(0, b[2] - 1); k <= std::min(numBricks[2] - 1, b[2] + 1); k++) {
+			for (int j = std::max(0, b[1] - 1); j <= std::min(numBricks[1] - 1, b[1] + 1); j++) {
+				for (int i = std::max(0, b[0] - 1); i <= std::min(numBricks[0] - 1, b[0] + 1); i++) {
+					bricks.insert(BrickKey(numBricks, i, j, k));
+				}
+			}
+		}
+	}
+
+	// Points on a plane shared by two bricks are generated by both, at identical positions on
+	// half-voxel steps, so only those are merged, keyed by their doubled index coordinates
+	bool GetSeamKey(vtkImageData* labels, const double p[3], long long& key) {
+		const double* origin = labels->GetOrigin();
+		const double* spacing = labels->GetSpacing();
+		const int* dataExtent = labels->GetExtent();
+
+		long long q[3];
+		bool seam = false;
+
+		for (int a = 0; a < 3; a++) {
+			q[a] = std::llround(2.0 * (p[a] - origin[a]) / spacing[a]) - 2 * dataExtent[2 * a];
+
+			if (q[a] % 2 == 0 && q[a] > 0 && (q[a] / 2) % brickSize == 0) seam = true;
+		}
+
+		key = q[0] | (q[1] << 21) | (q[2] << 42);
+
+		return seam;
+	}
+
+	// Discrete flying edges only makes triangles, so unused cell values are filled with degenerate ones
+	void PadCells(vtkIdTypeArray* connectivity, vtkIdType start, vtkIdType numValues, vtkIdType pointId) {
+		vtkIdType* c = connectivity->GetPointer(start);
+
+		for (vtkIdType i = 0; i < numValues; i += 4) {
+			c[i] = 3;
+			c[i + 1] = c[i + 2] = c[i + 3] = pointId;
+		}
+	}
+}
+
 RegionSurface::RegionSurface(Region* inputRegion, double color[3]) {
 	smoothSurface = false;
 	smoothShading = true;
 
 	region = inputRegion;
 
-	contour = vtkSmartPointer<vtkDiscreteFlyingEdges3D>::New();
-	contour->SetValue(0, region->GetLabel());
-	contour->ComputeNormalsOff();
-	contour->ComputeGradientsOff();
-	contour->SetInputConnection(region->GetOutput());
-
-	// Smoother
-	int smoothingIterations = 8;
-	double passBand = 0.01;
-	double featureAngle = 120.0;
-
-	smoother = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
-	smoother->SetNumberOfIterations(smoothingIterations);
-	//smoother->BoundarySmoothingOff();
-	//smoother->FeatureEdgeSmoothingOff();
-	//smoother->SetFeatureAngle(featureAngle);
-	smoother->SetPassBand(passBand);
-	//smoother->NonManifoldSmoothingOn();
-	smoother->NormalizeCoordinatesOn();
-	smoother->SetInputConnection(contour->GetOutputPort());
-
-	normals = vtkSmartPointer<vtkPolyDataNormals>::New();
-	normals->ComputePointNormalsOn();
-	normals->SplittingOff();
+	// Set when contoured
+	contourValid = false;
+
+	AllocateContour();
+
+	contour = vtkSmartPointer<vtkPolyData>::New();
+
+	contourProducer = vtkSmartPointer<vtkTrivialProducer>::New();
+	contourProducer->SetOutput(contour);
 
 	mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
 	mapper->ScalarVisibilityOff();
+
+	// Low detail
+	lowDetail = false;
+	lowDetailTime = 0;
+	lowDetailRequestTime = 0;
+
+	lowDetailContour = vtkSmartPointer<vtkPolyData>::New();
+
+	lowDetailProducer = vtkSmartPointer<vtkTrivialProducer>::New();
+	lowDetailProducer->SetOutput(lowDetailContour);
+
+	lowDetailNormals = vtkSmartPointer<vtkPolyDataNormals>::New();
+	lowDetailNormals->ComputePointNormalsOn();
+	lowDetailNormals->SplittingOff();
+
+	lowDetailMapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+	lowDetailMapper->ScalarVisibilityOff();
+
+	batched = false;
 	
 	actor = vtkSmartPointer<vtkActor>::New();
 	actor->SetMapper(mapper);
@@ -70,70 +157,705 @@ vtkSmartPointer<vtkActor> RegionSurface::GetActor() {
 }
 
 void RegionSurface::SetSmoothSurface(bool smooth) {
+	if (smooth == smoothSurface) return;
+
 	smoothSurface = smooth;
 
-	UpdatePipeline();
+	FinishContour();
 }
 
 void RegionSurface::SetSmoothShading(bool smooth) {
+	if (smooth == smoothShading) return;
+
 	smoothShading = smooth;
 
 	UpdatePipeline();
+
+	// Normals are only kept up to date while shading smoothly
+	if (smoothShading) {
+		FinishContour();
+	}
+	else if (contourValid) {
+		SetContourArrays();
+	}
 }
 
 void RegionSurface::SetRenderMode(RenderMode mode) {
+	ApplyRenderMode(actor->GetProperty(), mode);
+}
+
+void RegionSurface::ApplyRenderMode(vtkProperty* property, RenderMode mode) {
 	switch (mode) {
 	case Normal:
-		actor->GetProperty()->SetRepresentationToSurface();
-		actor->GetProperty()->FrontfaceCullingOff();
-		actor->GetProperty()->LightingOn();
+		property->SetRepresentationToSurface();
+		property->FrontfaceCullingOff();
+		property->LightingOn();
 
 		break;
 
 	case Wireframe:
-		actor->GetProperty()->SetRepresentationToWireframe();
-		actor->GetProperty()->FrontfaceCullingOff();
-		actor->GetProperty()->LightingOn();
+		property->SetRepresentationToWireframe();
+		property->FrontfaceCullingOff();
+		property->LightingOn();
 
 		break;
 
 	case CullFrontFace:
-		actor->GetProperty()->SetRepresentationToSurface();
-		actor->GetProperty()->FrontfaceCullingOn();
-		actor->GetProperty()->LightingOff();
+		property->SetRepresentationToSurface();
+		property->FrontfaceCullingOn();
+		property->LightingOff();
 
 		break;
 	}
 }
 
 bool RegionSurface::IntersectsPlane(double p[3], double n[3]) {
+	if (NeedsContour()) UpdateContour(region->GetLabelData());
+
 	if (!IntersectsBoundingBox(p, n)) return false;
 
 	return IntersectsSurface(p, n);
 }
 
 void RegionSurface::UpdatePipeline() {
-	vtkAlgorithm* surface;
+	// The contour is smoothed and has normals when stitched
+	mapper->SetInputConnection(contourProducer->GetOutputPort());
 
-	if (smoothSurface) {
-		surface = smoother;
+	// Decimated surfaces get their own normals
+	if (smoothShading) {
+		lowDetailNormals->SetInputConnection(lowDetailProducer->GetOutputPort());
+		lowDetailMapper->SetInputConnection(lowDetailNormals->GetOutputPort());
 	}
 	else {
-		surface = contour;
+		lowDetailMapper->SetInputConnection(lowDetailProducer->GetOutputPort());
 	}
+}
 
-	if (smoothShading) {
-		normals->SetInputConnection(surface->GetOutputPort());
-		mapper->SetInputConnection(normals->GetOutputPort());
+vtkPolyData* RegionSurface::GetContour() {
+	return contour;
+}
+
+vtkMTimeType RegionSurface::GetContourTime() {
+	return contour->GetMTime();
+}
+
+bool RegionSurface::HasLowDetailContour() {
+	return contourValid && lowDetailTime == GetContourTime();
+}
+
+bool RegionSurface::NeedsLowDetailContour() {
+	return contourValid && lowDetailTime != GetContourTime() && lowDetailRequestTime != GetContourTime();
+}
+
+void RegionSurface::SetLowDetailContourRequested() {
+	lowDetailRequestTime = GetContourTime();
+}
+
+void RegionSurface::SetLowDetailContour(vtkPolyData* polyData, vtkMTimeType contourTime) {
+	// Stale
+	if (contourTime != GetContourTime()) return;
+
+	lowDetailContour->ShallowCopy(polyData);
+	lowDetailTime = contourTime;
+
+	UpdateMapper();
+}
+
+void RegionSurface::SetLowDetail(bool lowDetail) {
+	this->lowDetail = lowDetail;
+
+	UpdateMapper();
+}
+
+void RegionSurface::SetBatched(bool batched) {
+	this->batched = batched;
+
+	UpdateMapper();
+}
+
+vtkPolyData* RegionSurface::GetOutput() {
+	vtkAlgorithm* output = GetActiveMapper()->GetInputAlgorithm();
+	output->Update();
+
+	return vtkPolyData::SafeDownCast(output->GetOutputDataObject(0));
+}
+
+vtkPolyDataMapper* RegionSurface::GetActiveMapper() {
+	return lowDetail && HasLowDetailContour() ? lowDetailMapper : mapper;
+}
+
+void RegionSurface::UpdateMapper() {
+	vtkPolyDataMapper* current = batched ? nullptr : GetActiveMapper();
+
+	if (actor->GetMapper() != current) actor->SetMapper(current);
+}
+
+bool RegionSurface::NeedsContour() {
+	return !contourValid || !dirtyBricks.empty();
+}
+
+void RegionSurface::InvalidateContour() {
+	contourValid = false;
+	dirtyBricks.clear();
+}
+
+void RegionSurface::InvalidateContour(int x, int y, int z) {
+	if (!contourValid) return;
+
+	vtkImageData* labels = region->GetLabelData();
+
+	int numBricks[3];
+	GetBrickGrid(labels, numBricks);
+
+	// The cells on either side of the voxel along each axis can be in different bricks
+	int ijk[3] = { x, y, z };
+	int range[3][2];
+
+	for (int i = 0; i < 3; i++) {
+		int cell = ijk[i] - labels->GetExtent()[2 * i];
+		int numCells = labels->GetDimensions()[i] - 1;
+
+		range[i][0] = std::max(0, std::min(cell - 1, numCells - 1)) / brickSize;
+		range[i][1] = std::max(0, std::min(cell, numCells - 1)) / brickSize;
+	}
+
+	for (int k = range[2][0]; k <= range[2][1]; k++) {
+		for (int j = range[1][0]; j <= range[1][1]; j++) {
+			for (int i = range[0][0]; i <= range[0][1]; i++) {
+				dirtyBricks.insert(BrickKey(numBricks, i, j, k));
+			}
+		}
+	}
+}
+
+void RegionSurface::UpdateContour(vtkImageData* labels) {
+	std::vector<RegionSurface*> surfaces(1, this);
+
+	UpdateContours(labels, surfaces);
+}
+
+void RegionSurface::UpdateContours(vtkImageData* labels, const std::vector<RegionSurface*>& surfaces) {
+	if (!labels || surfaces.empty()) return;
+
+	int numBricks[3];
+	GetBrickGrid(labels, numBricks);
+
+	const int* dataExtent = labels->GetExtent();
+
+	// Gather bricks up front, as regions are not thread safe
+	struct Task {
+		int surface;
+		unsigned short label;
+		vtkIdType brick;
+		int extent[6];
+	};
+
+	std::vector<Task> tasks;
+
+	auto addTask = [&](int surface, int i, int j, int k) {
+		Task task;
+		task.surface = surface;
+		task.label = surfaces[surface]->region->GetLabel();
+		task.brick = BrickKey(numBricks, i, j, k);
+
+		// Voxels of the brick's cells, sharing a plane with the next brick
+		int b[3] = { i, j, k };
+		for (int a = 0; a < 3; a++) {
+			task.extent[2 * a] = dataExtent[2 * a] + b[a] * brickSize;
+			task.extent[2 * a + 1] = std::min(dataExtent[2 * a + 1], task.extent[2 * a] + brickSize);
+		}
+
+		tasks.push_back(task);
+	};
+
+	for (int s = 0; s < (int)surfaces.size(); s++) {
+		RegionSurface* surface = surfaces[s];
+
+		if (!surface->contourValid) {
+			// All bricks with cells in the region of interest
+			int extent[6];
+			surface->region->GetPaddedExtent(extent);
+
+			int range[3][2];
+			for (int a = 0; a < 3; a++) {
+				int numCells = labels->GetDimensions()[a] - 1;
+
+				range[a][0] = std::max(0, std::min(extent[2 * a] - dataExtent[2 * a] - 1, numCells - 1)) / brickSize;
+				range[a][1] = std::max(0, std::min(extent[2 * a + 1] - dataExtent[2 * a], numCells - 1)) / brickSize;
+			}
+
+			for (int k = range[2][0]; k <= range[2][1]; k++) {
+				for (int j = range[1][0]; j <= range[1][1]; j++) {
+					for (int i = range[0][0]; i <= range[0][1]; i++) {
+						addTask(s, i, j, k);
+					}
+				}
+			}
+		}
+		else {
+			for (vtkIdType key : surface->dirtyBricks) {
+				int b[3];
+				GetBrickIndex(numBricks, key, b);
+
+				addTask(s, b[0], b[1], b[2]);
+			}
+		}
+	}
+
+	std::vector<vtkSmartPointer<vtkPolyData>> contours(tasks.size());
+
+	// Each brick gets its own copy of the labels and its own filter, so no pipeline objects are
+	// shared between threads
+	vtkSMPTools::For(0, (vtkIdType)tasks.size(), [&](vtkIdType begin, vtkIdType end) {
+		for (vtkIdType t = begin; t < end; t++) {
+			Task& task = tasks[t];
+			int* extent = task.extent;
+
+			vtkSmartPointer<vtkImageData> voi = vtkSmartPointer<vtkImageData>::New();
+			voi->SetOrigin(labels->GetOrigin());
+			voi->SetSpacing(labels->GetSpacing());
+			voi->SetExtent(extent);
+			voi->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+
+			int rowLength = extent[1] - extent[0] + 1;
+			bool hasLabel = false;
+
+			for (int k = extent[4]; k <= extent[5]; k++) {
+				for (int j = extent[2]; j <= extent[3]; j++) {
+					unsigned short* row = static_cast<unsigned short*>(voi->GetScalarPointer(extent[0], j, k));
+
+					memcpy(row, labels->GetScalarPointer(extent[0], j, k), rowLength * sizeof(unsigned short));
+
+					if (!hasLabel) hasLabel = std::find(row, row + rowLength, task.label) != row + rowLength;
+				}
+			}
+
+			// Empty bricks have no piece
+			if (!hasLabel) continue;
+
+			vtkSmartPointer<vtkDiscreteFlyingEdges3D> flyingEdges = vtkSmartPointer<vtkDiscreteFlyingEdges3D>::New();
+			flyingEdges->SetValue(0, task.label);
+			flyingEdges->ComputeNormalsOff();
+			flyingEdges->ComputeGradientsOff();
+			flyingEdges->SetInputData(voi);
+			flyingEdges->Update();
+
+			contours[t] = vtkSmartPointer<vtkPolyData>::New();
+			contours[t]->ShallowCopy(flyingEdges->GetOutput());
+		}
+	});
+
+	// Contoured bricks of each surface, with no piece for bricks without the label
+	std::vector<std::map<vtkIdType, vtkSmartPointer<vtkPolyData>>> updates(surfaces.size());
+
+	for (int t = 0; t < (int)tasks.size(); t++) {
+		bool empty = !contours[t] || contours[t]->GetNumberOfPolys() == 0;
+
+		updates[tasks[t].surface][tasks[t].brick] = empty ? nullptr : contours[t];
+	}
+
+	for (int s = 0; s < (int)surfaces.size(); s++) {
+		surfaces[s]->StitchPieces(labels, updates[s]);
+	}
+}
+
+void RegionSurface::StitchPieces(vtkImageData* labels, const std::map<vtkIdType, vtkSmartPointer<vtkPolyData>>& updates) {
+	if (!contourValid) ResetContour();
+
+	int numBricks[3];
+	GetBrickGrid(labels, numBricks);
+
+	// Only changed pieces are patched into the contour, but seams and smoothing also involve their neighbors
+	std::set<vtkIdType> finishBricks;
+	std::vector<vtkIdType> releasedPoints;
+
+	for (const auto& update : updates) {
+		SetPiece(labels, update.first, update.second, releasedPoints);
+
+		if (contourValid) InsertNeighbors(numBricks, update.first, finishBricks);
+	}
+
+	if (!contourValid) {
+		for (const auto& piece : pieces) finishBricks.insert(piece.first);
+	}
+
+	if (pieces.empty()) {
+		ResetContour();
 	}
 	else {
-		mapper->SetInputConnection(surface->GetOutputPort());
+		if (smoothSurface || smoothShading) FinishPieces(labels, finishBricks);
+
+		// Released points that were not reused are unreferenced, so move them onto the surface to keep its bounds
+		vtkIdType reference = pieces.begin()->second.pointIds[0];
+
+		for (vtkIdType id : releasedPoints) {
+			if (labelScalars->GetValue(id) != 0) continue;
+
+			coordinates->SetTuple(id, reference, coordinates);
+			normalVectors->SetTuple(id, reference, normalVectors);
+		}
+
+		// Pack the arrays once edits have left too many holes
+		vtkIdType numPadValues = connectivity->GetNumberOfValues() - numCellValues;
+
+		if (numPadValues > numCellValues || (vtkIdType)freePoints.size() * 2 > coordinates->GetNumberOfTuples()) {
+			CompactContour();
+		}
+	}
+
+	SetContourArrays();
+
+	contourValid = true;
+	dirtyBricks.clear();
+
+	// Full detail until decimated again
+	UpdateMapper();
+}
+
+void RegionSurface::SetPiece(vtkImageData* labels, vtkIdType brick, vtkPolyData* polyData, std::vector<vtkIdType>& releasedPoints) {
+	auto it = pieces.find(brick);
+
+	if (it == pieces.end()) {
+		if (!polyData) return;
+
+		Piece piece;
+		piece.cellStart = 0;
+		piece.cellCapacity = 0;
+
+		it = pieces.insert(std::make_pair(brick, piece)).first;
 	}
+	else {
+		ReleasePoints(it->second, releasedPoints);
+
+		numCellValues -= it->second.polyData->GetPolys()->GetData()->GetNumberOfValues();
+	}
+
+	Piece& piece = it->second;
+
+	if (!polyData) {
+		PadCells(connectivity, piece.cellStart, piece.cellCapacity, piece.pointIds[0]);
+
+		pieces.erase(it);
+
+		return;
+	}
+
+	piece.polyData = polyData;
+
+	AddPoints(labels, piece);
+	WriteCells(piece);
+}
+
+void RegionSurface::AddPoints(vtkImageData* labels, Piece& piece) {
+	vtkPolyData* polyData = piece.polyData;
+
+	piece.pointIds.resize(polyData->GetNumberOfPoints());
+	piece.seamKeys.resize(polyData->GetNumberOfPoints());
+
+	for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); i++) {
+		double p[3];
+		polyData->GetPoint(i, p);
+
+		long long key;
+		bool seam = GetSeamKey(labels, p, key);
+
+		// Kept for release, as keys depend on the spacing when the piece was added
+		piece.seamKeys[i] = seam ? key : -1;
+
+		if (seam) {
+			auto it = seamPoints.find(key);
+
+			if (it != seamPoints.end()) {
+				it->second.count++;
+				piece.pointIds[i] = it->second.id;
+				continue;
+			}
+		}
+
+		vtkIdType id;
+
+		if (!freePoints.empty()) {
+			id = freePoints.back();
+			freePoints.pop_back();
+
+			coordinates->SetTuple(id, p);
+		}
+		else {
+			id = coordinates->InsertNextTuple(p);
+			normalVectors->InsertNextTuple3(0.0, 0.0, 0.0);
+			labelScalars->InsertNextValue(0);
+		}
+
+		labelScalars->SetValue(id, region->GetLabel());
+
+		if (seam) {
+			SeamPoint seamPoint = { id, 1 };
+			seamPoints[key] = seamPoint;
+		}
+
+		piece.pointIds[i] = id;
+	}
+}
+
+void RegionSurface::ReleasePoints(Piece& piece, std::vector<vtkIdType>& releasedPoints) {
+	for (vtkIdType i = 0; i < (vtkIdType)piece.pointIds.size(); i++) {
+		long long key = piece.seamKeys[i];
+
+		if (key >= 0) {
+			auto it = seamPoints.find(key);
+
+			if (it == seamPoints.end()) continue;
+
+			// Still used by the piece on the other side
+			if (--it->second.count > 0) continue;
+
+			seamPoints.erase(it);
+		}
+
+		vtkIdType id = piece.pointIds[i];
+
+		// Free points are marked by label 0
+		labelScalars->SetValue(id, 0);
+
+		freePoints.push_back(id);
+		releasedPoints.push_back(id);
+	}
+}
+
+void RegionSurface::WriteCells(Piece& piece) {
+	// Legacy cell array layout
+	vtkIdTypeArray* cells = piece.polyData->GetPolys()->GetData();
+	vtkIdType numValues = cells->GetNumberOfValues();
+
+	if (numValues > piece.cellCapacity) {
+		// Move to a new block at the end, with room to grow
+		PadCells(connectivity, piece.cellStart, piece.cellCapacity, piece.pointIds[0]);
+
+		piece.cellStart = connectivity->GetNumberOfValues();
+		piece.cellCapacity = numValues + numValues / 16 * 4;
+
+		connectivity->SetNumberOfValues(piece.cellStart + piece.cellCapacity);
+	}
+
+	const vtkIdType* cell = cells->GetPointer(0);
+	const vtkIdType* cellEnd = cell + numValues;
+	vtkIdType* c = connectivity->GetPointer(piece.cellStart);
+
+	while (cell < cellEnd) {
+		vtkIdType n = *cell++;
+		*c++ = n;
+
+		for (vtkIdType i = 0; i < n; i++) {
+			*c++ = piece.pointIds[*cell++];
+		}
+	}
+
+	PadCells(connectivity, piece.cellStart + numValues, piece.cellCapacity - numValues, piece.pointIds[0]);
+
+	numCellValues += numValues;
+}
+
+void RegionSurface::FinishPieces(vtkImageData* labels, const std::set<vtkIdType>& bricks) {
+	int numBricks[3];
+	GetBrickGrid(labels, numBricks);
+
+	// Include the pieces around the finished ones, so they still match their neighbors at the seams
+	std::set<vtkIdType> patchBricks;
+
+	for (vtkIdType brick : bricks) {
+		InsertNeighbors(numBricks, brick, patchBricks);
+	}
+
+	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+	vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+
+	// Contour point ids to patch point ids
+	std::unordered_map<vtkIdType, vtkIdType> patchIds;
+	std::vector<vtkIdType> localIds;
+
+	for (vtkIdType brick : patchBricks) {
+		auto it = pieces.find(brick);
+
+		if (it == pieces.end()) continue;
+
+		const Piece& piece = it->second;
+		vtkPolyData* polyData = piece.polyData;
+
+		localIds.resize(polyData->GetNumberOfPoints());
+
+		for (vtkIdType i = 0; i < polyData->GetNumberOfPoints(); i++) {
+			auto inserted = patchIds.insert(std::make_pair(piece.pointIds[i], points->GetNumberOfPoints()));
+
+			if (inserted.second) points->InsertNextPoint(polyData->GetPoint(i));
+
+			localIds[i] = inserted.first->second;
+		}
+
+		vtkIdTypeArray* cells = polyData->GetPolys()->GetData();
+		const vtkIdType* cell = cells->GetPointer(0);
+		const vtkIdType* cellEnd = cell + cells->GetNumberOfValues();
+
+		while (cell < cellEnd) {
+			vtkIdType n = *cell++;
+			polys->InsertNextCell(n);
+
+			for (vtkIdType i = 0; i < n; i++) {
+				polys->InsertCellPoint(localIds[*cell++]);
+			}
+		}
+	}
+
+	vtkSmartPointer<vtkPolyData> patch = vtkSmartPointer<vtkPolyData>::New();
+	patch->SetPoints(points);
+	patch->SetPolys(polys);
+
+	vtkSmartPointer<vtkPolyData> surface = patch;
+
+	if (smoothSurface) {
+		// Smoother
+		int smoothingIterations = 8;
+		double passBand = 0.01;
+		double featureAngle = 120.0;
+
+		vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother = vtkSmartPointer<vtkWindowedSincPolyDataFilter>::New();
+		smoother->SetNumberOfIterations(smoothingIterations);
+		//smoother->BoundarySmoothingOff();
+		//smoother->FeatureEdgeSmoothingOff();
+		//smoother->SetFeatureAngle(featureAngle);
+		smoother->SetPassBand(passBand);
+		//smoother->NonManifoldSmoothingOn();
+		smoother->NormalizeCoordinatesOn();
+		smoother->SetInputData(patch);
+		smoother->Update();
+
+		surface = smoother->GetOutput();
+	}
+
+	vtkSmartPointer<vtkPolyDataNormals> normals;
+	vtkDataArray* patchNormals = nullptr;
+
+	if (smoothShading) {
+		normals = vtkSmartPointer<vtkPolyDataNormals>::New();
+		normals->ComputePointNormalsOn();
+		normals->SplittingOff();
+		normals->SetInputData(surface);
+		normals->Update();
+
+		patchNormals = normals->GetOutput()->GetPointData()->GetNormals();
+	}
+
+	// Only the finished pieces are written, the others were just there for context
+	for (vtkIdType brick : bricks) {
+		auto it = pieces.find(brick);
+
+		if (it == pieces.end()) continue;
+
+		for (vtkIdType id : it->second.pointIds) {
+			vtkIdType local = patchIds[id];
+
+			coordinates->SetTuple(id, surface->GetPoint(local));
+
+			if (patchNormals) normalVectors->SetTuple(id, local, patchNormals);
+		}
+	}
+}
+
+void RegionSurface::FinishContour() {
+	if (!contourValid || pieces.empty()) return;
+
+	std::set<vtkIdType> bricks;
+
+	for (const auto& piece : pieces) bricks.insert(piece.first);
+
+	FinishPieces(region->GetLabelData(), bricks);
+
+	SetContourArrays();
+}
+
+void RegionSurface::AllocateContour() {
+	coordinates = vtkSmartPointer<vtkFloatArray>::New();
+	coordinates->SetNumberOfComponents(3);
+
+	normalVectors = vtkSmartPointer<vtkFloatArray>::New();
+	normalVectors->SetName("Normals");
+	normalVectors->SetNumberOfComponents(3);
+
+	// Label scalars, for picking
+	labelScalars = vtkSmartPointer<vtkUnsignedShortArray>::New();
+	labelScalars->SetName("Labels");
+
+	connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+
+	freePoints.clear();
+	numCellValues = 0;
+}
+
+void RegionSurface::ResetContour() {
+	pieces.clear();
+	seamPoints.clear();
+
+	AllocateContour();
+}
+
+void RegionSurface::CompactContour() {
+	vtkSmartPointer<vtkFloatArray> oldCoordinates = coordinates;
+	vtkSmartPointer<vtkFloatArray> oldNormalVectors = normalVectors;
+
+	// Renumber points in order of use, and give each piece a new block of cells
+	std::vector<vtkIdType> newIds(oldCoordinates->GetNumberOfTuples(), -1);
+
+	AllocateContour();
+
+	for (auto& it : pieces) {
+		Piece& piece = it.second;
+
+		for (vtkIdType& id : piece.pointIds) {
+			if (newIds[id] < 0) {
+				newIds[id] = coordinates->InsertNextTuple(id, oldCoordinates);
+				normalVectors->InsertNextTuple(id, oldNormalVectors);
+				labelScalars->InsertNextValue(region->GetLabel());
+			}
+
+			id = newIds[id];
+		}
+
+		piece.cellStart = 0;
+		piece.cellCapacity = 0;
+
+		WriteCells(piece);
+	}
+
+	for (auto& it : seamPoints) {
+		it.second.id = newIds[it.second.id];
+	}
+}
+
+void RegionSurface::SetContourArrays() {
+	// Arrays are patched in place, so mark them as modified for the mappers
+	coordinates->Modified();
+	normalVectors->Modified();
+	labelScalars->Modified();
+	connectivity->Modified();
+
+	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+	points->SetData(coordinates);
+
+	vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+	polys->SetCells(connectivity->GetNumberOfValues() / 4, connectivity);
+
+	// Replace in place, so the pipeline sees a modified input
+	contour->Initialize();
+	contour->SetPoints(points);
+	contour->SetPolys(polys);
+	contour->GetPointData()->SetScalars(labelScalars);
+	if (smoothShading) contour->GetPointData()->SetNormals(normalVectors);
+	contour->Modified();
 }
 
 bool RegionSurface::IntersectsBoundingBox(double p[3], double n[3]) {
+	// The actor has no bounds when batched
 	double bb[6];
-	actor->GetBounds(bb);
+	contour->GetBounds(bb);
 
 	// Get points on bounding box
 	double points[8][6] = {
@@ -165,7 +887,9 @@ bool RegionSurface::IntersectsBoundingBox(double p[3], double n[3]) {
 
 bool RegionSurface::IntersectsSurface(double p[3], double n[3]) {
 	// Check all points
-	vtkPolyData* data = mapper->GetInput();
+	vtkPolyData* data = contour;
+
+	if (data->GetNumberOfPoints() == 0) return false;
 
 	// Check if first point is on the plane
 	double d = vtkPlane::Evaluate(n, p, data->GetPoint(0));
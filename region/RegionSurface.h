@@ -3,11 +3,21 @@
 
 #include "vtkSmartPointer.h"
 
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
 class vtkActor;
-class vtkDiscreteFlyingEdges3D;
+class vtkFloatArray;
+class vtkIdTypeArray;
+class vtkImageData;
+class vtkPolyData;
 class vtkPolyDataMapper;
 class vtkPolyDataNormals;
-class vtkWindowedSincPolyDataFilter;
+class vtkProperty;
+class vtkTrivialProducer;
+class vtkUnsignedShortArray;
 
 class Region;
 
@@ -28,23 +38,118 @@ public:
 	};
 
 	void SetRenderMode(RenderMode mode);
+	static void ApplyRenderMode(vtkProperty* property, RenderMode mode);
 
 	bool IntersectsPlane(double p[3], double n[3]);
 
+	// Contours are computed explicitly, and invalidated when the region's voxels change
+	bool NeedsContour();
+	void InvalidateContour();
+	void UpdateContour(vtkImageData* labels);
+
+	// Contours are kept per brick of the label data, so a voxel edit only invalidates the
+	// bricks around it, which are re-contoured and stitched back into the surface
+	void InvalidateContour(int x, int y, int z);
+
+	// Contour many regions in parallel, over all bricks of invalid regions and dirty bricks of others
+	static void UpdateContours(vtkImageData* labels, const std::vector<RegionSurface*>& surfaces);
+
+	// Level of detail. The low detail contour is a decimated copy of the contour, made elsewhere and
+	// only used while it matches the current contour.
+	vtkPolyData* GetContour();
+	vtkMTimeType GetContourTime();
+
+	bool NeedsLowDetailContour();
+	void SetLowDetailContourRequested();
+	void SetLowDetailContour(vtkPolyData* polyData, vtkMTimeType contourTime);
+
+	void SetLowDetail(bool lowDetail);
+
+	// Batched surfaces are drawn by a view with other surfaces, using the actor's properties,
+	// so the actor itself draws nothing
+	void SetBatched(bool batched);
+
+	// Updated output of the active level of detail, for drawing elsewhere
+	vtkPolyData* GetOutput();
+
 protected:
 	Region* region;
 
 	bool smoothSurface;
 	bool smoothShading;
 
-	vtkSmartPointer<vtkDiscreteFlyingEdges3D> contour;
-	vtkSmartPointer<vtkWindowedSincPolyDataFilter> smoother;
-	vtkSmartPointer<vtkPolyDataNormals> normals;
+	bool contourValid;
+
+	// Contour pieces, keyed by brick, with their points and block of cells in the stitched contour
+	struct Piece {
+		vtkSmartPointer<vtkPolyData> polyData;
+		std::vector<vtkIdType> pointIds;
+
+		// Seam key per point, or -1 off seams
+		std::vector<long long> seamKeys;
+
+		vtkIdType cellStart;
+		vtkIdType cellCapacity;
+	};
+
+	std::set<vtkIdType> dirtyBricks;
+	std::map<vtkIdType, Piece> pieces;
+
+	// Points on planes shared by bricks, with the number of pieces using them
+	struct SeamPoint {
+		vtkIdType id;
+		int count;
+	};
+
+	std::unordered_map<long long, SeamPoint> seamPoints;
+
+	// Stitched contour arrays, patched in place when pieces change
+	vtkSmartPointer<vtkFloatArray> coordinates;
+	vtkSmartPointer<vtkFloatArray> normalVectors;
+	vtkSmartPointer<vtkUnsignedShortArray> labelScalars;
+	vtkSmartPointer<vtkIdTypeArray> connectivity;
+
+	std::vector<vtkIdType> freePoints;
+	vtkIdType numCellValues;
+
+	vtkSmartPointer<vtkPolyData> contour;
+	vtkSmartPointer<vtkTrivialProducer> contourProducer;
 	vtkSmartPointer<vtkPolyDataMapper> mapper;
 	vtkSmartPointer<vtkActor> actor;
 
+	bool lowDetail;
+	vtkMTimeType lowDetailTime;
+	vtkMTimeType lowDetailRequestTime;
+
+	vtkSmartPointer<vtkPolyData> lowDetailContour;
+	vtkSmartPointer<vtkTrivialProducer> lowDetailProducer;
+	vtkSmartPointer<vtkPolyDataNormals> lowDetailNormals;
+	vtkSmartPointer<vtkPolyDataMapper> lowDetailMapper;
+
+	bool HasLowDetailContour();
+
+	bool batched;
+
+	vtkPolyDataMapper* GetActiveMapper();
+	void UpdateMapper();
+
 	void UpdatePipeline();
 
+	void StitchPieces(vtkImageData* labels, const std::map<vtkIdType, vtkSmartPointer<vtkPolyData>>& updates);
+	void SetPiece(vtkImageData* labels, vtkIdType brick, vtkPolyData* polyData, std::vector<vtkIdType>& releasedPoints);
+	void AddPoints(vtkImageData* labels, Piece& piece);
+	void ReleasePoints(Piece& piece, std::vector<vtkIdType>& releasedPoints);
+	void WriteCells(Piece& piece);
+
+	// Smooth and compute normals for the given pieces
+	void FinishPieces(vtkImageData* labels, const std::set<vtkIdType>& bricks);
+	void FinishContour();
+
+	void AllocateContour();
+	void ResetContour();
+	void CompactContour();
+	void SetContourArrays();
+
 	bool IntersectsBoundingBox(double p[3], double n[3]);
 	bool IntersectsSurface(double p[3], double n[3]);
 };
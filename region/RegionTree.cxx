@@ -0,0 +1,436 @@
+#include "RegionTree.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+namespace {
+	void Combine(const int a[6], const int b[6], int out[6]) {
+		for (int i = 0; i < 3; i++) {
+			out[2 * i] = std::min(a[2 * i], b[2 * i]);
+			out[2 * i + 1] = std::max(a[2 * i + 1], b[2 * i + 1]);
+		}
+	}
+
+	bool Contains(const int a[6], const int b[6]) {
+		for (int i = 0; i < 3; i++) {
+			if (b[2 * i] < a[2 * i] || b[2 * i + 1] > a[2 * i + 1]) return false;
+		}
+
+		return true;
+	}
+
+	bool Overlaps(const int a[6], const int b[6]) {
+		for (int i = 0; i < 3; i++) {
+			if (b[2 * i] > a[2 * i + 1] || b[2 * i + 1] < a[2 * i]) return false;
+		}
+
+		return true;
+	}
+
+	// Surface area of the voxels covered, the insertion cost
+	double Area(const int a[6]) {
+		double x = a[1] - a[0] + 1;
+		double y = a[3] - a[2] + 1;
+		double z = a[5] - a[4] + 1;
+
+		return 2.0 * (x * y + y * z + z * x);
+	}
+
+	double CombinedArea(const int a[6], const int b[6]) {
+		int c[6];
+		Combine(a, b, c);
+
+		return Area(c);
+	}
+
+	double Volume(const int a[6]) {
+		return (double)(a[1] - a[0] + 1) * (a[3] - a[2] + 1) * (a[5] - a[4] + 1);
+	}
+
+	// Voxels extend half a voxel from their centers
+	bool IntersectsPlane(const int a[6], const double p[3], const double n[3]) {
+		double s = 0.0;
+		double r = 0.0;
+
+		for (int i = 0; i < 3; i++) {
+			double c = (a[2 * i] + a[2 * i + 1]) / 2.0;
+			double h = (a[2 * i + 1] - a[2 * i]) / 2.0 + 0.5;
+
+			s += n[i] * (c - p[i]);
+			r += std::abs(n[i]) * h;
+		}
+
+		return std::abs(s) <= r;
+	}
+
+	double Distance2(const int a[6], const double p[3]) {
+		double d2 = 0.0;
+
+		for (int i = 0; i < 3; i++) {
+			double d = std::max(0.0, std::max(a[2 * i] - p[i], p[i] - a[2 * i + 1]));
+			d2 += d * d;
+		}
+
+		return d2;
+	}
+}
+
+RegionTree::RegionTree(int margin) {
+	this->margin = margin;
+
+	root = -1;
+}
+
+RegionTree::~RegionTree() {
+}
+
+void RegionTree::Insert(unsigned short label, const int extent[6]) {
+	if (leaves.count(label)) {
+		Update(label, extent);
+		return;
+	}
+
+	int leaf = AllocateNode();
+	Node& node = nodes[leaf];
+
+	node.label = label;
+
+	for (int i = 0; i < 6; i++) {
+		node.extent[i] = extent[i];
+		node.box[i] = extent[i] + (i % 2 == 0 ? -margin : margin);
+	}
+
+	leaves[label] = leaf;
+
+	InsertLeaf(leaf);
+}
+
+void RegionTree::Update(unsigned short label, const int extent[6]) {
+	std::unordered_map<unsigned short, int>::iterator it = leaves.find(label);
+
+	if (it == leaves.end()) {
+		Insert(label, extent);
+		return;
+	}
+
+	int leaf = it->second;
+
+	for (int i = 0; i < 6; i++) {
+		nodes[leaf].extent[i] = extent[i];
+	}
+
+	// Still inside the grown box, and not so small within it that queries suffer
+	int grown[6];
+	for (int i = 0; i < 6; i++) {
+		grown[i] = extent[i] + (i % 2 == 0 ? -margin : margin);
+	}
+
+	if (Contains(nodes[leaf].box, extent) && Contains(grown, nodes[leaf].box)) return;
+
+	RemoveLeaf(leaf);
+
+	for (int i = 0; i < 6; i++) {
+		nodes[leaf].box[i] = grown[i];
+	}
+
+	InsertLeaf(leaf);
+}
+
+void RegionTree::Remove(unsigned short label) {
+	std::unordered_map<unsigned short, int>::iterator it = leaves.find(label);
+
+	if (it == leaves.end()) return;
+
+	RemoveLeaf(it->second);
+	FreeNode(it->second);
+
+	leaves.erase(it);
+}
+
+void RegionTree::Clear() {
+	nodes.clear();
+	freeNodes.clear();
+	leaves.clear();
+
+	root = -1;
+}
+
+void RegionTree::FindOverlapping(const int extent[6], std::vector<unsigned short>& labels) {
+	if (root < 0) return;
+
+	std::vector<int> stack(1, root);
+
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!Overlaps(node.box, extent)) continue;
+
+		if (node.IsLeaf()) {
+			if (Overlaps(node.extent, extent)) labels.push_back(node.label);
+		}
+		else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+void RegionTree::FindIntersectingPlane(const double point[3], const double normal[3], std::vector<unsigned short>& labels) {
+	if (root < 0) return;
+
+	std::vector<int> stack(1, root);
+
+	while (!stack.empty()) {
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+
+		if (!IntersectsPlane(node.box, point, normal)) continue;
+
+		if (node.IsLeaf()) {
+			if (IntersectsPlane(node.extent, point, normal)) labels.push_back(node.label);
+		}
+		else {
+			stack.push_back(node.child1);
+			stack.push_back(node.child2);
+		}
+	}
+}
+
+unsigned short RegionTree::FindNearest(const double point[3]) {
+	if (root < 0) return 0;
+
+	// Best first, with leaves requeued at their exact distance, ordered by distance then volume
+	struct Entry {
+		double distance;
+		double volume;
+		int node;
+		bool exact;
+
+		bool operator<(const Entry& other) const {
+			return distance != other.distance ? distance > other.distance : volume > other.volume;
+		}
+	};
+
+	std::priority_queue<Entry> queue;
+
+	Entry first = { Distance2(nodes[root].box, point), 0.0, root, false };
+	queue.push(first);
+
+	while (!queue.empty()) {
+		Entry entry = queue.top();
+		queue.pop();
+
+		const Node& node = nodes[entry.node];
+
+		if (entry.exact) return node.label;
+
+		if (node.IsLeaf()) {
+			Entry exact = { Distance2(node.extent, point), Volume(node.extent), entry.node, true };
+			queue.push(exact);
+		}
+		else {
+			Entry child1 = { Distance2(nodes[node.child1].box, point), 0.0, node.child1, false };
+			Entry child2 = { Distance2(nodes[node.child2].box, point), 0.0, node.child2, false };
+			queue.push(child1);
+			queue.push(child2);
+		}
+	}
+
+	return 0;
+}
+
+int RegionTree::AllocateNode() {
+	int node;
+
+	if (freeNodes.empty()) {
+		node = (int)nodes.size();
+		nodes.push_back(Node());
+	}
+	else {
+		node = freeNodes.back();
+		freeNodes.pop_back();
+	}
+
+	nodes[node].parent = -1;
+	nodes[node].child1 = -1;
+	nodes[node].child2 = -1;
+	nodes[node].height = 0;
+	nodes[node].label = 0;
+
+	return node;
+}
+
+void RegionTree::FreeNode(int node) {
+	freeNodes.push_back(node);
+}
+
+void RegionTree::InsertLeaf(int leaf) {
+	if (root < 0) {
+		root = leaf;
+		nodes[root].parent = -1;
+		return;
+	}
+
+	// Copied, as allocating the parent may move nodes
+	int box[6];
+	std::copy(nodes[leaf].box, nodes[leaf].box + 6, box);
+
+	// Descend to the sibling with the least increase in surface area
+	int index = root;
+
+	while (!nodes[index].IsLeaf()) {
+		const Node& node = nodes[index];
+
+		double area = Area(node.box);
+		double combinedArea = CombinedArea(node.box, box);
+
+		// Cost of a new parent here, and the increase pushed down to the children
+		double cost = 2.0 * combinedArea;
+		double inheritance = 2.0 * (combinedArea - area);
+
+		auto childCost = [&](int child) {
+			const Node& c = nodes[child];
+			double newArea = CombinedArea(c.box, box);
+
+			return c.IsLeaf() ? newArea + inheritance : newArea - Area(c.box) + inheritance;
+		};
+
+		double cost1 = childCost(node.child1);
+		double cost2 = childCost(node.child2);
+
+		if (cost < cost1 && cost < cost2) break;
+
+		index = cost1 < cost2 ? node.child1 : node.child2;
+	}
+
+	int sibling = index;
+
+	// New parent for the sibling and the leaf
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	Combine(box, nodes[sibling].box, nodes[newParent].box);
+
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent < 0) {
+		root = newParent;
+	}
+	else if (nodes[oldParent].child1 == sibling) {
+		nodes[oldParent].child1 = newParent;
+	}
+	else {
+		nodes[oldParent].child2 = newParent;
+	}
+
+	Refit(nodes[leaf].parent);
+}
+
+void RegionTree::RemoveLeaf(int leaf) {
+	if (leaf == root) {
+		root = -1;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	// The sibling takes the parent's place
+	if (grandParent < 0) {
+		root = sibling;
+		nodes[sibling].parent = -1;
+	}
+	else {
+		if (nodes[grandParent].child1 == parent) {
+			nodes[grandParent].child1 = sibling;
+		}
+		else {
+			nodes[grandParent].child2 = sibling;
+		}
+
+		nodes[sibling].parent = grandParent;
+
+		Refit(grandParent);
+	}
+
+	FreeNode(parent);
+
+	nodes[leaf].parent = -1;
+}
+
+void RegionTree::Refit(int node) {
+	// Fix heights and boxes up to the root, rotating where unbalanced
+	while (node >= 0) {
+		node = Balance(node);
+
+		Node& n = nodes[node];
+
+		n.height = 1 + std::max(nodes[n.child1].height, nodes[n.child2].height);
+		Combine(nodes[n.child1].box, nodes[n.child2].box, n.box);
+
+		node = n.parent;
+	}
+}
+
+int RegionTree::Balance(int a) {
+	// Rotate the taller child of a up, if the heights of a's children differ by more than one.
+	// Returns the node now in a's place.
+	if (nodes[a].IsLeaf() || nodes[a].height < 2) return a;
+
+	int b = nodes[a].child1;
+	int c = nodes[a].child2;
+
+	int balance = nodes[c].height - nodes[b].height;
+
+	if (balance > 1) {
+		std::swap(b, c);
+	}
+	else if (balance >= -1) {
+		return a;
+	}
+
+	// b is the taller child, rotate it up
+	int f = nodes[b].child1;
+	int g = nodes[b].child2;
+
+	nodes[b].child1 = a;
+	nodes[b].parent = nodes[a].parent;
+	nodes[a].parent = b;
+
+	if (nodes[b].parent < 0) {
+		root = b;
+	}
+	else if (nodes[nodes[b].parent].child1 == a) {
+		nodes[nodes[b].parent].child1 = b;
+	}
+	else {
+		nodes[nodes[b].parent].child2 = b;
+	}
+
+	// Keep the taller grandchild under b
+	if (nodes[f].height < nodes[g].height) std::swap(f, g);
+
+	nodes[b].child2 = f;
+
+	// a keeps c and takes the shorter grandchild
+	nodes[a].child1 = c;
+	nodes[a].child2 = g;
+	nodes[g].parent = a;
+
+	Combine(nodes[c].box, nodes[g].box, nodes[a].box);
+	nodes[a].height = 1 + std::max(nodes[c].height, nodes[g].height);
+
+	Combine(nodes[a].box, nodes[f].box, nodes[b].box);
+	nodes[b].height = 1 + std::max(nodes[a].height, nodes[f].height);
+
+	return b;
+}
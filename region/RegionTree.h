@@ -0,0 +1,66 @@
+#ifndef RegionTree_H
+#define RegionTree_H
+
+#include <unordered_map>
+#include <vector>
+
+// Dynamic bounding volume hierarchy over region extents, keyed by label. Leaves are stored with
+// their extent grown by a margin, so regions growing a little at a time while painting are only
+// reinserted when they leave it. Queries test the exact extents at the leaves. The tree is kept
+// balanced with rotations, so queries and updates are logarithmic in the number of regions.
+class RegionTree {
+public:
+	RegionTree(int margin = 4);
+	~RegionTree();
+
+	void Insert(unsigned short label, const int extent[6]);
+	void Update(unsigned short label, const int extent[6]);
+	void Remove(unsigned short label);
+	void Clear();
+
+	// Labels with extents overlapping the extent
+	void FindOverlapping(const int extent[6], std::vector<unsigned short>& labels);
+
+	// Labels with voxels that may intersect a plane, in index coordinates
+	void FindIntersectingPlane(const double point[3], const double normal[3], std::vector<unsigned short>& labels);
+
+	// Label with extent nearest the point in index coordinates, preferring smaller extents among
+	// those containing it. Returns 0 if empty.
+	unsigned short FindNearest(const double point[3]);
+
+protected:
+	struct Node {
+		// Grown for leaves, union of children otherwise
+		int box[6];
+
+		// Exact extent for leaves
+		int extent[6];
+
+		int parent;
+		int child1;
+		int child2;
+		int height;
+
+		unsigned short label;
+
+		bool IsLeaf() const { return child1 < 0; }
+	};
+
+	std::vector<Node> nodes;
+	std::vector<int> freeNodes;
+	int root;
+
+	std::unordered_map<unsigned short, int> leaves;
+
+	int margin;
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int node);
+	void Refit(int node);
+};
+
+#endif
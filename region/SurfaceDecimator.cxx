@@ -0,0 +1,112 @@
+#include "SurfaceDecimator.h"
+
+#include <vtkCleanPolyData.h>
+#include <vtkPolyData.h>
+#include <vtkQuadricDecimation.h>
+
+SurfaceDecimator::SurfaceDecimator(double targetReduction, int minimumTriangles) {
+	this->targetReduction = targetReduction;
+	this->minimumTriangles = minimumTriangles;
+
+	quit = false;
+
+	thread = std::thread(&SurfaceDecimator::Run, this);
+}
+
+SurfaceDecimator::~SurfaceDecimator() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		pending.clear();
+		quit = true;
+	}
+
+	condition.notify_one();
+
+	thread.join();
+}
+
+void SurfaceDecimator::Add(unsigned short label, vtkMTimeType contourTime, vtkPolyData* contour) {
+	Result job;
+	job.label = label;
+	job.contourTime = contourTime;
+
+	// Deep copy, as surfaces patch their contour arrays in place after edits
+	job.polyData = vtkSmartPointer<vtkPolyData>::New();
+	job.polyData->DeepCopy(contour);
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		pending[label] = job;
+	}
+
+	condition.notify_one();
+}
+
+std::vector<SurfaceDecimator::Result> SurfaceDecimator::TakeResults() {
+	std::vector<Result> results;
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	results.swap(finished);
+
+	return results;
+}
+
+void SurfaceDecimator::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	pending.clear();
+	finished.clear();
+}
+
+void SurfaceDecimator::Run() {
+	while (true) {
+		Result job;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			condition.wait(lock, [this]() { return quit || !pending.empty(); });
+
+			if (quit) return;
+
+			job = pending.begin()->second;
+			pending.erase(pending.begin());
+		}
+
+		job.polyData = Decimate(job.polyData);
+
+		std::lock_guard<std::mutex> lock(mutex);
+
+		finished.push_back(job);
+	}
+}
+
+vtkSmartPointer<vtkPolyData> SurfaceDecimator::Decimate(vtkPolyData* contour) {
+	// Drop the degenerate cells padding the stitched contour, and its unused points
+	vtkSmartPointer<vtkCleanPolyData> clean = vtkSmartPointer<vtkCleanPolyData>::New();
+	clean->PointMergingOff();
+	clean->ConvertPolysToLinesOff();
+	clean->ConvertLinesToPointsOff();
+	clean->SetInputData(contour);
+	clean->Update();
+
+	vtkSmartPointer<vtkPolyData> cleaned = vtkSmartPointer<vtkPolyData>::New();
+	cleaned->ShallowCopy(clean->GetOutput());
+
+	// Not worth decimating
+	if (cleaned->GetNumberOfPolys() < minimumTriangles) return cleaned;
+
+	vtkSmartPointer<vtkQuadricDecimation> decimation = vtkSmartPointer<vtkQuadricDecimation>::New();
+	decimation->SetTargetReduction(targetReduction);
+	decimation->VolumePreservationOn();
+	decimation->SetInputData(cleaned);
+	decimation->Update();
+
+	vtkSmartPointer<vtkPolyData> output = vtkSmartPointer<vtkPolyData>::New();
+	output->ShallowCopy(decimation->GetOutput());
+
+	return output;
+}
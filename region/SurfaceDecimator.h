@@ -0,0 +1,55 @@
+#ifndef SurfaceDecimator_H
+#define SurfaceDecimator_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+
+class vtkPolyData;
+
+// Decimates region surface contours on a worker thread. Jobs are keyed by region label and stamped
+// with the contour modified time, so results can be matched to current surfaces on the GUI
+// thread without the worker holding pointers to regions. A newer job for a label replaces a
+// pending one.
+class SurfaceDecimator {
+public:
+	struct Result {
+		unsigned short label;
+		vtkMTimeType contourTime;
+		vtkSmartPointer<vtkPolyData> polyData;
+	};
+
+	SurfaceDecimator(double targetReduction = 0.9, int minimumTriangles = 2000);
+
+	// Cancels pending jobs and waits for the job in flight
+	~SurfaceDecimator();
+
+	// The contour's arrays must not be modified afterwards, as the worker reads them
+	void Add(unsigned short label, vtkMTimeType contourTime, vtkPolyData* contour);
+
+	// Finished results, oldest first
+	std::vector<Result> TakeResults();
+
+	void Clear();
+
+protected:
+	double targetReduction;
+	int minimumTriangles;
+
+	std::thread thread;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool quit;
+
+	std::map<unsigned short, Result> pending;
+	std::vector<Result> finished;
+
+	void Run();
+	vtkSmartPointer<vtkPolyData> Decimate(vtkPolyData* contour);
+};
+
+#endif
@@ -0,0 +1,101 @@
+#include "AutosaveWriter.h"
+
+#include <algorithm>
+
+#include <QDir>
+#include <QFile>
+
+#include "BrickedVolumeIO.h"
+#include "RegionMetadataIO.h"
+
+AutosaveWriter::AutosaveWriter(int retention) : busy(false) {
+	this->retention = std::max(1, retention);
+	nextSlot = 0;
+}
+
+AutosaveWriter::~AutosaveWriter() {
+	Wait();
+}
+
+bool AutosaveWriter::IsBusy() {
+	return busy;
+}
+
+bool AutosaveWriter::Start(Job& job) {
+	if (busy) return false;
+
+	// Finished, so joins immediately
+	if (thread.joinable()) thread.join();
+
+	// Slots for a different file start over
+	if (job.fileName != slotFileName) {
+		slotFileName = job.fileName;
+		slotLabels.clear();
+		nextSlot = 0;
+	}
+
+	// Remove slots beyond the retention
+	int staleBegin = retention;
+	int staleEnd = std::max(retention, (int)slotLabels.size());
+
+	slotLabels.resize(retention);
+
+	if (nextSlot >= retention) nextSlot = 0;
+
+	int slot = nextSlot;
+	nextSlot = (nextSlot + 1) % retention;
+
+	busy = true;
+
+	Job workerJob;
+	workerJob.fileName = GetSlotFileName(job.fileName, slot);
+	std::copy(job.dimensions, job.dimensions + 3, workerJob.dimensions);
+	std::copy(job.spacing, job.spacing + 3, workerJob.spacing);
+	workerJob.labels.swap(job.labels);
+	workerJob.brickSize = job.brickSize;
+	workerJob.metadata.swap(job.metadata);
+
+	thread = std::thread(&AutosaveWriter::Write, this, std::move(workerJob), slot, staleBegin, staleEnd);
+
+	return true;
+}
+
+void AutosaveWriter::Wait() {
+	if (thread.joinable()) thread.join();
+}
+
+int AutosaveWriter::GetRetention() {
+	return retention;
+}
+
+void AutosaveWriter::SetRetention(int retention) {
+	// Applied when the next save starts
+	this->retention = std::max(1, retention);
+}
+
+std::string AutosaveWriter::GetSlotFileName(const std::string& fileName, int slot) {
+	return fileName + ".autosave" + std::to_string(slot + 1) + ".bvol";
+}
+
+void AutosaveWriter::Write(Job job, int slot, int staleBegin, int staleEnd) {
+	LabelBricks::Snapshot& previous = slotLabels[slot];
+
+	if (BrickedVolumeIO::WriteLabels(job.fileName, job.dimensions, job.spacing, job.labels, job.brickSize, previous.empty() ? nullptr : &previous) &&
+		RegionMetadataIO::Write(job.fileName + ".regions", job.metadata, job.fileName)) {
+		previous.swap(job.labels);
+	}
+	else {
+		// Write everything next time
+		previous.clear();
+	}
+
+	for (int i = staleBegin; i < staleEnd; i++) {
+		std::string fileName = GetSlotFileName(slotFileName, i);
+
+		QFile::remove(fileName.c_str());
+		QFile::remove((fileName + ".regions").c_str());
+		QDir(BrickedVolumeIO::GetBrickDirectory(fileName).c_str()).removeRecursively();
+	}
+
+	busy = false;
+}
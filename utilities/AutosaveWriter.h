@@ -0,0 +1,58 @@
+#ifndef AutosaveWriter_H
+#define AutosaveWriter_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LabelBricks.h"
+#include "RegionInfo.h"
+
+// Writes autosaves as bricked volumes on a worker thread. Jobs hold snapshots taken on the GUI
+// thread, so the worker never touches live label data. Saves rotate through a number of retained
+// slots, each written incrementally against the last snapshot written to it.
+class AutosaveWriter {
+public:
+	struct Job {
+		// Base file name for the slots
+		std::string fileName;
+
+		int dimensions[3];
+		double spacing[3];
+		LabelBricks::Snapshot labels;
+		int brickSize;
+		std::vector<RegionInfo> metadata;
+	};
+
+	AutosaveWriter(int retention = 3);
+
+	// Waits for any save in flight
+	~AutosaveWriter();
+
+	bool IsBusy();
+
+	// Returns immediately, moving the job to the worker. Returns false if a save is in flight.
+	bool Start(Job& job);
+	void Wait();
+
+	int GetRetention();
+	void SetRetention(int retention);
+
+	static std::string GetSlotFileName(const std::string& fileName, int slot);
+
+protected:
+	std::thread thread;
+	std::atomic<bool> busy;
+
+	int retention;
+	int nextSlot;
+
+	// Last snapshot written to each slot, only accessed by the worker while busy
+	std::string slotFileName;
+	std::vector<LabelBricks::Snapshot> slotLabels;
+
+	void Write(Job job, int slot, int staleBegin, int staleEnd);
+};
+
+#endif
@@ -0,0 +1,75 @@
+#include "BrickCache.h"
+
+BrickCache::BrickCache(size_t maxMemory) : maxMemory(maxMemory), memorySize(0) {
+}
+
+BrickCache::~BrickCache() {
+}
+
+BrickCache::BrickPointer BrickCache::Get(vtkIdType key) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	std::unordered_map<vtkIdType, BrickList::iterator>::iterator it = index.find(key);
+
+	if (it == index.end()) return nullptr;
+
+	// Move to front
+	bricks.splice(bricks.begin(), bricks, it->second);
+
+	return it->second->second;
+}
+
+void BrickCache::Insert(vtkIdType key, const BrickPointer& brick) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (maxMemory == 0 || index.count(key) > 0) return;
+
+	bricks.push_front(std::make_pair(key, brick));
+	index[key] = bricks.begin();
+	memorySize += brick->size();
+
+	Evict();
+}
+
+void BrickCache::Clear() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	bricks.clear();
+	index.clear();
+	memorySize = 0;
+}
+
+size_t BrickCache::GetMaxMemory() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return maxMemory;
+}
+
+void BrickCache::SetMaxMemory(size_t memory) {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	maxMemory = memory;
+
+	Evict();
+}
+
+size_t BrickCache::GetMemorySize() {
+	std::lock_guard<std::mutex> lock(mutex);
+
+	return memorySize;
+}
+
+void BrickCache::Evict() {
+	// Keep the most recent brick even if over the limit, so a single large brick can be used
+	while (bricks.size() > 1 && memorySize > maxMemory) {
+		memorySize -= bricks.back().second->size();
+		index.erase(bricks.back().first);
+		bricks.pop_back();
+	}
+
+	if (maxMemory == 0) {
+		bricks.clear();
+		index.clear();
+		memorySize = 0;
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef BrickCache_H
+#define BrickCache_H
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <vtkType.h>
+
+// Least recently used cache of uncompressed bricks with a memory cap. Thread safe.
+class BrickCache {
+public:
+	typedef std::shared_ptr<const std::vector<unsigned char>> BrickPointer;
+
+	// A maximum memory of zero disables caching
+	BrickCache(size_t maxMemory);
+	~BrickCache();
+
+	// Returns nullptr if not cached
+	BrickPointer Get(vtkIdType key);
+	void Insert(vtkIdType key, const BrickPointer& brick);
+	void Clear();
+
+	size_t GetMaxMemory();
+	void SetMaxMemory(size_t maxMemory);
+
+	size_t GetMemorySize();
+
+protected:
+	typedef std::list<std::pair<vtkIdType, BrickPointer>> BrickList;
+
+	// Most recently used first
+	BrickList bricks;
+	std::unordered_map<vtkIdType, BrickList::iterator> index;
+
+	size_t maxMemory;
+	size_t memorySize;
+
+	std::mutex mutex;
+
+	void Evict();
+};
+
+#endif
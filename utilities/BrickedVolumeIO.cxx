@@ -0,0 +1,412 @@
+#include "BrickedVolumeIO.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <set>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkZLibDataCompressor.h>
+
+namespace {
+	// Generation zero is the unversioned name
+	QString BrickFileName(const std::string& fileName, const int brickIndex[3], int generation) {
+		QString name = QString("%1/%2_%3_%4")
+			.arg(BrickedVolumeIO::GetBrickDirectory(fileName).c_str())
+			.arg(brickIndex[0]).arg(brickIndex[1]).arg(brickIndex[2]);
+
+		return generation > 0 ? name + QString(".%1").arg(generation) : name;
+	}
+
+	void GetBrickIndex(vtkIdType index, const int numBricks[3], int brickIndex[3]) {
+		brickIndex[0] = (int)(index % numBricks[0]);
+		brickIndex[1] = (int)(index / numBricks[0] % numBricks[1]);
+		brickIndex[2] = (int)(index / ((vtkIdType)numBricks[0] * numBricks[1]));
+	}
+
+	bool WriteBrickFile(const QString& name, vtkZLibDataCompressor* compressor, const unsigned char* brick, size_t size, std::vector<unsigned char>& compressed) {
+		compressed.resize(compressor->GetMaximumCompressionSpace(size));
+		size_t compressedSize = compressor->Compress(brick, size, compressed.data(), compressed.size());
+
+		QFile file(name);
+
+		return compressedSize > 0 && file.open(QIODevice::WriteOnly) &&
+			file.write((const char*)compressed.data(), compressedSize) == (qint64)compressedSize;
+	}
+
+	// Replaces the manifest atomically
+	bool WriteManifest(const std::string& fileName, const BrickedVolumeIO::Manifest& manifest) {
+		QJsonObject json;
+		json["format"] = "bvol";
+		json["version"] = manifest.generation > 0 ? 2 : 1;
+		json["dimensions"] = QJsonArray({ manifest.dimensions[0], manifest.dimensions[1], manifest.dimensions[2] });
+		json["spacing"] = QJsonArray({ manifest.spacing[0], manifest.spacing[1], manifest.spacing[2] });
+		json["scalarType"] = manifest.scalarType;
+		json["brickSize"] = manifest.brickSize;
+		json["compression"] = "zlib";
+
+		if (manifest.generation > 0) {
+			QJsonArray generations;
+			for (int i = 0; i < (int)manifest.brickGenerations.size(); i++) {
+				generations.append(manifest.brickGenerations[i]);
+			}
+
+			json["generation"] = manifest.generation;
+			json["bricks"] = generations;
+		}
+
+		QSaveFile file(fileName.c_str());
+
+		if (!file.open(QIODevice::WriteOnly)) return false;
+
+		file.write(QJsonDocument(json).toJson());
+
+		return file.commit();
+	}
+
+	// Compress and write each brick of image data, in parallel over bricks
+	class WriteBricks {
+	public:
+		WriteBricks(const std::string& fileName, vtkImageData* data, const BrickedVolumeIO::Manifest& manifest)
+		: success(true), fileName(fileName), data(data), manifest(manifest) {
+			BrickedVolumeIO::GetNumberOfBricks(manifest, numBricks);
+		}
+
+		void operator()(vtkIdType begin, vtkIdType end) {
+			vtkSmartPointer<vtkZLibDataCompressor> compressor = vtkSmartPointer<vtkZLibDataCompressor>::New();
+
+			int scalarSize = data->GetScalarSize();
+			std::vector<unsigned char> brick;
+			std::vector<unsigned char> compressed;
+
+			for (vtkIdType index = begin; index < end; index++) {
+				int brickIndex[3];
+				GetBrickIndex(index, numBricks, brickIndex);
+
+				int brickExtent[6];
+				BrickedVolumeIO::GetBrickExtent(manifest, brickIndex, brickExtent);
+
+				size_t rowSize = (size_t)(brickExtent[1] - brickExtent[0] + 1) * scalarSize;
+				size_t numRows = (size_t)(brickExtent[3] - brickExtent[2] + 1) * (brickExtent[5] - brickExtent[4] + 1);
+
+				brick.resize(rowSize * numRows);
+
+				// Copy rows, checking for an empty brick
+				bool empty = true;
+				unsigned char* p = brick.data();
+
+				for (int k = brickExtent[4]; k <= brickExtent[5]; k++) {
+					for (int j = brickExtent[2]; j <= brickExtent[3]; j++, p += rowSize) {
+						memcpy(p, data->GetScalarPointer(brickExtent[0], j, k), rowSize);
+					}
+				}
+
+				for (size_t i = 0; i < brick.size() && empty; i++) {
+					if (brick[i] != 0) empty = false;
+				}
+
+				QString name = BrickFileName(fileName, brickIndex, 0);
+
+				if (empty) {
+					// Remove any stale brick from a previous save
+					if (QFile::exists(name)) QFile::remove(name);
+					continue;
+				}
+
+				if (!WriteBrickFile(name, compressor, brick.data(), brick.size(), compressed)) {
+					success = false;
+				}
+			}
+		}
+
+		std::atomic<bool> success;
+
+	protected:
+		const std::string& fileName;
+		vtkImageData* data;
+		const BrickedVolumeIO::Manifest& manifest;
+		int numBricks[3];
+	};
+
+	// Compress and write label bricks from a snapshot, in parallel over the given bricks
+	class WriteLabelBricks {
+	public:
+		WriteLabelBricks(const std::string& fileName, const LabelBricks::Snapshot& bricks, const std::vector<vtkIdType>& indices, const BrickedVolumeIO::Manifest& manifest)
+		: success(true), fileName(fileName), bricks(bricks), indices(indices), manifest(manifest) {
+			BrickedVolumeIO::GetNumberOfBricks(manifest, numBricks);
+		}
+
+		void operator()(vtkIdType begin, vtkIdType end) {
+			vtkSmartPointer<vtkZLibDataCompressor> compressor = vtkSmartPointer<vtkZLibDataCompressor>::New();
+
+			std::vector<unsigned char> compressed;
+
+			for (vtkIdType i = begin; i < end; i++) {
+				vtkIdType index = indices[i];
+				const LabelBricks::Brick& brick = *bricks[index];
+
+				int brickIndex[3];
+				GetBrickIndex(index, numBricks, brickIndex);
+
+				QString name = BrickFileName(fileName, brickIndex, manifest.brickGenerations[index]);
+
+				if (!WriteBrickFile(name, compressor, (const unsigned char*)brick.data(), brick.size() * sizeof(unsigned short), compressed)) {
+					success = false;
+				}
+			}
+		}
+
+		std::atomic<bool> success;
+
+	protected:
+		const std::string& fileName;
+		const LabelBricks::Snapshot& bricks;
+		const std::vector<vtkIdType>& indices;
+		const BrickedVolumeIO::Manifest& manifest;
+		int numBricks[3];
+	};
+}
+
+BrickedVolumeIO::BrickedVolumeIO() {
+}
+
+BrickedVolumeIO::~BrickedVolumeIO() {
+}
+
+bool BrickedVolumeIO::ReadManifest(const std::string& fileName, Manifest& manifest) {
+	QFile file(fileName.c_str());
+
+	if (!file.open(QIODevice::ReadOnly)) return false;
+
+	QJsonObject json = QJsonDocument::fromJson(file.readAll()).object();
+
+	if (json["compression"].toString() != "zlib") return false;
+
+	QJsonArray dimensions = json["dimensions"].toArray();
+	QJsonArray spacing = json["spacing"].toArray();
+
+	if (dimensions.size() != 3 || spacing.size() != 3) return false;
+
+	for (int i = 0; i < 3; i++) {
+		manifest.dimensions[i] = dimensions[i].toInt();
+		manifest.spacing[i] = spacing[i].toDouble(1.0);
+
+		if (manifest.dimensions[i] <= 0) return false;
+	}
+
+	manifest.scalarType = json["scalarType"].toInt();
+	manifest.brickSize = json["brickSize"].toInt();
+
+	if (manifest.brickSize <= 0 || vtkDataArray::GetDataTypeSize(manifest.scalarType) <= 0) return false;
+
+	// Versioned bricks
+	manifest.generation = json["generation"].toInt();
+	manifest.brickGenerations.clear();
+
+	if (manifest.generation > 0) {
+		QJsonArray generations = json["bricks"].toArray();
+
+		int numBricks[3];
+		GetNumberOfBricks(manifest, numBricks);
+
+		if (generations.size() != numBricks[0] * numBricks[1] * numBricks[2]) return false;
+
+		manifest.brickGenerations.resize(generations.size());
+
+		for (int i = 0; i < generations.size(); i++) {
+			manifest.brickGenerations[i] = generations[i].toInt();
+		}
+	}
+
+	return true;
+}
+
+bool BrickedVolumeIO::ReadBrick(const std::string& fileName, const Manifest& manifest, const int brickIndex[3], std::vector<unsigned char>& brick) {
+	brick.clear();
+
+	int generation = 0;
+
+	if (manifest.generation > 0) {
+		int numBricks[3];
+		GetNumberOfBricks(manifest, numBricks);
+
+		generation = manifest.brickGenerations[brickIndex[0] + numBricks[0] * (brickIndex[1] + numBricks[1] * brickIndex[2])];
+
+		// Empty brick
+		if (generation == 0) return true;
+	}
+
+	QFile file(BrickFileName(fileName, brickIndex, generation));
+
+	// Missing bricks are empty for unversioned volumes
+	if (generation == 0 && !file.exists()) return true;
+
+	if (!file.open(QIODevice::ReadOnly)) return false;
+
+	QByteArray compressed = file.readAll();
+
+	int brickExtent[6];
+	GetBrickExtent(manifest, brickIndex, brickExtent);
+
+	size_t size = (size_t)(brickExtent[1] - brickExtent[0] + 1) *
+		(brickExtent[3] - brickExtent[2] + 1) *
+		(brickExtent[5] - brickExtent[4] + 1) *
+		vtkDataArray::GetDataTypeSize(manifest.scalarType);
+
+	brick.resize(size);
+
+	vtkSmartPointer<vtkZLibDataCompressor> compressor = vtkSmartPointer<vtkZLibDataCompressor>::New();
+
+	if (compressor->Uncompress((const unsigned char*)compressed.constData(), compressed.size(), brick.data(), size) != size) {
+		brick.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool BrickedVolumeIO::Write(const std::string& fileName, vtkImageData* data, int brickSize) {
+	if (!data || data->GetNumberOfScalarComponents() != 1) return false;
+
+	Manifest manifest;
+	data->GetDimensions(manifest.dimensions);
+	data->GetSpacing(manifest.spacing);
+	manifest.scalarType = data->GetScalarType();
+	manifest.brickSize = brickSize;
+	manifest.generation = 0;
+
+	if (!QDir().mkpath(GetBrickDirectory(fileName).c_str())) return false;
+
+	// Bricks are addressed from the data origin
+	vtkSmartPointer<vtkImageData> origin = vtkSmartPointer<vtkImageData>::New();
+	origin->ShallowCopy(data);
+	origin->SetExtent(0, manifest.dimensions[0] - 1, 0, manifest.dimensions[1] - 1, 0, manifest.dimensions[2] - 1);
+
+	int numBricks[3];
+	GetNumberOfBricks(manifest, numBricks);
+
+	WriteBricks write(fileName, origin, manifest);
+	vtkSMPTools::For(0, (vtkIdType)numBricks[0] * numBricks[1] * numBricks[2], write);
+
+	if (!write.success) return false;
+
+	// Write the manifest last, so a partial conversion is not readable
+	return WriteManifest(fileName, manifest);
+}
+
+bool BrickedVolumeIO::WriteLabels(const std::string& fileName, const int dimensions[3], const double spacing[3], const LabelBricks::Snapshot& bricks, int brickSize, const LabelBricks::Snapshot* previous) {
+	Manifest manifest;
+
+	for (int i = 0; i < 3; i++) {
+		manifest.dimensions[i] = dimensions[i];
+		manifest.spacing[i] = spacing[i];
+	}
+
+	manifest.scalarType = VTK_UNSIGNED_SHORT;
+	manifest.brickSize = brickSize;
+
+	int numBricks[3];
+	GetNumberOfBricks(manifest, numBricks);
+
+	vtkIdType totalBricks = (vtkIdType)numBricks[0] * numBricks[1] * numBricks[2];
+
+	if ((vtkIdType)bricks.size() != totalBricks) return false;
+
+	// Only write changed bricks if the previous snapshot was written to this file
+	Manifest current;
+	bool readable = ReadManifest(fileName, current);
+
+	bool incremental = previous && previous->size() == bricks.size() &&
+		readable && current.generation > 0 &&
+		current.scalarType == manifest.scalarType && current.brickSize == manifest.brickSize &&
+		std::equal(current.dimensions, current.dimensions + 3, manifest.dimensions);
+
+	// Changed bricks get a new generation, so the current manifest stays valid until replaced
+	if (incremental) {
+		manifest.generation = current.generation + 1;
+		manifest.brickGenerations = current.brickGenerations;
+	}
+	else {
+		// Never overwrite bricks the manifest on disk may reference
+		manifest.generation = readable ? current.generation + 1 : 1;
+		manifest.brickGenerations.assign(totalBricks, 0);
+	}
+
+	std::vector<vtkIdType> changed;
+
+	for (vtkIdType i = 0; i < totalBricks; i++) {
+		if (incremental && (*previous)[i] == bricks[i]) continue;
+
+		manifest.brickGenerations[i] = bricks[i] ? manifest.generation : 0;
+
+		if (bricks[i]) changed.push_back(i);
+	}
+
+	if (!QDir().mkpath(GetBrickDirectory(fileName).c_str())) return false;
+
+	WriteLabelBricks write(fileName, bricks, changed, manifest);
+	vtkSMPTools::For(0, (vtkIdType)changed.size(), write);
+
+	if (!write.success || !WriteManifest(fileName, manifest)) return false;
+
+	// Remove bricks no longer referenced
+	if (incremental) {
+		for (vtkIdType i = 0; i < totalBricks; i++) {
+			if (current.brickGenerations[i] > 0 && current.brickGenerations[i] != manifest.brickGenerations[i]) {
+				int brickIndex[3];
+				GetBrickIndex(i, numBricks, brickIndex);
+
+				QFile::remove(BrickFileName(fileName, brickIndex, current.brickGenerations[i]));
+			}
+		}
+	}
+	else {
+		std::set<QString> referenced;
+
+		for (vtkIdType i = 0; i < totalBricks; i++) {
+			if (manifest.brickGenerations[i] > 0) {
+				int brickIndex[3];
+				GetBrickIndex(i, numBricks, brickIndex);
+
+				referenced.insert(QFileInfo(BrickFileName(fileName, brickIndex, manifest.brickGenerations[i])).fileName());
+			}
+		}
+
+		QDir directory(GetBrickDirectory(fileName).c_str());
+		QStringList files = directory.entryList(QDir::Files);
+
+		for (int i = 0; i < files.size(); i++) {
+			if (referenced.count(files[i]) == 0) directory.remove(files[i]);
+		}
+	}
+
+	return true;
+}
+
+std::string BrickedVolumeIO::GetBrickDirectory(const std::string& fileName) {
+	return fileName + ".bricks";
+}
+
+void BrickedVolumeIO::GetNumberOfBricks(const Manifest& manifest, int numBricks[3]) {
+	for (int i = 0; i < 3; i++) {
+		numBricks[i] = (manifest.dimensions[i] + manifest.brickSize - 1) / manifest.brickSize;
+	}
+}
+
+void BrickedVolumeIO::GetBrickExtent(const Manifest& manifest, const int brickIndex[3], int brickExtent[6]) {
+	for (int i = 0; i < 3; i++) {
+		brickExtent[2 * i] = brickIndex[i] * manifest.brickSize;
+		brickExtent[2 * i + 1] = std::min(brickExtent[2 * i] + manifest.brickSize, manifest.dimensions[i]) - 1;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef BrickedVolumeIO_H
+#define BrickedVolumeIO_H
+
+#include <string>
+#include <vector>
+
+#include "LabelBricks.h"
+
+class vtkImageData;
+
+// Chunked volume format: a JSON manifest plus a directory of zlib-compressed bricks named
+// i_j_k by brick index. Bricks at the volume edge are clipped, and missing bricks are zero.
+// Versioned volumes list a generation per brick, stored as i_j_k.generation with zero for
+// empty bricks, so bricks can be replaced without invalidating the current manifest.
+class BrickedVolumeIO {
+public:
+	struct Manifest {
+		int dimensions[3];
+		double spacing[3];
+		int scalarType;
+		int brickSize;
+
+		// Zero if unversioned
+		int generation;
+		std::vector<int> brickGenerations;
+	};
+
+	static bool ReadManifest(const std::string& fileName, Manifest& manifest);
+
+	// Uncompressed brick data, left empty if the brick is missing
+	static bool ReadBrick(const std::string& fileName, const Manifest& manifest, const int brickIndex[3], std::vector<unsigned char>& brick);
+
+	// Convert in-memory data, skipping bricks that are all zero
+	static bool Write(const std::string& fileName, vtkImageData* data, int brickSize = 64);
+
+	// Write label bricks as a versioned volume. If the previous snapshot was the last written to
+	// the file, only bricks that differ from it are written. The manifest is replaced atomically.
+	// Does not access label data, so can be called from a worker thread.
+	static bool WriteLabels(const std::string& fileName, const int dimensions[3], const double spacing[3], const LabelBricks::Snapshot& bricks, int brickSize, const LabelBricks::Snapshot* previous = nullptr);
+
+	static std::string GetBrickDirectory(const std::string& fileName);
+
+	static void GetNumberOfBricks(const Manifest& manifest, int numBricks[3]);
+	static void GetBrickExtent(const Manifest& manifest, const int brickIndex[3], int brickExtent[6]);
+
+private:
+	BrickedVolumeIO();
+	~BrickedVolumeIO();
+};
+
+#endif
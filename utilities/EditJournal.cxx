@@ -0,0 +1,318 @@
+#include "EditJournal.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <QDataStream>
+
+#include <vtkImageData.h>
+
+#include "RegionMetadataIO.h"
+
+namespace {
+	const quint32 magic = 0x53474A4C;
+	const quint32 version = 2;
+
+	void SetVersion(QDataStream& stream) {
+		stream.setVersion(QDataStream::Qt_5_0);
+	}
+
+	// Bricks are ordered x-fastest from the label extent origin, clipped at the extent
+	void GetBrickExtent(int index, const int extent[6], const int numBricks[3], int brickSize, int brickExtent[6]) {
+		int ijk[3];
+		ijk[0] = index % numBricks[0];
+		ijk[1] = (index / numBricks[0]) % numBricks[1];
+		ijk[2] = index / (numBricks[0] * numBricks[1]);
+
+		for (int i = 0; i < 3; i++) {
+			brickExtent[2 * i] = extent[2 * i] + ijk[i] * brickSize;
+			brickExtent[2 * i + 1] = std::min(brickExtent[2 * i] + brickSize - 1, extent[2 * i + 1]);
+		}
+	}
+}
+
+EditJournal::EditJournal() {
+}
+
+EditJournal::~EditJournal() {
+	Close(false);
+}
+
+bool EditJournal::Start(const std::string& fileName, const int dimensions[3], int brickSize, const LabelBricks::Snapshot& labels, const EditJournal::RegionInfoCollection& info) {
+	Close(false);
+
+	file.setFileName(fileName.c_str());
+
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+	QDataStream stream(&file);
+	SetVersion(stream);
+
+	stream << magic << version;
+	stream << (qint32)dimensions[0] << (qint32)dimensions[1] << (qint32)dimensions[2] << (qint32)brickSize;
+
+	if (stream.status() != QDataStream::Ok || !file.flush()) {
+		Close(true);
+		return false;
+	}
+
+	this->labels = labels;
+	this->info = info;
+
+	return true;
+}
+
+bool EditJournal::Resume(const std::string& fileName, qint64 validSize, const LabelBricks::Snapshot& labels, const EditJournal::RegionInfoCollection& info) {
+	Close(false);
+
+	file.setFileName(fileName.c_str());
+
+	if (!file.open(QIODevice::ReadWrite)) return false;
+
+	// Drop any torn record
+	if (!file.resize(validSize) || !file.seek(validSize)) {
+		file.close();
+		return false;
+	}
+
+	this->labels = labels;
+	this->info = info;
+
+	return true;
+}
+
+void EditJournal::Close(bool remove) {
+	if (file.isOpen()) {
+		file.close();
+
+		if (remove) file.remove();
+	}
+
+	labels.clear();
+	info.clear();
+}
+
+bool EditJournal::IsOpen() {
+	return file.isOpen();
+}
+
+bool EditJournal::Append(const LabelBricks::Snapshot& labels, const EditJournal::RegionInfoCollection& info) {
+	if (!file.isOpen() || labels.size() != this->labels.size()) return false;
+
+	QByteArray payload;
+	QDataStream stream(&payload, QIODevice::WriteOnly);
+	SetVersion(stream);
+
+	// Changed bricks, with empty data for empty bricks
+	std::vector<int> changed;
+
+	for (int i = 0; i < (int)labels.size(); i++) {
+		if (labels[i] != this->labels[i]) changed.push_back(i);
+	}
+
+	stream << (quint32)changed.size();
+
+	for (int i = 0; i < (int)changed.size(); i++) {
+		const LabelBricks::BrickPointer& brick = labels[changed[i]];
+
+		stream << (qint32)changed[i];
+
+		if (brick) {
+			QByteArray data = QByteArray::fromRawData((const char*)brick->data(), (int)(brick->size() * sizeof(unsigned short)));
+			stream << qCompress(data, 1);
+		}
+		else {
+			stream << QByteArray();
+		}
+	}
+
+	// Removed regions
+	std::vector<unsigned short> removed;
+
+	for (RegionInfoCollection::const_iterator it = this->info.begin(); it != this->info.end(); it++) {
+		if (info.count(it->first) == 0) removed.push_back(it->first);
+	}
+
+	stream << (quint32)removed.size();
+
+	for (int i = 0; i < (int)removed.size(); i++) {
+		stream << (quint16)removed[i];
+	}
+
+	// Added or changed regions
+	std::vector<const RegionInfo*> modified;
+
+	for (RegionInfoCollection::const_iterator it = info.begin(); it != info.end(); it++) {
+		RegionInfoCollection::const_iterator oldIt = this->info.find(it->first);
+
+		if (oldIt == this->info.end() || !(oldIt->second == it->second)) modified.push_back(&it->second);
+	}
+
+	stream << (quint32)modified.size();
+
+	for (int i = 0; i < (int)modified.size(); i++) {
+		RegionMetadataIO::WriteInfo(stream, *modified[i]);
+	}
+
+	this->labels = labels;
+	this->info = info;
+
+	if (changed.empty() && removed.empty() && modified.empty()) return true;
+
+	// Length and checksum, so torn records can be detected
+	QByteArray record;
+	QDataStream header(&record, QIODevice::WriteOnly);
+	SetVersion(header);
+
+	header << (quint32)payload.size() << qChecksum(payload.constData(), (uint)payload.size());
+
+	record.append(payload);
+
+	return file.write(record) == record.size() && file.flush();
+}
+
+int EditJournal::Replay(const std::string& fileName, vtkImageData* labels, std::vector<RegionInfo>& metadata, qint64* validSize) {
+	QFile file(fileName.c_str());
+
+	if (!file.open(QIODevice::ReadOnly)) return -1;
+
+	QDataStream stream(&file);
+	SetVersion(stream);
+
+	quint32 fileMagic, fileVersion;
+	qint32 dimensions[3], brickSize;
+
+	stream >> fileMagic >> fileVersion >> dimensions[0] >> dimensions[1] >> dimensions[2] >> brickSize;
+
+	if (stream.status() != QDataStream::Ok || fileMagic != magic || fileVersion < 1 || fileVersion > version || brickSize <= 0) return -1;
+
+	if (labels->GetScalarType() != VTK_UNSIGNED_SHORT || labels->GetNumberOfScalarComponents() != 1) return -1;
+
+	int* labelDimensions = labels->GetDimensions();
+
+	for (int i = 0; i < 3; i++) {
+		if (labelDimensions[i] != dimensions[i]) return -1;
+	}
+
+	int extent[6];
+	labels->GetExtent(extent);
+
+	int numBricks[3];
+	for (int i = 0; i < 3; i++) {
+		numBricks[i] = (dimensions[i] + brickSize - 1) / brickSize;
+	}
+
+	int totalBricks = numBricks[0] * numBricks[1] * numBricks[2];
+
+	RegionInfoCollection info;
+
+	for (int i = 0; i < (int)metadata.size(); i++) {
+		info[metadata[i].GetLabel()] = metadata[i];
+	}
+
+	int numRecords = 0;
+	qint64 valid = file.pos();
+
+	while (true) {
+		quint32 size;
+		quint16 checksum;
+
+		stream >> size >> checksum;
+
+		if (stream.status() != QDataStream::Ok) break;
+
+		QByteArray payload = file.read(size);
+
+		if (payload.size() != (int)size || qChecksum(payload.constData(), (uint)payload.size()) != checksum) break;
+
+		QDataStream record(payload);
+		SetVersion(record);
+
+		// Bricks
+		quint32 numChanged;
+		record >> numChanged;
+
+		for (quint32 i = 0; i < numChanged && record.status() == QDataStream::Ok; i++) {
+			qint32 index;
+			QByteArray compressed;
+
+			record >> index >> compressed;
+
+			if (index < 0 || index >= totalBricks) continue;
+
+			int brickExtent[6];
+			GetBrickExtent(index, extent, numBricks, brickSize, brickExtent);
+
+			int nx = brickExtent[1] - brickExtent[0] + 1;
+			int ny = brickExtent[3] - brickExtent[2] + 1;
+			int nz = brickExtent[5] - brickExtent[4] + 1;
+
+			size_t rowSize = nx * sizeof(unsigned short);
+
+			// No data for empty bricks
+			bool empty = compressed.isEmpty();
+
+			QByteArray data = empty ? QByteArray() : qUncompress(compressed);
+
+			if (!empty && (size_t)data.size() != rowSize * ny * nz) continue;
+
+			const char* brickData = data.constData();
+
+			for (int k = brickExtent[4]; k <= brickExtent[5]; k++) {
+				for (int j = brickExtent[2]; j <= brickExtent[3]; j++) {
+					void* row = labels->GetScalarPointer(brickExtent[0], j, k);
+
+					if (empty) {
+						memset(row, 0, rowSize);
+					}
+					else {
+						memcpy(row, brickData, rowSize);
+						brickData += rowSize;
+					}
+				}
+			}
+		}
+
+		// Removed regions
+		quint32 numRemoved;
+		record >> numRemoved;
+
+		for (quint32 i = 0; i < numRemoved && record.status() == QDataStream::Ok; i++) {
+			quint16 label;
+			record >> label;
+
+			info.erase(label);
+		}
+
+		// Added or changed regions
+		quint32 numModified;
+		record >> numModified;
+
+		for (quint32 i = 0; i < numModified && record.status() == QDataStream::Ok; i++) {
+			RegionInfo regionInfo;
+			// Version 1 has a centroid per region
+			RegionMetadataIO::ReadInfo(record, regionInfo, fileVersion < 2);
+
+			info[regionInfo.GetLabel()] = regionInfo;
+		}
+
+		numRecords++;
+		valid = file.pos();
+	}
+
+	metadata.clear();
+
+	for (RegionInfoCollection::const_iterator it = info.begin(); it != info.end(); it++) {
+		metadata.push_back(it->second);
+	}
+
+	if (numRecords > 0) labels->Modified();
+
+	if (validSize) *validSize = valid;
+
+	return numRecords;
+}
+
+std::string EditJournal::GetJournalFileName(const std::string& fileName) {
+	return fileName + ".journal";
+}
@@ -0,0 +1,54 @@
+#ifndef EditJournal_H
+#define EditJournal_H
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include <QFile>
+
+#include "LabelBricks.h"
+#include "RegionInfo.h"
+
+class vtkImageData;
+
+// Append-only journal of edits since the segmentation was last saved, for crash recovery.
+// Each record holds the label bricks and region info changed by one history step, so
+// replaying onto the saved segmentation costs time proportional to the edits. Records are
+// length-prefixed and checksummed, so a record torn by a crash is ignored.
+class EditJournal {
+public:
+	typedef std::map<unsigned short, RegionInfo> RegionInfoCollection;
+
+	EditJournal();
+	~EditJournal();
+
+	// Start a new journal, with the labels and region info as saved
+	bool Start(const std::string& fileName, const int dimensions[3], int brickSize, const LabelBricks::Snapshot& labels, const RegionInfoCollection& info);
+
+	// Continue a replayed journal, with the labels and region info after replay
+	bool Resume(const std::string& fileName, qint64 validSize, const LabelBricks::Snapshot& labels, const RegionInfoCollection& info);
+
+	// Close, removing the journal file if requested. Does nothing if not open.
+	void Close(bool remove);
+	bool IsOpen();
+
+	// Append changes from the last recorded state
+	bool Append(const LabelBricks::Snapshot& labels, const RegionInfoCollection& info);
+
+	// Apply records to label data and metadata as saved. Does not need a GUI, so can also be
+	// used to replay edits headlessly. Returns the number of records applied, or -1 if the
+	// journal does not match the labels. The valid size excludes any torn record.
+	static int Replay(const std::string& fileName, vtkImageData* labels, std::vector<RegionInfo>& metadata, qint64* validSize = nullptr);
+
+	static std::string GetJournalFileName(const std::string& fileName);
+
+protected:
+	QFile file;
+
+	// Last recorded state
+	LabelBricks::Snapshot labels;
+	RegionInfoCollection info;
+};
+
+#endif
@@ -1,6 +1,5 @@
 #include "History.h"
 
-#include <algorithm>
 #include <utility>
 
 #include <vtkImageData.h>
@@ -9,68 +8,179 @@
 #include "RegionCollection.h"
 #include "RegionInfo.h"
 
-History::History(int maxLength) : maxLength(maxLength) {
+History::History(int maxLength, size_t maxMemory, int minLength) : maxLength(maxLength), maxMemory(maxMemory), minLength(minLength) {
 	Clear();
 }
 
 History::~History() {
 }
 
-void History::Push(vtkImageData* labels, RegionCollection* regions) {
-	vtkSmartPointer<vtkImageData> newLabels = vtkSmartPointer<vtkImageData>::New();
-	newLabels->DeepCopy(labels);
-
+void History::Push(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]) {
 	RegionInfoCollection newInfo;
 	SaveInfo(newInfo, regions);
 
-	if (index < labelHistory.size() - 1) {
-		labelHistory.erase(labelHistory.begin() + index + 1, labelHistory.end());
-		regionHistory.erase(regionHistory.begin() + index + 1, regionHistory.end());
+	if (bricks.IsInitialized()) {
+		bricks.Update(labels, modifiedExtent);
+	}
+	else {
+		bricks.Initialize(labels);
+	}
+
+	// Remove states after the current state
+	while ((int)states.size() > index + 1) {
+		memorySize -= states.back().memorySize;
+		states.pop_back();
 	}
 
-	labelHistory.push_back(newLabels);
-	regionHistory.push_back(newInfo);
+	State state;
+	state.labels = bricks.GetSnapshot();
+	state.memorySize = LabelBricks::GetMemorySize(state.labels, states.size() > 0 ? &states.back().labels : nullptr);
+	DiffInfo(currentInfo, newInfo, state);
+
+	currentInfo.swap(newInfo);
+
+	memorySize += state.memorySize;
+	states.push_back(std::move(state));
+
+	// Remove oldest states, always keeping the current state. The oldest state's labels are needed
+	// regardless, so only memory for edits since then counts against the limit.
+	while (states.size() > 1 &&
+		((int)states.size() > maxLength ||
+		(maxMemory > 0 && (int)states.size() > minLength && memorySize - states.front().memorySize > maxMemory))) {
+		State& next = states[1];
+
+		memorySize -= states.front().memorySize + next.memorySize;
+		next.memorySize = LabelBricks::GetMemorySize(next.labels);
+		memorySize += next.memorySize;
 
-	if (labelHistory.size() > maxLength) {
-		labelHistory.pop_front();
-		regionHistory.pop_front();
+		states.pop_front();
 	}
 
-	index = (int)labelHistory.size() - 1;
+	index = (int)states.size() - 1;
 }
 
-void History::Head(vtkImageData* labels, RegionCollection* regions) {
-	if (labelHistory.size() == 0) return;
+void History::Head(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]) {
+	if (states.size() == 0) return;
 
-	labels->DeepCopy(labelHistory[index]);
-	RestoreInfo(regions, regionHistory[index], labels);
+	RevertInfo(labels, regions);
+
+	bricks.Update(labels, modifiedExtent);
+	bricks.Restore(states[index].labels, labels, AdjacencyObserver(regions));
 }
 
-void History::Undo(vtkImageData* labels, RegionCollection* regions) {
-	if (labelHistory.size() == 0 || index == 0) return;
+void History::Undo(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]) {
+	if (states.size() == 0 || index == 0) return;
 
-	index--;
+	RevertInfo(labels, regions);
+
+	bricks.Update(labels, modifiedExtent);
+	bricks.Restore(states[index - 1].labels, labels, AdjacencyObserver(regions));
+
+	ApplyInfo(states[index], true, labels, regions);
 
-	labels->DeepCopy(labelHistory[index]);
-	RestoreInfo(regions, regionHistory[index], labels);
+	index--;
 }
 
+void History::Redo(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]) {
+	if (states.size() == 0 || index == (int)states.size() - 1) return;
 
-void History::Redo(vtkImageData* labels, RegionCollection* regions) {
-	if (labelHistory.size() == 0 || index == labelHistory.size() - 1) return;
+	RevertInfo(labels, regions);
 
-	index++;
+	bricks.Update(labels, modifiedExtent);
+	bricks.Restore(states[index + 1].labels, labels, AdjacencyObserver(regions));
+
+	ApplyInfo(states[index + 1], false, labels, regions);
 
-	labels->DeepCopy(labelHistory[index]);
-	RestoreInfo(regions, regionHistory[index], labels);
+	index++;
 }
 
 void History::Clear() {
-	labelHistory.clear();
-	regionHistory.clear();
+	states.clear();
+	bricks.Clear();
+	currentInfo.clear();
+	memorySize = 0;
 	index = -1;
 }
 
+const LabelBricks::Snapshot& History::GetSnapshot() {
+	static const LabelBricks::Snapshot empty;
+
+	return states.size() > 0 ? states[index].labels : empty;
+}
+
+const LabelBricks::Snapshot& History::GetSnapshot(vtkImageData* labels, const int modifiedExtent[6]) {
+	// Later pushes, undos and redos update from the labels too, so updating early is safe
+	if (bricks.IsInitialized()) {
+		bricks.Update(labels, modifiedExtent);
+	}
+	else {
+		bricks.Initialize(labels);
+	}
+
+	return bricks.GetSnapshot();
+}
+
+int History::GetBrickSize() {
+	return bricks.GetBrickSize();
+}
+
+const History::RegionInfoCollection& History::GetRegionInfo() {
+	return currentInfo;
+}
+
+void History::DiffInfo(const RegionInfoCollection& oldInfo, const RegionInfoCollection& newInfo, State& state) {
+	// Removed or changed regions
+	for (RegionInfoCollection::const_iterator it = oldInfo.begin(); it != oldInfo.end(); it++) {
+		RegionInfoCollection::const_iterator newIt = newInfo.find(it->first);
+
+		if (newIt == newInfo.end() || !(newIt->second == it->second)) {
+			state.regionLabels.insert(it->first);
+			state.oldInfo.insert(*it);
+
+			if (newIt != newInfo.end()) state.newInfo.insert(*newIt);
+		}
+	}
+
+	// Added regions
+	for (RegionInfoCollection::const_iterator it = newInfo.begin(); it != newInfo.end(); it++) {
+		if (oldInfo.count(it->first) == 0) {
+			state.regionLabels.insert(it->first);
+			state.newInfo.insert(*it);
+		}
+	}
+}
+
+void History::ApplyInfo(const State& state, bool undo, vtkImageData* labels, RegionCollection* regions) {
+	// Labels should be restored first, as removing a region clears its label
+	const RegionInfoCollection& info = undo ? state.oldInfo : state.newInfo;
+
+	for (std::set<unsigned short>::const_iterator it = state.regionLabels.begin(); it != state.regionLabels.end(); it++) {
+		RestoreInfo(regions, *it, info, labels);
+
+		RegionInfoCollection::const_iterator infoIt = info.find(*it);
+
+		if (infoIt != info.end()) {
+			currentInfo[*it] = infoIt->second;
+		}
+		else {
+			currentInfo.erase(*it);
+		}
+	}
+}
+
+void History::RevertInfo(vtkImageData* labels, RegionCollection* regions) {
+	// Discard any region changes since the last push
+	RegionInfoCollection info;
+	SaveInfo(info, regions);
+
+	State pending;
+	DiffInfo(info, currentInfo, pending);
+
+	for (std::set<unsigned short>::const_iterator it = pending.regionLabels.begin(); it != pending.regionLabels.end(); it++) {
+		RestoreInfo(regions, *it, currentInfo, labels);
+	}
+}
+
 void History::SaveInfo(RegionInfoCollection& info, RegionCollection* regions) {
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 		Region* region = regions->Get(it);
@@ -78,26 +188,28 @@ void History::SaveInfo(RegionInfoCollection& info, RegionCollection* regions) {
 	}
 }
 
-void History::RestoreInfo(RegionCollection* regions, RegionInfoCollection& info, vtkImageData* labels) {
-	// Copy info for regions
-	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End();) {
-		Region* region = regions->Get(it++);
+void History::RestoreInfo(RegionCollection* regions, unsigned short label, const RegionInfoCollection& info, vtkImageData* labels) {
+	RegionInfoCollection::const_iterator it = info.find(label);
 
-		unsigned short label = region->GetLabel();
-
-		if (info.count(label) == 1) {
-			region->SetInfo(info[label]);
+	if (it != info.end()) {
+		if (regions->Has(label)) {
+			regions->Get(label)->SetInfo(it->second);
 		}
 		else {
-			regions->Remove(region->GetLabel());
+			regions->Add(new Region(it->second, labels));
 		}
 	}
-
-	// Create new regions for any leftover
-	for (RegionInfoCollection::iterator it = info.begin(); it != info.end(); it++) {
-		if (!regions->Has(it->first)) {
-			Region* region = new Region(it->second, labels);
-			regions->Add(region);
-		}
+	else {
+		regions->Remove(label);
 	}
-}
\ No newline at end of file
+}
+
+LabelBricks::RestoreObserver History::AdjacencyObserver(RegionCollection* regions) {
+	RegionAdjacency* adjacency = regions->GetAdjacency();
+
+	// Contacts of each restored brick are removed before and added after it is written
+	return [adjacency](const int brickExtent[6], bool written) {
+		if (written) adjacency->AddContacts(brickExtent);
+		else adjacency->RemoveContacts(brickExtent);
+	};
+}
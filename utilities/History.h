@@ -1,38 +1,78 @@
 #ifndef History_H
 #define History_H
 
-#include <vtkSmartPointer.h>
-
 #include <deque>
 #include <map>
+#include <set>
+
+#include "LabelBricks.h"
+#include "RegionInfo.h"
 
 class vtkImageData;
 
 class RegionCollection;
-class RegionInfo;
 
 class History {
 public:
-	History(int maxLength);
+	typedef std::map<unsigned short, RegionInfo> RegionInfoCollection;
+
+	// A maximum memory of zero only limits the number of states. The memory limit applies to
+	// edits since the oldest state, not the oldest state's full labels, and never trims below
+	// the minimum number of states.
+	History(int maxLength, size_t maxMemory = 0, int minLength = 10);
 	~History();
 
-	void Push(vtkImageData* labels, RegionCollection* regions);
-	void Head(vtkImageData* labels, RegionCollection* regions);
-	void Undo(vtkImageData* labels, RegionCollection* regions);
-	void Redo(vtkImageData* labels, RegionCollection* regions);
+	// The modified extent is the extent of label edits since the last push
+	void Push(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]);
+	void Head(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]);
+	void Undo(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]);
+	void Redo(vtkImageData* labels, RegionCollection* regions, const int modifiedExtent[6]);
 	void Clear();
-	
+
+	// Labels at the current state, sharing bricks with the history
+	const LabelBricks::Snapshot& GetSnapshot();
+
+	// Labels including edits since the last push, without adding a state
+	const LabelBricks::Snapshot& GetSnapshot(vtkImageData* labels, const int modifiedExtent[6]);
+	int GetBrickSize();
+
+	// Region info at the current state
+	const RegionInfoCollection& GetRegionInfo();
+
 protected:
-	std::deque<vtkSmartPointer<vtkImageData>> labelHistory;
+	struct State {
+		LabelBricks::Snapshot labels;
 
-	typedef std::map<unsigned short, RegionInfo> RegionInfoCollection;
-	std::deque<RegionInfoCollection> regionHistory;
+		// Memory for bricks not shared with the previous state, or all bricks for the oldest state
+		size_t memorySize;
+
+		// Region changes from the previous state. Regions missing from the old or new info did not exist in that state
+		std::set<unsigned short> regionLabels;
+		RegionInfoCollection oldInfo;
+		RegionInfoCollection newInfo;
+	};
+
+	std::deque<State> states;
+
+	// Labels and region info at the current state
+	LabelBricks bricks;
+	RegionInfoCollection currentInfo;
 
 	int maxLength;
+	size_t maxMemory;
+	int minLength;
+	size_t memorySize;
 	int index;
 
+	void DiffInfo(const RegionInfoCollection& oldInfo, const RegionInfoCollection& newInfo, State& state);
+
+	void ApplyInfo(const State& state, bool undo, vtkImageData* labels, RegionCollection* regions);
+	void RevertInfo(vtkImageData* labels, RegionCollection* regions);
+
 	void SaveInfo(RegionInfoCollection& info, RegionCollection* regions);
-	void RestoreInfo(RegionCollection* regions, RegionInfoCollection& info, vtkImageData* labels);
+	void RestoreInfo(RegionCollection* regions, unsigned short label, const RegionInfoCollection& info, vtkImageData* labels);
+
+	LabelBricks::RestoreObserver AdjacencyObserver(RegionCollection* regions);
 };
 
 #endif
@@ -0,0 +1,229 @@
+#include "LabelBricks.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <vtkImageData.h>
+
+LabelBricks::LabelBricks(int brickSize) : brickSize(brickSize) {
+	Clear();
+}
+
+LabelBricks::~LabelBricks() {
+}
+
+void LabelBricks::Initialize(vtkImageData* labels) {
+	labels->GetExtent(extent);
+
+	for (int i = 0; i < 3; i++) {
+		int n = extent[2 * i + 1] - extent[2 * i] + 1;
+		numBricks[i] = (n + brickSize - 1) / brickSize;
+	}
+
+	bricks.clear();
+	bricks.resize(GetNumberOfBricks());
+
+	for (int i = 0; i < (int)bricks.size(); i++) {
+		int brickExtent[6];
+		GetBrickExtent(i, brickExtent);
+
+		bricks[i] = ReadBrick(labels, brickExtent);
+	}
+}
+
+void LabelBricks::Clear() {
+	bricks.clear();
+
+	for (int i = 0; i < 3; i++) {
+		extent[2 * i] = 0;
+		extent[2 * i + 1] = -1;
+		numBricks[i] = 0;
+	}
+}
+
+bool LabelBricks::IsInitialized() {
+	return GetNumberOfBricks() > 0;
+}
+
+void LabelBricks::Update(vtkImageData* labels, const int updateExtent[6]) {
+	if (!Matches(labels)) {
+		Initialize(labels);
+		return;
+	}
+
+	// Range of bricks intersecting the extent
+	int b0[3], b1[3];
+	for (int i = 0; i < 3; i++) {
+		int e0 = std::max(updateExtent[2 * i], extent[2 * i]);
+		int e1 = std::min(updateExtent[2 * i + 1], extent[2 * i + 1]);
+
+		if (e0 > e1) return;
+
+		b0[i] = (e0 - extent[2 * i]) / brickSize;
+		b1[i] = (e1 - extent[2 * i]) / brickSize;
+	}
+
+	for (int k = b0[2]; k <= b1[2]; k++) {
+		for (int j = b0[1]; j <= b1[1]; j++) {
+			for (int i = b0[0]; i <= b1[0]; i++) {
+				int index = i + numBricks[0] * (j + numBricks[1] * k);
+
+				int brickExtent[6];
+				GetBrickExtent(index, brickExtent);
+
+				// Only copy changed bricks, so unchanged bricks stay shared
+				if (!BrickEquals(bricks[index], labels, brickExtent)) {
+					bricks[index] = ReadBrick(labels, brickExtent);
+				}
+			}
+		}
+	}
+}
+
+void LabelBricks::Restore(const Snapshot& snapshot, vtkImageData* labels, const RestoreObserver& observer) {
+	if (!Matches(labels) || snapshot.size() != bricks.size()) return;
+
+	bool modified = false;
+
+	for (int i = 0; i < (int)bricks.size(); i++) {
+		if (snapshot[i] == bricks[i]) continue;
+
+		int brickExtent[6];
+		GetBrickExtent(i, brickExtent);
+
+		if (observer) observer(brickExtent, false);
+
+		WriteBrick(snapshot[i], labels, brickExtent);
+
+		if (observer) observer(brickExtent, true);
+
+		bricks[i] = snapshot[i];
+
+		modified = true;
+	}
+
+	if (modified) labels->Modified();
+}
+
+const LabelBricks::Snapshot& LabelBricks::GetSnapshot() {
+	return bricks;
+}
+
+int LabelBricks::GetBrickSize() {
+	return brickSize;
+}
+
+int LabelBricks::GetNumberOfBricks() {
+	return numBricks[0] * numBricks[1] * numBricks[2];
+}
+
+void LabelBricks::GetBrickExtent(int index, int brickExtent[6]) {
+	int ijk[3];
+	ijk[0] = index % numBricks[0];
+	ijk[1] = (index / numBricks[0]) % numBricks[1];
+	ijk[2] = index / (numBricks[0] * numBricks[1]);
+
+	for (int i = 0; i < 3; i++) {
+		brickExtent[2 * i] = extent[2 * i] + ijk[i] * brickSize;
+		brickExtent[2 * i + 1] = std::min(brickExtent[2 * i] + brickSize - 1, extent[2 * i + 1]);
+	}
+}
+
+size_t LabelBricks::GetMemorySize(const Snapshot& snapshot, const Snapshot* other) {
+	size_t size = 0;
+
+	for (int i = 0; i < (int)snapshot.size(); i++) {
+		if (!snapshot[i]) continue;
+		if (other && i < (int)other->size() && (*other)[i] == snapshot[i]) continue;
+
+		size += snapshot[i]->size() * sizeof(unsigned short);
+	}
+
+	return size;
+}
+
+bool LabelBricks::Matches(vtkImageData* labels) {
+	if (!IsInitialized()) return false;
+
+	int labelExtent[6];
+	labels->GetExtent(labelExtent);
+
+	for (int i = 0; i < 6; i++) {
+		if (labelExtent[i] != extent[i]) return false;
+	}
+
+	return true;
+}
+
+LabelBricks::BrickPointer LabelBricks::ReadBrick(vtkImageData* labels, const int brickExtent[6]) {
+	int nx = brickExtent[1] - brickExtent[0] + 1;
+	int ny = brickExtent[3] - brickExtent[2] + 1;
+	int nz = brickExtent[5] - brickExtent[4] + 1;
+
+	std::shared_ptr<Brick> brick = std::make_shared<Brick>(nx * ny * nz);
+	unsigned short* brickData = brick->data();
+
+	bool empty = true;
+
+	for (int k = brickExtent[4]; k <= brickExtent[5]; k++) {
+		for (int j = brickExtent[2]; j <= brickExtent[3]; j++) {
+			const unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(brickExtent[0], j, k));
+
+			for (int i = 0; i < nx; i++) {
+				if (row[i] != 0) empty = false;
+			}
+
+			memcpy(brickData, row, nx * sizeof(unsigned short));
+			brickData += nx;
+		}
+	}
+
+	// Empty bricks are not stored
+	if (empty) return nullptr;
+
+	return brick;
+}
+
+void LabelBricks::WriteBrick(const BrickPointer& brick, vtkImageData* labels, const int brickExtent[6]) {
+	int nx = brickExtent[1] - brickExtent[0] + 1;
+
+	const unsigned short* brickData = brick ? brick->data() : nullptr;
+
+	for (int k = brickExtent[4]; k <= brickExtent[5]; k++) {
+		for (int j = brickExtent[2]; j <= brickExtent[3]; j++) {
+			unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(brickExtent[0], j, k));
+
+			if (brickData) {
+				memcpy(row, brickData, nx * sizeof(unsigned short));
+				brickData += nx;
+			}
+			else {
+				memset(row, 0, nx * sizeof(unsigned short));
+			}
+		}
+	}
+}
+
+bool LabelBricks::BrickEquals(const BrickPointer& brick, vtkImageData* labels, const int brickExtent[6]) {
+	int nx = brickExtent[1] - brickExtent[0] + 1;
+
+	const unsigned short* brickData = brick ? brick->data() : nullptr;
+
+	for (int k = brickExtent[4]; k <= brickExtent[5]; k++) {
+		for (int j = brickExtent[2]; j <= brickExtent[3]; j++) {
+			const unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(brickExtent[0], j, k));
+
+			if (brickData) {
+				if (memcmp(row, brickData, nx * sizeof(unsigned short)) != 0) return false;
+				brickData += nx;
+			}
+			else {
+				for (int i = 0; i < nx; i++) {
+					if (row[i] != 0) return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
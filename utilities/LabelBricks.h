@@ -0,0 +1,58 @@
+#ifndef LabelBricks_H
+#define LabelBricks_H
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+class vtkImageData;
+
+// Label volume stored as reference-counted bricks. Bricks are immutable and replaced when
+// their contents change, so snapshots share all untouched bricks.
+class LabelBricks {
+public:
+	typedef std::vector<unsigned short> Brick;
+	typedef std::shared_ptr<const Brick> BrickPointer;
+	typedef std::vector<BrickPointer> Snapshot;
+
+	// Called with each brick's extent before and after it is written
+	typedef std::function<void(const int brickExtent[6], bool written)> RestoreObserver;
+
+	LabelBricks(int brickSize = 32);
+	~LabelBricks();
+
+	void Initialize(vtkImageData* labels);
+	void Clear();
+	bool IsInitialized();
+
+	// Copy bricks intersecting the extent that differ from the label data
+	void Update(vtkImageData* labels, const int updateExtent[6]);
+
+	// Write bricks that differ from the snapshot to the label data
+	void Restore(const Snapshot& snapshot, vtkImageData* labels, const RestoreObserver& observer = nullptr);
+
+	// Shares all bricks, O(number of bricks)
+	const Snapshot& GetSnapshot();
+
+	int GetBrickSize();
+	int GetNumberOfBricks();
+	void GetBrickExtent(int index, int brickExtent[6]);
+
+	// Memory for bricks in the snapshot that are not shared with the other snapshot
+	static size_t GetMemorySize(const Snapshot& snapshot, const Snapshot* other = nullptr);
+
+protected:
+	int brickSize;
+	int extent[6];
+	int numBricks[3];
+
+	Snapshot bricks;
+
+	bool Matches(vtkImageData* labels);
+
+	BrickPointer ReadBrick(vtkImageData* labels, const int brickExtent[6]);
+	void WriteBrick(const BrickPointer& brick, vtkImageData* labels, const int brickExtent[6]);
+	bool BrickEquals(const BrickPointer& brick, vtkImageData* labels, const int brickExtent[6]);
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "LabelComponents.h"
+
+#include <algorithm>
+
+#include <vtkImageData.h>
+
+#include "VoxelIterator.h"
+
+namespace {
+	// Provisional ids start at one, with zero for other labels
+	class UnionFind {
+	public:
+		UnionFind() : parent(1, 0) {}
+
+		int Add() {
+			int id = (int)parent.size();
+			parent.push_back(id);
+
+			return id;
+		}
+
+		int Find(int id) {
+			while (parent[id] != id) {
+				parent[id] = parent[parent[id]];
+				id = parent[id];
+			}
+
+			return id;
+		}
+
+		// Returns the merged root
+		int Union(int a, int b) {
+			a = Find(a);
+			b = Find(b);
+
+			if (a == b) return a;
+
+			if (b < a) std::swap(a, b);
+
+			parent[b] = a;
+
+			return a;
+		}
+
+		int Size() {
+			return (int)parent.size();
+		}
+
+	private:
+		std::vector<int> parent;
+	};
+
+	// Provisional id for a voxel of the label from its previous neighbors along each axis, which are
+	// zero outside the extent
+	int Merge(UnionFind& sets, int left, int below, int behind) {
+		int id = 0;
+
+		if (left) id = left;
+		if (below) id = id ? sets.Union(id, below) : below;
+		if (behind) id = id ? sets.Union(id, behind) : behind;
+
+		return id ? id : sets.Add();
+	}
+
+	void SortLargestFirst(std::vector<LabelComponents::Component>& components) {
+		std::stable_sort(components.begin(), components.end(), [](const LabelComponents::Component& a, const LabelComponents::Component& b) {
+			return a.numVoxels > b.numVoxels;
+		});
+	}
+}
+
+int LabelComponents::Label(vtkImageData* labels, unsigned short label, const int extent[6], std::vector<int>& ids, std::vector<Component>& components) {
+	components.clear();
+
+	int e[6];
+	if (!VoxelIterator::ClampExtent(labels, extent, e)) {
+		ids.clear();
+		return 0;
+	}
+
+	int nx = e[1] - e[0] + 1;
+	int ny = e[3] - e[2] + 1;
+	vtkIdType sliceSize = (vtkIdType)nx * ny;
+
+	ids.assign(sliceSize * (e[5] - e[4] + 1), 0);
+
+	UnionFind sets;
+
+	// Provisional ids
+	VoxelIterator::ForEach<unsigned short>(labels, e, [&](int i, int j, int k, unsigned short& value) {
+		if (value != label) return;
+
+		vtkIdType index = GetIndex(e, i, j, k);
+
+		int left = i > e[0] ? ids[index - 1] : 0;
+		int below = j > e[2] ? ids[index - nx] : 0;
+		int behind = k > e[4] ? ids[index - sliceSize] : 0;
+
+		ids[index] = Merge(sets, left, below, behind);
+	});
+
+	// Gather components by root
+	std::vector<int> rootComponents(sets.Size(), -1);
+
+	VoxelIterator::ForEach<unsigned short>(labels, e, [&](int i, int j, int k, unsigned short& value) {
+		vtkIdType index = GetIndex(e, i, j, k);
+
+		if (!ids[index]) return;
+
+		int root = sets.Find(ids[index]);
+		int& c = rootComponents[root];
+
+		if (c < 0) {
+			c = (int)components.size();
+
+			Component component = { 0, { i, i, j, j, k, k }, { i, j, k } };
+			components.push_back(component);
+		}
+
+		Component& component = components[c];
+		component.numVoxels++;
+		component.extent[0] = std::min(component.extent[0], i);
+		component.extent[1] = std::max(component.extent[1], i);
+		component.extent[2] = std::min(component.extent[2], j);
+		component.extent[3] = std::max(component.extent[3], j);
+		component.extent[4] = std::min(component.extent[4], k);
+		component.extent[5] = std::max(component.extent[5], k);
+
+		ids[index] = root;
+	});
+
+	// Largest first, keeping scan order for ties
+	std::vector<int> order(components.size());
+	for (int i = 0; i < (int)order.size(); i++) order[i] = i;
+
+	std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+		return components[a].numVoxels > components[b].numVoxels;
+	});
+
+	std::vector<int> rank(components.size());
+	std::vector<Component> sorted(components.size());
+
+	for (int i = 0; i < (int)order.size(); i++) {
+		rank[order[i]] = i + 1;
+		sorted[i] = components[order[i]];
+	}
+
+	for (int root = 0; root < (int)rootComponents.size(); root++) {
+		if (rootComponents[root] >= 0) rootComponents[root] = rank[rootComponents[root]];
+	}
+
+	for (vtkIdType i = 0; i < (vtkIdType)ids.size(); i++) {
+		if (ids[i]) ids[i] = rootComponents[ids[i]];
+	}
+
+	components.swap(sorted);
+
+	return (int)components.size();
+}
+
+void LabelComponents::Validate(vtkImageData* labels, unsigned short label, const int extent[6], Report& report) {
+	report.fragments.clear();
+	report.holes.clear();
+
+	int e[6];
+	if (!VoxelIterator::ClampExtent(labels, extent, e)) return;
+
+	int nx = e[1] - e[0] + 1;
+	int ny = e[3] - e[2] + 1;
+	vtkIdType sliceSize = (vtkIdType)nx * ny;
+
+	// Provisional ids for the previous and current slice, for voxels of the label and other voxels
+	std::vector<int> previous(sliceSize, 0);
+	std::vector<int> current(sliceSize, 0);
+
+	UnionFind sets;
+
+	// Per provisional id, combined into roots at the end
+	std::vector<Component> stats(1);
+	std::vector<char> isLabel(1, 0);
+	std::vector<char> onEdge(1, 0);
+
+	for (int k = e[4]; k <= e[5]; k++) {
+		for (int j = e[2]; j <= e[3]; j++) {
+			const unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(e[0], j, k));
+			vtkIdType index = (vtkIdType)(j - e[2]) * nx;
+
+			for (int x = 0; x < nx; x++, index++) {
+				char in = row[x] == label;
+				int i = e[0] + x;
+
+				// Only merge with neighbors of the same kind
+				int left = x > 0 ? current[index - 1] : 0;
+				int below = j > e[2] ? current[index - nx] : 0;
+				int behind = k > e[4] ? previous[index] : 0;
+
+				if (isLabel[left] != in) left = 0;
+				if (isLabel[below] != in) below = 0;
+				if (isLabel[behind] != in) behind = 0;
+
+				int id = Merge(sets, left, below, behind);
+
+				if (id == (int)stats.size()) {
+					Component component = { 0, { i, i, j, j, k, k }, { i, j, k } };
+					stats.push_back(component);
+					isLabel.push_back(in);
+					onEdge.push_back(0);
+				}
+
+				Component& component = stats[id];
+				component.numVoxels++;
+				component.extent[0] = std::min(component.extent[0], i);
+				component.extent[1] = std::max(component.extent[1], i);
+				component.extent[2] = std::min(component.extent[2], j);
+				component.extent[3] = std::max(component.extent[3], j);
+				component.extent[4] = std::min(component.extent[4], k);
+				component.extent[5] = std::max(component.extent[5], k);
+
+				if (x == 0 || x == nx - 1 || j == e[2] || j == e[3] || k == e[4] || k == e[5]) onEdge[id] = 1;
+
+				current[index] = id;
+			}
+		}
+
+		current.swap(previous);
+	}
+
+	// Roots are the first id of their set, so keep the first voxel
+	for (int id = 1; id < (int)stats.size(); id++) {
+		int root = sets.Find(id);
+
+		if (root == id) continue;
+
+		Component& component = stats[root];
+		const Component& other = stats[id];
+
+		component.numVoxels += other.numVoxels;
+
+		for (int i = 0; i < 3; i++) {
+			component.extent[2 * i] = std::min(component.extent[2 * i], other.extent[2 * i]);
+			component.extent[2 * i + 1] = std::max(component.extent[2 * i + 1], other.extent[2 * i + 1]);
+		}
+
+		onEdge[root] |= onEdge[id];
+	}
+
+	for (int id = 1; id < (int)stats.size(); id++) {
+		if (sets.Find(id) != id) continue;
+
+		if (isLabel[id]) report.fragments.push_back(stats[id]);
+		else if (!onEdge[id]) report.holes.push_back(stats[id]);
+	}
+
+	SortLargestFirst(report.fragments);
+	SortLargestFirst(report.holes);
+}
+
+vtkIdType LabelComponents::GetIndex(const int extent[6], int i, int j, int k) {
+	int nx = extent[1] - extent[0] + 1;
+	int ny = extent[3] - extent[2] + 1;
+
+	return (i - extent[0]) + nx * ((vtkIdType)(j - extent[2]) + (vtkIdType)ny * (k - extent[4]));
+}
@@ -0,0 +1,48 @@
+#ifndef LabelComponents_H
+#define LabelComponents_H
+
+#include <vector>
+
+#include <vtkType.h>
+
+class vtkImageData;
+
+// Face-connected components of one label within an extent, found with a union-find over a single
+// scan of the extent, so analyzing a region costs O(region extent) rather than a pass over the
+// whole volume. Validation also finds holes, as components of other voxels that do not reach the
+// edge of the extent, in the same scan.
+class LabelComponents {
+public:
+	struct Component {
+		vtkIdType numVoxels;
+		int extent[6];
+
+		// First voxel in memory order
+		int voxel[3];
+	};
+
+	// Components largest first
+	struct Report {
+		std::vector<Component> fragments;
+		std::vector<Component> holes;
+	};
+
+	// Components largest first. Component ids per voxel of the extent, in memory order, are the
+	// component's position plus one, with zero for other labels. Returns the number of components.
+	static int Label(vtkImageData* labels, unsigned short label, const int extent[6], std::vector<int>& ids, std::vector<Component>& components);
+
+	// Fragments of the label and holes in it. Provisional ids are kept for two slices, but the
+	// union-find and per-id stats grow with the number of provisional ids, up to one per voxel of
+	// the extent in the worst case. The extent should be padded so that voxels around the label
+	// connect along its edge.
+	static void Validate(vtkImageData* labels, unsigned short label, const int extent[6], Report& report);
+
+	// Index of a voxel in the ids for an extent
+	static vtkIdType GetIndex(const int extent[6], int i, int j, int k);
+
+private:
+	LabelComponents();
+	~LabelComponents();
+};
+
+#endif
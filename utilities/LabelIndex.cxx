@@ -0,0 +1,148 @@
+#include "LabelIndex.h"
+
+#include <algorithm>
+
+#include <vtkImageData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+namespace {
+	struct Accumulator {
+		vtkIdType numVoxels;
+		int extent[6];
+	};
+
+	// Accumulate per-label stats for rows of the label data, with one set of accumulators per thread
+	class ComputeStats {
+	public:
+		ComputeStats(vtkImageData* labels, int maxLabel) : maxLabel(maxLabel) {
+			labels->GetExtent(extent);
+			data = static_cast<unsigned short*>(labels->GetScalarPointer());
+			nx = extent[1] - extent[0] + 1;
+			ny = extent[3] - extent[2] + 1;
+		}
+
+		void Initialize() {
+			Accumulator empty;
+			empty.numVoxels = 0;
+			empty.extent[0] = empty.extent[2] = empty.extent[4] = VTK_INT_MAX;
+			empty.extent[1] = empty.extent[3] = empty.extent[5] = VTK_INT_MIN;
+
+			localStats.Local().assign(maxLabel + 1, empty);
+		}
+
+		void operator()(vtkIdType begin, vtkIdType end) {
+			std::vector<Accumulator>& acc = localStats.Local();
+
+			for (vtkIdType row = begin; row < end; row++) {
+				int j = extent[2] + (int)(row % ny);
+				int k = extent[4] + (int)(row / ny);
+
+				const unsigned short* p = data + row * nx;
+
+				for (int i = 0; i < nx; i++) {
+					unsigned short label = p[i];
+
+					if (label == 0) continue;
+
+					Accumulator& a = acc[label];
+					int x = extent[0] + i;
+
+					a.numVoxels++;
+
+					if (x < a.extent[0]) a.extent[0] = x;
+					if (x > a.extent[1]) a.extent[1] = x;
+					if (j < a.extent[2]) a.extent[2] = j;
+					if (j > a.extent[3]) a.extent[3] = j;
+					if (k < a.extent[4]) a.extent[4] = k;
+					if (k > a.extent[5]) a.extent[5] = k;
+				}
+			}
+		}
+
+		void Reduce() {
+			vtkSMPThreadLocal<std::vector<Accumulator>>::iterator it = localStats.begin();
+
+			result = *it;
+
+			for (it++; it != localStats.end(); it++) {
+				for (int label = 1; label <= maxLabel; label++) {
+					const Accumulator& a = (*it)[label];
+					Accumulator& r = result[label];
+
+					if (a.numVoxels == 0) continue;
+
+					r.numVoxels += a.numVoxels;
+
+					for (int i = 0; i < 3; i++) {
+						r.extent[2 * i] = std::min(r.extent[2 * i], a.extent[2 * i]);
+						r.extent[2 * i + 1] = std::max(r.extent[2 * i + 1], a.extent[2 * i + 1]);
+					}
+				}
+			}
+		}
+
+		std::vector<Accumulator> result;
+
+	protected:
+		const unsigned short* data;
+		int extent[6];
+		int nx;
+		int ny;
+		int maxLabel;
+
+		vtkSMPThreadLocal<std::vector<Accumulator>> localStats;
+	};
+}
+
+LabelIndex::LabelIndex() {
+	Clear();
+}
+
+LabelIndex::~LabelIndex() {
+}
+
+void LabelIndex::Compute(vtkImageData* labels) {
+	Clear();
+
+	int maxLabel = (int)labels->GetScalarRange()[1];
+
+	int extent[6];
+	labels->GetExtent(extent);
+
+	vtkIdType numRows = (vtkIdType)(extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+
+	if (maxLabel < 1 || numRows <= 0) return;
+
+	ComputeStats compute(labels, maxLabel);
+	vtkSMPTools::For(0, numRows, compute);
+
+	stats.resize(maxLabel + 1);
+
+	for (int label = 0; label <= maxLabel; label++) {
+		const Accumulator& a = compute.result[label];
+		LabelStats& s = stats[label];
+
+		s.numVoxels = label > 0 ? a.numVoxels : 0;
+
+		for (int i = 0; i < 6; i++) {
+			s.extent[i] = a.extent[i];
+		}
+	}
+}
+
+void LabelIndex::Clear() {
+	stats.clear();
+}
+
+int LabelIndex::GetMaxLabel() {
+	return (int)stats.size() - 1;
+}
+
+bool LabelIndex::Has(unsigned short label) {
+	return label < stats.size() && stats[label].numVoxels > 0;
+}
+
+const LabelIndex::LabelStats& LabelIndex::Get(unsigned short label) {
+	return stats[label];
+}
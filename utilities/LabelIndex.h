@@ -0,0 +1,32 @@
+#ifndef LabelIndex_H
+#define LabelIndex_H
+
+#include <vtkType.h>
+
+#include <vector>
+
+class vtkImageData;
+
+// Extent and voxel count for every label, computed in a single parallel pass
+class LabelIndex {
+public:
+	struct LabelStats {
+		vtkIdType numVoxels;
+		int extent[6];
+	};
+
+	LabelIndex();
+	~LabelIndex();
+
+	void Compute(vtkImageData* labels);
+	void Clear();
+
+	int GetMaxLabel();
+	bool Has(unsigned short label);
+	const LabelStats& Get(unsigned short label);
+
+protected:
+	std::vector<LabelStats> stats;
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "LabelNeighbors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+
+std::vector<unsigned short> LabelNeighbors::Find(vtkImageData* labels, unsigned short label, const int extent[6], double distance) {
+	const int* dataExtent = labels->GetExtent();
+	const double* spacing = labels->GetSpacing();
+
+	distance = std::max(0.0, distance);
+
+	// Furthest offset along each axis with a gap within the distance
+	int window[3];
+	int grown[6];
+	int dims[3];
+
+	for (int a = 0; a < 3; a++) {
+		window[a] = (int)std::floor(distance / spacing[a]) + 1;
+
+		grown[2 * a] = std::max(dataExtent[2 * a], extent[2 * a] - window[a]);
+		grown[2 * a + 1] = std::min(dataExtent[2 * a + 1], extent[2 * a + 1] + window[a]);
+
+		dims[a] = grown[2 * a + 1] - grown[2 * a] + 1;
+
+		if (dims[a] <= 0) return std::vector<unsigned short>();
+	}
+
+	vtkIdType stride[3] = { 1, dims[0], (vtkIdType)dims[0] * dims[1] };
+	vtkIdType numVoxels = stride[2] * dims[2];
+
+	const float infinity = std::numeric_limits<float>::infinity();
+
+	// Squared distance to the label, zero on it. Single precision, as this spans the grown extent.
+	std::vector<float> d2(numVoxels);
+
+	vtkSMPTools::For(0, dims[2], [&](vtkIdType begin, vtkIdType end) {
+		for (vtkIdType k = begin; k < end; k++) {
+			for (int j = 0; j < dims[1]; j++) {
+				const unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(grown[0], grown[2] + j, grown[4] + (int)k));
+				float* out = &d2[j * stride[1] + k * stride[2]];
+
+				for (int i = 0; i < dims[0]; i++) {
+					out[i] = row[i] == label ? 0.0f : infinity;
+				}
+			}
+		}
+	});
+
+	// The squared gap is a sum over axes, so it can be minimized one axis at a time
+	for (int a = 0; a < 3; a++) {
+		int u = a == 0 ? 1 : 0;
+		int v = a == 2 ? 1 : 2;
+
+		int length = dims[a];
+		int w = window[a];
+		double s = spacing[a];
+
+		vtkSMPTools::For(0, (vtkIdType)dims[u] * dims[v], [&](vtkIdType begin, vtkIdType end) {
+			std::vector<float> line(length);
+
+			for (vtkIdType l = begin; l < end; l++) {
+				float* p = &d2[(l % dims[u]) * stride[u] + (l / dims[u]) * stride[v]];
+
+				for (int i = 0; i < length; i++) {
+					line[i] = p[i * stride[a]];
+				}
+
+				for (int i = 0; i < length; i++) {
+					float best = line[i];
+
+					int first = std::max(0, i - w);
+					int last = std::min(length - 1, i + w);
+
+					for (int j = first; j <= last; j++) {
+						if (line[j] == infinity) continue;
+
+						double gap = std::max(0, std::abs(i - j) - 1) * s;
+
+						best = std::min(best, (float)(line[j] + gap * gap));
+					}
+
+					p[i * stride[a]] = best;
+				}
+			}
+		});
+	}
+
+	// One sweep for labels within the distance, allowing for rounding of gaps right at it
+	float maxD2 = (float)(distance * distance * (1.0 + 1e-5));
+
+	std::vector<bool> found(VTK_UNSIGNED_SHORT_MAX + 1, false);
+
+	for (int k = 0; k < dims[2]; k++) {
+		for (int j = 0; j < dims[1]; j++) {
+			const unsigned short* row = static_cast<unsigned short*>(labels->GetScalarPointer(grown[0], grown[2] + j, grown[4] + k));
+			const float* rowD2 = &d2[j * stride[1] + k * stride[2]];
+
+			for (int i = 0; i < dims[0]; i++) {
+				if (row[i] != 0 && row[i] != label && rowD2[i] <= maxD2) found[row[i]] = true;
+			}
+		}
+	}
+
+	std::vector<unsigned short> neighbors;
+
+	for (int i = 1; i <= VTK_UNSIGNED_SHORT_MAX; i++) {
+		if (found[i]) neighbors.push_back((unsigned short)i);
+	}
+
+	return neighbors;
+}
@@ -0,0 +1,22 @@
+#ifndef LabelNeighbors_H
+#define LabelNeighbors_H
+
+#include <vector>
+
+class vtkImageData;
+
+// Finds labels near a label with a distance transform of the label's voxels, bounded by the search
+// distance and computed over the label's extent grown by it, then one sweep of that extent.
+// Distances are gaps between voxels in world units, so touching voxels are at distance zero and
+// anisotropic spacing is honored.
+class LabelNeighbors {
+public:
+	// Labels other than the given label and zero with a voxel within the distance, in order
+	static std::vector<unsigned short> Find(vtkImageData* labels, unsigned short label, const int extent[6], double distance);
+
+private:
+	LabelNeighbors();
+	~LabelNeighbors();
+};
+
+#endif
@@ -0,0 +1,271 @@
+#include "MappedVolumeIO.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkVersionMacros.h>
+
+namespace {
+	// Mappings keyed by the data pointer given to the scalar array, as the free function only receives that pointer
+	struct Mapping {
+		void* base;
+		size_t length;
+	};
+
+	std::mutex mappingsMutex;
+	std::map<void*, Mapping> mappings;
+
+	void Unmap(void* data) {
+		std::lock_guard<std::mutex> lock(mappingsMutex);
+
+		std::map<void*, Mapping>::iterator it = mappings.find(data);
+
+		if (it == mappings.end()) return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(it->second.base);
+#else
+		munmap(it->second.base, it->second.length);
+#endif
+
+		mappings.erase(it);
+	}
+
+	// Map the whole file copy-on-write, returning nullptr on failure
+	void* MapFile(const std::string& fileName, size_t& length) {
+#ifdef _WIN32
+		HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+		if (file == INVALID_HANDLE_VALUE) return nullptr;
+
+		LARGE_INTEGER size;
+
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return nullptr;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+		CloseHandle(file);
+
+		if (!mapping) return nullptr;
+
+		// The view keeps the mapping open
+		void* base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		CloseHandle(mapping);
+
+		length = (size_t)size.QuadPart;
+
+		return base;
+#else
+		int file = open(fileName.c_str(), O_RDONLY);
+
+		if (file < 0) return nullptr;
+
+		struct stat info;
+
+		if (fstat(file, &info) != 0 || info.st_size == 0) {
+			close(file);
+			return nullptr;
+		}
+
+		length = (size_t)info.st_size;
+
+		// The mapping stays valid after closing the file
+		void* base = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+		close(file);
+
+		return base == MAP_FAILED ? nullptr : base;
+#endif
+	}
+
+	int ScalarType(std::string type) {
+		// Remove optional qualifier
+		if (type.compare(0, 7, "signed ") == 0) type.erase(0, 7);
+
+		if (type == "uchar" || type == "unsigned char" || type == "uint8" || type == "uint8_t") return VTK_UNSIGNED_CHAR;
+		if (type == "char" || type == "int8" || type == "int8_t") return VTK_SIGNED_CHAR;
+		if (type == "ushort" || type == "unsigned short" || type == "unsigned short int" || type == "uint16" || type == "uint16_t") return VTK_UNSIGNED_SHORT;
+		if (type == "short" || type == "short int" || type == "int16" || type == "int16_t") return VTK_SHORT;
+		if (type == "uint" || type == "unsigned int" || type == "uint32" || type == "uint32_t") return VTK_UNSIGNED_INT;
+		if (type == "int" || type == "int32" || type == "int32_t") return VTK_INT;
+		if (type == "float") return VTK_FLOAT;
+		if (type == "double") return VTK_DOUBLE;
+
+		return VTK_VOID;
+	}
+
+	bool LittleEndian() {
+		const unsigned short one = 1;
+		return *(const unsigned char*)&one == 1;
+	}
+}
+
+MappedVolumeIO::MappedVolumeIO() {
+}
+
+MappedVolumeIO::~MappedVolumeIO() {
+}
+
+vtkSmartPointer<vtkImageData> MappedVolumeIO::Read(const std::string& fileName) {
+#if VTK_MAJOR_VERSION < 8 || (VTK_MAJOR_VERSION == 8 && VTK_MINOR_VERSION < 1)
+	// Arrays cannot release a mapping before VTK 8.1, so callers fall back to reading a copy
+	return nullptr;
+#else
+	std::ifstream header(fileName.c_str(), std::ios::binary);
+
+	std::string line;
+
+	if (!std::getline(header, line) || line.compare(0, 4, "NRRD") != 0) return nullptr;
+
+	// Parse header fields
+	std::map<std::string, std::string> fields;
+
+	while (std::getline(header, line)) {
+		if (!line.empty() && line.back() == '\r') line.pop_back();
+
+		// Blank line ends the header
+		if (line.empty()) break;
+
+		// Comments and key/value pairs
+		if (line[0] == '#' || line.find(":=") != std::string::npos) continue;
+
+		std::string::size_type colon = line.find(": ");
+
+		if (colon == std::string::npos) continue;
+
+		fields[line.substr(0, colon)] = line.substr(colon + 2);
+	}
+
+	// Offset of attached data
+	std::streamoff headerSize = header.tellg();
+
+	if (fields["dimension"] != "3") return nullptr;
+	if (fields["encoding"] != "raw") return nullptr;
+	if (fields.count("line skip") > 0 && fields["line skip"] != "0") return nullptr;
+
+	int scalarType = ScalarType(fields["type"]);
+
+	if (scalarType == VTK_VOID) return nullptr;
+
+	int scalarSize = vtkDataArray::GetDataTypeSize(scalarType);
+
+	// Byte order must match, as the data is used in place
+	if (scalarSize > 1 && fields.count("endian") > 0 && (fields["endian"] == "little") != LittleEndian()) return nullptr;
+
+	int dimensions[3];
+	std::istringstream sizes(fields["sizes"]);
+	if (!(sizes >> dimensions[0] >> dimensions[1] >> dimensions[2])) return nullptr;
+
+	double spacing[3] = { 1.0, 1.0, 1.0 };
+
+	if (fields.count("spacings") > 0) {
+		std::istringstream spacings(fields["spacings"]);
+		for (int i = 0; i < 3; i++) {
+			double s;
+			if (spacings >> s && s > 0) spacing[i] = s;
+		}
+	}
+	else if (fields.count("space directions") > 0) {
+		// Vectors formatted as (x,y,z)
+		std::string directions = fields["space directions"];
+		std::replace(directions.begin(), directions.end(), '(', ' ');
+		std::replace(directions.begin(), directions.end(), ')', ' ');
+		std::replace(directions.begin(), directions.end(), ',', ' ');
+
+		std::istringstream vectors(directions);
+		for (int i = 0; i < 3; i++) {
+			double v[3];
+			if (!(vectors >> v[0] >> v[1] >> v[2])) break;
+
+			double s = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			if (s > 0) spacing[i] = s;
+		}
+	}
+
+	// Data file, relative to the header for detached headers
+	std::string dataFileName = fileName;
+	std::streamoff offset = headerSize;
+
+	std::string dataFile = fields.count("data file") > 0 ? fields["data file"] : fields["datafile"];
+
+	if (!dataFile.empty()) {
+		// Lists of files are not supported
+		if (dataFile.compare(0, 4, "LIST") == 0 || dataFile.find('%') != std::string::npos) return nullptr;
+
+		std::string::size_type slash = fileName.find_last_of("/\\");
+
+		dataFileName = dataFile[0] == '/' || slash == std::string::npos ? dataFile : fileName.substr(0, slash + 1) + dataFile;
+		offset = 0;
+	}
+	else if (headerSize < 0) {
+		return nullptr;
+	}
+
+	if (fields.count("byte skip") > 0) {
+		std::streamoff skip = std::atoll(fields["byte skip"].c_str());
+
+		// Skipping from the end of the file is not supported
+		if (skip < 0) return nullptr;
+
+		offset += skip;
+	}
+
+	// Scalars must be aligned to be used in place
+	if (offset % scalarSize != 0) return nullptr;
+
+	vtkIdType numValues = (vtkIdType)dimensions[0] * dimensions[1] * dimensions[2];
+	size_t dataSize = (size_t)numValues * scalarSize;
+
+	size_t length;
+	void* base = MapFile(dataFileName, length);
+
+	if (!base) return nullptr;
+
+	if ((size_t)offset + dataSize > length) {
+#ifdef _WIN32
+		UnmapViewOfFile(base);
+#else
+		munmap(base, length);
+#endif
+		return nullptr;
+	}
+
+	void* data = (char*)base + offset;
+
+	{
+		std::lock_guard<std::mutex> lock(mappingsMutex);
+		mappings[data] = { base, length };
+	}
+
+	// Wrap the mapping
+	vtkSmartPointer<vtkDataArray> scalars = vtkSmartPointer<vtkDataArray>::Take(vtkDataArray::CreateDataArray(scalarType));
+	scalars->SetNumberOfComponents(1);
+	scalars->SetVoidArray(data, numValues, 0, vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+	scalars->SetArrayFreeFunction(Unmap);
+
+	vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+	image->SetDimensions(dimensions);
+	image->SetSpacing(spacing);
+	image->GetPointData()->SetScalars(scalars);
+
+	return image;
+#endif
+}
@@ -0,0 +1,23 @@
+#ifndef MappedVolumeIO_H
+#define MappedVolumeIO_H
+
+#include <string>
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+
+// Open uncompressed NRRD volumes (attached .nrrd, or a .nhdr header with a detached raw data file) by
+// memory mapping the data. The scalar array wraps the mapping without copying, and is mapped
+// copy-on-write so edits are never written back to the file. The mapping is released with the array.
+class MappedVolumeIO {
+public:
+	// Returns nullptr if the file cannot be mapped, e.g. compressed encoding, non-native byte order, or VTK older than 8.1
+	static vtkSmartPointer<vtkImageData> Read(const std::string& fileName);
+
+private:
+	MappedVolumeIO();
+	~MappedVolumeIO();
+};
+
+#endif
@@ -0,0 +1,115 @@
+#include "TIFFStackReader.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include <vtkImageData.h>
+#include <vtkTIFFReader.h>
+
+namespace {
+	// Read a single slice, checking it matches the volume
+	bool ReadSlice(vtkTIFFReader* reader, const std::string& fileName, vtkImageData* volume, int slice) {
+		reader->SetFileName(fileName.c_str());
+		reader->Update();
+
+		vtkImageData* image = reader->GetOutput();
+
+		int* dims = image->GetDimensions();
+		int* volumeDims = volume->GetDimensions();
+
+		if (dims[0] != volumeDims[0] || dims[1] != volumeDims[1] || dims[2] != 1 ||
+			image->GetScalarType() != volume->GetScalarType() ||
+			image->GetNumberOfScalarComponents() != volume->GetNumberOfScalarComponents()) {
+			return false;
+		}
+
+		size_t sliceSize = (size_t)dims[0] * dims[1] * volume->GetScalarSize() * volume->GetNumberOfScalarComponents();
+
+		memcpy(static_cast<char*>(volume->GetScalarPointer()) + sliceSize * slice, image->GetScalarPointer(), sliceSize);
+
+		return true;
+	}
+}
+
+TIFFStackReader::TIFFStackReader() {
+}
+
+TIFFStackReader::~TIFFStackReader() {
+}
+
+vtkSmartPointer<vtkImageData> TIFFStackReader::Read(const std::vector<std::string>& fileNames, std::function<void(double)> progress) {
+	int numSlices = (int)fileNames.size();
+
+	if (numSlices == 0) return nullptr;
+
+	// Get volume info from the first slice
+	vtkSmartPointer<vtkTIFFReader> firstReader = vtkSmartPointer<vtkTIFFReader>::New();
+	firstReader->SetFileName(fileNames[0].c_str());
+	firstReader->Update();
+
+	vtkImageData* first = firstReader->GetOutput();
+	int* dims = first->GetDimensions();
+
+	if (dims[0] == 0 || dims[1] == 0 || dims[2] != 1 || first->GetNumberOfPoints() == 0) return nullptr;
+
+	vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+	volume->SetDimensions(dims[0], dims[1], numSlices);
+	volume->SetSpacing(first->GetSpacing());
+	volume->AllocateScalars(first->GetScalarType(), first->GetNumberOfScalarComponents());
+
+	// Reuse the first slice rather than decoding it again
+	size_t sliceSize = (size_t)dims[0] * dims[1] * volume->GetScalarSize() * volume->GetNumberOfScalarComponents();
+	memcpy(volume->GetScalarPointer(), first->GetScalarPointer(), sliceSize);
+
+	// One reader per thread, created here as object creation is not thread safe. Constructing a
+	// vtkTIFFReader also installs libtiff's process-wide error and warning handlers, so that only
+	// happens on this thread, before any worker starts. Workers only call the installed handlers,
+	// which ignore the message and touch no shared state.
+	int numThreads = std::max(1, std::min((int)std::thread::hardware_concurrency(), numSlices - 1));
+
+	std::vector<vtkSmartPointer<vtkTIFFReader>> readers(numThreads);
+	readers[0] = firstReader;
+
+	for (int i = 1; i < numThreads; i++) {
+		readers[i] = vtkSmartPointer<vtkTIFFReader>::New();
+	}
+
+	std::atomic<int> nextSlice(1);
+	std::atomic<int> numRead(1);
+	std::atomic<bool> failed(false);
+
+	std::vector<std::thread> threads;
+
+	for (int i = 0; i < numThreads; i++) {
+		threads.push_back(std::thread([&, i]() {
+			for (int slice = nextSlice++; slice < numSlices && !failed; slice = nextSlice++) {
+				if (!ReadSlice(readers[i], fileNames[slice], volume, slice)) {
+					failed = true;
+					break;
+				}
+
+				numRead++;
+			}
+		}));
+	}
+
+	// Report progress while waiting
+	while (progress && numRead < numSlices && !failed) {
+		progress((double)numRead / numSlices);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	}
+
+	for (int i = 0; i < numThreads; i++) {
+		threads[i].join();
+	}
+
+	if (failed) return nullptr;
+
+	if (progress) progress(1.0);
+
+	return volume;
+}
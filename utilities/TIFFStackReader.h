@@ -0,0 +1,25 @@
+#ifndef TIFFStackReader_H
+#define TIFFStackReader_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <vtkSmartPointer.h>
+
+class vtkImageData;
+
+// Read a stack of single-image TIFF files, one per slice, decoding slices concurrently into a
+// preallocated volume. Compressed slices are decoded by libtiff on each worker thread.
+class TIFFStackReader {
+public:
+	// Progress is reported on the calling thread. Returns nullptr if slices are missing or
+	// do not match the first slice.
+	static vtkSmartPointer<vtkImageData> Read(const std::vector<std::string>& fileNames, std::function<void(double)> progress = nullptr);
+
+private:
+	TIFFStackReader();
+	~TIFFStackReader();
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef VoxelIterator_H
+#define VoxelIterator_H
+
+#include <algorithm>
+
+#include <vtkImageData.h>
+#include <vtkSMPTools.h>
+
+// Iterate over an extent of single-component image data in memory order (x fastest) using raw
+// typed pointers. Functors are called as f(i, j, k, value), with value a reference to the scalar.
+class VoxelIterator {
+public:
+	// Clamp the extent to the data extent, returning false if empty
+	static bool ClampExtent(vtkImageData* data, const int extent[6], int clampedExtent[6]) {
+		int dataExtent[6];
+		data->GetExtent(dataExtent);
+
+		for (int i = 0; i < 3; i++) {
+			clampedExtent[2 * i] = std::max(extent[2 * i], dataExtent[2 * i]);
+			clampedExtent[2 * i + 1] = std::min(extent[2 * i + 1], dataExtent[2 * i + 1]);
+
+			if (clampedExtent[2 * i] > clampedExtent[2 * i + 1]) return false;
+		}
+
+		return true;
+	}
+
+	template <typename T, typename Functor>
+	static void ForEach(vtkImageData* data, const int extent[6], Functor&& f) {
+		Span<T> span(data, extent);
+
+		if (span.empty) return;
+
+		span.ForRows(0, span.numRows, f);
+	}
+
+	// Rows are processed in parallel, so the functor must be thread safe
+	template <typename T, typename Functor>
+	static void ParallelForEach(vtkImageData* data, const int extent[6], Functor&& f) {
+		Span<T> span(data, extent);
+
+		if (span.empty) return;
+
+		RowFunctor<T, Functor> rows(span, f);
+		vtkSMPTools::For(0, span.numRows, rows);
+	}
+
+	// Call f(i, j, k, value1, value2) for two images that both contain the extent
+	template <typename T1, typename T2, typename Functor>
+	static void ForEachPair(vtkImageData* data1, vtkImageData* data2, const int extent[6], Functor&& f) {
+		int clampedExtent[6];
+		if (!ClampExtent(data1, extent, clampedExtent) || !ClampExtent(data2, clampedExtent, clampedExtent)) return;
+
+		Span<T1> span1(data1, clampedExtent);
+		Span<T2> span2(data2, clampedExtent);
+
+		if (span1.empty) return;
+
+		for (vtkIdType row = 0; row < span1.numRows; row++) {
+			int j, k;
+			T1* p1 = span1.Row(row, j, k);
+			T2* p2 = span2.Row(row, j, k);
+
+			for (int i = span1.extent[0]; i <= span1.extent[1]; i++, p1++, p2++) {
+				f(i, j, k, *p1, *p2);
+			}
+		}
+	}
+
+	// Return true and the index of the first voxel in memory order for which the predicate is true
+	template <typename T, typename Predicate>
+	static bool Find(vtkImageData* data, const int extent[6], Predicate&& predicate, int ijk[3]) {
+		Span<T> span(data, extent);
+
+		if (span.empty) return false;
+
+		for (vtkIdType row = 0; row < span.numRows; row++) {
+			int j, k;
+			T* p = span.Row(row, j, k);
+
+			for (int i = span.extent[0]; i <= span.extent[1]; i++, p++) {
+				if (predicate(*p)) {
+					ijk[0] = i;
+					ijk[1] = j;
+					ijk[2] = k;
+
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+protected:
+	// Rows of an extent, each contiguous in memory
+	template <typename T>
+	struct Span {
+		Span(vtkImageData* data, const int inputExtent[6]) {
+			empty = !ClampExtent(data, inputExtent, extent);
+
+			if (empty) return;
+
+			vtkIdType increments[3];
+			data->GetIncrements(increments);
+
+			rowIncrement = increments[1];
+			sliceIncrement = increments[2];
+
+			ny = extent[3] - extent[2] + 1;
+			numRows = (vtkIdType)ny * (extent[5] - extent[4] + 1);
+
+			origin = static_cast<T*>(data->GetScalarPointer(extent[0], extent[2], extent[4]));
+		}
+
+		T* Row(vtkIdType row, int& j, int& k) {
+			int jOffset = (int)(row % ny);
+			int kOffset = (int)(row / ny);
+
+			j = extent[2] + jOffset;
+			k = extent[4] + kOffset;
+
+			return origin + kOffset * sliceIncrement + jOffset * rowIncrement;
+		}
+
+		template <typename Functor>
+		void ForRows(vtkIdType begin, vtkIdType end, Functor& f) {
+			for (vtkIdType row = begin; row < end; row++) {
+				int j, k;
+				T* p = Row(row, j, k);
+
+				for (int i = extent[0]; i <= extent[1]; i++, p++) {
+					f(i, j, k, *p);
+				}
+			}
+		}
+
+		bool empty;
+		int extent[6];
+		int ny;
+		vtkIdType numRows;
+		vtkIdType rowIncrement;
+		vtkIdType sliceIncrement;
+		T* origin;
+	};
+
+	template <typename T, typename Functor>
+	struct RowFunctor {
+		RowFunctor(Span<T>& span, Functor& f) : span(span), f(f) {}
+
+		void operator()(vtkIdType begin, vtkIdType end) {
+			span.ForRows(begin, end, f);
+		}
+
+		Span<T>& span;
+		Functor& f;
+	};
+
+private:
+	VoxelIterator();
+	~VoxelIterator();
+};
+
+#endif
@@ -0,0 +1,201 @@
+// Times the label loops ported to VoxelIterator against the per-voxel GetScalarPointer loops they
+// replaced, on a synthetic label volume.
+//
+// Usage: VoxelIteratorBenchmark [size] [repeats]
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "VoxelIterator.h"
+
+namespace {
+	// Spheres of labels on a background of zeros, roughly like a segmentation
+	vtkSmartPointer<vtkImageData> CreateLabels(int size) {
+		vtkSmartPointer<vtkImageData> labels = vtkSmartPointer<vtkImageData>::New();
+		labels->SetDimensions(size, size, size);
+		labels->AllocateScalars(VTK_UNSIGNED_SHORT, 1);
+
+		int cell = std::max(4, size / 8);
+		double radius2 = (cell / 2.0) * (cell / 2.0);
+
+		VoxelIterator::ForEach<unsigned short>(labels, labels->GetExtent(), [&](int i, int j, int k, unsigned short& value) {
+			int ci = i / cell;
+			int cj = j / cell;
+			int ck = k / cell;
+
+			double di = i - (ci + 0.5) * cell;
+			double dj = j - (cj + 0.5) * cell;
+			double dk = k - (ck + 0.5) * cell;
+
+			value = di * di + dj * dj + dk * dk < radius2 ? (unsigned short)(1 + ci + 8 * (cj + 8 * ck)) : 0;
+		});
+
+		return labels;
+	}
+
+	template <typename Function>
+	double Time(int repeats, Function function) {
+		double best = 0.0;
+
+		for (int r = 0; r < repeats; r++) {
+			auto start = std::chrono::steady_clock::now();
+			function();
+			double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+			if (r == 0 || ms < best) best = ms;
+		}
+
+		return best;
+	}
+
+	void Report(const char* name, double baseline, double ms) {
+		printf("%-40s %10.2f ms %8.1fx\n", name, ms, baseline / ms);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	int size = argc > 1 ? atoi(argv[1]) : 256;
+	int repeats = argc > 2 ? atoi(argv[2]) : 5;
+
+	vtkSmartPointer<vtkImageData> labels = CreateLabels(size);
+	int* extent = labels->GetExtent();
+
+	const unsigned short label = 1 + 3 + 8 * (3 + 8 * 3);
+	const unsigned short other = VTK_UNSIGNED_SHORT_MAX;
+
+	printf("%d^3 labels, best of %d\n\n", size, repeats);
+
+	// Count voxels of a label, as for region voxel stats
+	vtkIdType count = 0;
+
+	double countPointer = Time(repeats, [&]() {
+		count = 0;
+
+		for (int i = extent[0]; i <= extent[1]; i++) {
+			for (int j = extent[2]; j <= extent[3]; j++) {
+				for (int k = extent[4]; k <= extent[5]; k++) {
+					unsigned short* p = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
+
+					if (*p == label) count++;
+				}
+			}
+		}
+	});
+
+	vtkIdType countCheck = count;
+
+	double countPointerOrdered = Time(repeats, [&]() {
+		count = 0;
+
+		for (int k = extent[4]; k <= extent[5]; k++) {
+			for (int j = extent[2]; j <= extent[3]; j++) {
+				for (int i = extent[0]; i <= extent[1]; i++) {
+					unsigned short* p = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
+
+					if (*p == label) count++;
+				}
+			}
+		}
+	});
+
+	double countIterator = Time(repeats, [&]() {
+		count = 0;
+
+		VoxelIterator::ForEach<unsigned short>(labels, extent, [&](int, int, int, unsigned short& value) {
+			if (value == label) count++;
+		});
+	});
+
+	if (count != countCheck) {
+		printf("Count mismatch: %lld != %lld\n", (long long)count, (long long)countCheck);
+		return 1;
+	}
+
+	printf("Count %lld voxels of label %d\n", (long long)count, label);
+	Report("GetScalarPointer, x outermost", countPointer, countPointer);
+	Report("GetScalarPointer, memory order", countPointer, countPointerOrdered);
+	Report("VoxelIterator::ForEach", countPointer, countIterator);
+	printf("\n");
+
+	// Relabel a label and back, as for merges
+	auto relabel = [](unsigned short& value, unsigned short from, unsigned short to) {
+		if (value == from) value = to;
+	};
+
+	double relabelPointer = Time(repeats, [&]() {
+		for (int pass = 0; pass < 2; pass++) {
+			unsigned short from = pass == 0 ? label : other;
+			unsigned short to = pass == 0 ? other : label;
+
+			for (int i = extent[0]; i <= extent[1]; i++) {
+				for (int j = extent[2]; j <= extent[3]; j++) {
+					for (int k = extent[4]; k <= extent[5]; k++) {
+						relabel(*static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k)), from, to);
+					}
+				}
+			}
+		}
+	});
+
+	double relabelIterator = Time(repeats, [&]() {
+		for (int pass = 0; pass < 2; pass++) {
+			unsigned short from = pass == 0 ? label : other;
+			unsigned short to = pass == 0 ? other : label;
+
+			VoxelIterator::ForEach<unsigned short>(labels, extent, [&](int, int, int, unsigned short& value) {
+				relabel(value, from, to);
+			});
+		}
+	});
+
+	double relabelParallel = Time(repeats, [&]() {
+		for (int pass = 0; pass < 2; pass++) {
+			unsigned short from = pass == 0 ? label : other;
+			unsigned short to = pass == 0 ? other : label;
+
+			VoxelIterator::ParallelForEach<unsigned short>(labels, extent, [&](int, int, int, unsigned short& value) {
+				relabel(value, from, to);
+			});
+		}
+	});
+
+	printf("Relabel and restore label %d\n", label);
+	Report("GetScalarPointer, x outermost", relabelPointer, relabelPointer);
+	Report("VoxelIterator::ForEach", relabelPointer, relabelIterator);
+	Report("VoxelIterator::ParallelForEach", relabelPointer, relabelParallel);
+	printf("\n");
+
+	// Find the first voxel of the label, as for seeds
+	int ijk[3];
+	bool found = false;
+
+	double findPointer = Time(repeats, [&]() {
+		found = false;
+
+		for (int k = extent[4]; k <= extent[5] && !found; k++) {
+			for (int j = extent[2]; j <= extent[3] && !found; j++) {
+				for (int i = extent[0]; i <= extent[1]; i++) {
+					if (*static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k)) == other) {
+						found = true;
+						break;
+					}
+				}
+			}
+		}
+	});
+
+	double findIterator = Time(repeats, [&]() {
+		found = VoxelIterator::Find<unsigned short>(labels, extent, [&](unsigned short value) { return value == other; }, ijk);
+	});
+
+	printf("Find a missing label (full scan)\n");
+	Report("GetScalarPointer, memory order", findPointer, findPointer);
+	Report("VoxelIterator::Find", findPointer, findIterator);
+
+	return found ? 1 : 0;
+}
@@ -3,17 +3,15 @@
 #include <vtkActor.h>
 #include <vtkCutter.h>
 #include <vtkExtractVOI.h>
-#include <vtkGeometryFilter.h>
 #include <vtkImageCast.h>
 #include <vtkImageChangeInformation.h>
 #include <vtkImageData.h>
 #include <vtkPlane.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkProperty.h>
-#include <vtkThreshold.h>
 #include <vtkTransform.h>
 
-#include "vtkImageDataCells.h"
+#include "vtkImageBoundaryFaces.h"
 
 Brush::Brush() {
 	radius = 1;
@@ -28,22 +26,16 @@ Brush::Brush() {
 	info->CenterImageOn();
 	info->SetInputConnection(voi->GetOutputPort());
 
-	vtkSmartPointer<vtkImageDataCells> cells = vtkSmartPointer<vtkImageDataCells>::New();
-	cells->SetInputConnection(info->GetOutputPort());
-	
-	vtkSmartPointer<vtkThreshold> threshold = vtkSmartPointer<vtkThreshold>::New();
-	threshold->ThresholdByUpper(1);
-	threshold->SetInputConnection(cells->GetOutputPort());
-
-	vtkSmartPointer<vtkGeometryFilter> geometry = vtkSmartPointer<vtkGeometryFilter>::New();
-	geometry->SetInputConnection(threshold->GetOutputPort());
+	vtkSmartPointer<vtkImageBoundaryFaces> faces = vtkSmartPointer<vtkImageBoundaryFaces>::New();
+	faces->ThresholdBetween(1, VTK_DOUBLE_MAX);
+	faces->SetInputConnection(info->GetOutputPort());
 
 	vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
 	plane->SetNormal(0, 0, 1);
 
 	vtkSmartPointer<vtkCutter> cut = vtkSmartPointer<vtkCutter>::New();
 	cut->SetCutFunction(plane);
-	cut->SetInputConnection(geometry->GetOutputPort());
+	cut->SetInputConnection(faces->GetOutputPort());
 
 	vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
 	mapper->ScalarVisibilityOff();
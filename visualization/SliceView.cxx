@@ -1,11 +1,13 @@
 #include "SliceView.h"
 
+#include <cmath>
 #include <sstream>
 
 #include "vtkInteractorStyleSlice.h"
-#include "vtkImageDataCells.h"
+#include "vtkImageSliceOutlines.h"
 
 #include <vtkActor.h>
+#include <vtkAlgorithmOutput.h>
 #include <vtkBillboardTextActor3D.h>
 #include <vtkCallbackCommand.h>
 #include <vtkCamera.h>
@@ -33,7 +35,6 @@
 #include "InteractionEnums.h"
 #include "Probe.h"
 #include "Region.h"
-#include "RegionOutline.h"
 #include "RegionSurface.h"
 #include "RegionCenter2D.h"
 #include "RegionCollection.h"
@@ -101,6 +102,10 @@ SliceView::SliceView(vtkRenderWindowInteractor* interactor, vtkLookupTable* lut)
 	CreateSlice();
 	CreateLabelSlice();
 
+	// Region outlines
+	CreateRegionOutlines();
+	regionOutlinesRenderer->AddActor(regionOutlines);
+
 	// Camera callback
 	vtkSmartPointer<vtkCallbackCommand> cameraCallback = vtkSmartPointer<vtkCallbackCommand>::New();
 	cameraCallback->SetCallback(cameraChange);
@@ -132,6 +137,7 @@ SliceView::~SliceView() {
 void SliceView::Reset() {
 	data = nullptr;
 	labels = nullptr;
+	dataSource = nullptr;
 
 	SetCurrentRegion(nullptr);
 
@@ -139,11 +145,13 @@ void SliceView::Reset() {
 	brush->GetActor()->VisibilityOff();
 	sliceLocation->UpdateData(nullptr);
 	interactionModeLabel->VisibilityOff();
+	regionOutlines->VisibilityOff();
 }
 
-void SliceView::SetImageData(vtkImageData* imageData) {
+void SliceView::SetImageData(vtkImageData* imageData, vtkAlgorithmOutput* imageSource) {
 	// Update slice
 	data = imageData;
+	dataSource = imageSource;
 
 	// Turn off rendering to get rid of flicker
 	renderer->DrawOff();
@@ -174,13 +182,18 @@ void SliceView::SetSegmentationData(vtkImageData* imageLabels, RegionCollection*
 	labels = imageLabels;
 	UpdateLabelSlice();
 
+	// Shown as regions are shown
+	regionOutlinesFilter->SetInputDataObject(labels);
+	regionOutlinesFilter->SetAllLabelsVisible(false);
+	regionOutlines->SetVisibility(showRegionOutlines);
+
 	regions = newRegions;
 
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		AddRegionActors(regions->Get(it));
+		Region* region = regions->Get(it);
+
+		if (region->GetShowCenter()) ShowRegionCenter(region, true);
 	}
-		
-	//FilterRegions();
 
 	// Make sure slices line up
 	vtkCamera* cam = renderer->GetActiveCamera();
@@ -190,20 +203,12 @@ void SliceView::SetSegmentationData(vtkImageData* imageLabels, RegionCollection*
 
 void SliceView::AddRegion(Region* region) {
 	AddRegionActors(region);
-
-	//FilterRegions();
 }
 
 void SliceView::AddRegionActors(Region* region) {
-	RegionOutline* outline = region->GetOutline();
-	outline->SetPlane(plane);
-	regionOutlinesRenderer->AddActor(outline->GetActor());
+	ShowRegion(region, true);
 
-	//renderer->AddActor(region->GetText());
-	regionOutlinesRenderer->AddActor(region->GetText());
-
-	regionOutlinesRenderer->AddActor(region->GetCenter2D()->GetActor());
-	region->GetCenter2D()->Update(plane->GetOrigin()[2], dotSize);
+	if (region->GetShowCenter()) ShowRegionCenter(region, true);
 
 #ifdef SHOW_REGION_BOX
 	//regionOutlinesRenderer->AddActor(region->GetBox());
@@ -222,12 +227,33 @@ void SliceView::SetCurrentRegion(Region* region) {
 		probe->GetActor()->GetProperty()->SetColor(1, 1, 1);
 		brush->GetActor()->GetProperty()->SetColor(1, 1, 1);
 	}
-
-	//FilterRegions();
 }
 
 void SliceView::ShowRegion(Region* region, bool show) {
-	region->GetOutline()->GetActor()->SetVisibility(show && showRegionOutlines);
+	regionOutlinesFilter->SetLabelVisible(region->GetLabel(), show);
+}
+
+void SliceView::ShowRegionText(Region* region, bool show) {
+	if (show) {
+		vtkTextActor* text = region->GetText();
+
+		if (text->GetNumberOfConsumers() == 0) regionOutlinesRenderer->AddActor(text);
+	}
+
+	region->ShowText(show);
+}
+
+void SliceView::ShowRegionCenter(Region* region, bool show) {
+	if (show) {
+		RegionCenter2D* center = region->GetCenter2D();
+
+		if (center->GetActor()->GetNumberOfConsumers() == 0) {
+			regionOutlinesRenderer->AddActor(center->GetActor());
+			center->Update(plane->GetOrigin()[2], dotSize);
+		}
+	}
+
+	region->ShowCenter(show);
 }
 
 
@@ -283,8 +309,6 @@ void SliceView::SetInteractionMode(enum InteractionMode mode) {
 
 void SliceView::SetFilterMode(enum FilterMode mode) {
 	//filterMode = mode;
-
-	//FilterRegions();
 }
 
 
@@ -309,7 +333,9 @@ bool SliceView::GetShowRegionOutlines() {
 void SliceView::ShowRegionOutlines(bool show) {
 	showRegionOutlines = show;
 
-	FilterRegions();
+	regionOutlines->SetVisibility(showRegionOutlines && labels != nullptr);
+
+	Render();
 }
 
 void SliceView::ToggleRegionOutlines() {
@@ -423,10 +449,21 @@ void SliceView::UpdatePlane() {
 		DoAutoRescale();
 	}
 
+	// Outlines for the nearest axis-aligned slice
+	const double* normal = plane->GetNormal();
+
+	int axis = 0;
+	for (int i = 1; i < 3; i++) {
+		if (fabs(normal[i]) > fabs(normal[axis])) axis = i;
+	}
+
+	regionOutlinesFilter->SetSlice(axis, plane->GetOrigin()[axis]);
+
 	if (regions) {
 		for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 			Region* region = regions->Get(it);
-			region->GetCenter2D()->Update(z, dotSize);
+
+			if (region->HasCenter2D()) region->GetCenter2D()->Update(z, dotSize);
 		}
 	}
 }
@@ -496,7 +533,15 @@ void SliceView::UpdateSlice() {
 	double minValue = data->GetScalarRange()[0];
 	double maxValue = data->GetScalarRange()[1];
 
-	slice->GetMapper()->SetInputDataObject(data);
+	if (dataSource) {
+		slice->GetMapper()->SetInputConnection(dataSource);
+		slice->GetMapper()->StreamingOn();
+	}
+	else {
+		slice->GetMapper()->SetInputDataObject(data);
+		slice->GetMapper()->StreamingOff();
+	}
+
 	slice->GetProperty()->SetColorWindow(maxValue - minValue);
 	slice->GetProperty()->SetColorLevel(minValue + (maxValue - minValue) / 2);
 
@@ -532,23 +577,24 @@ void SliceView::UpdateLabelSlice() {
 	labelSliceRenderer->AddActor(labelSlice);
 }
 
-void SliceView::FilterRegions() {
-	if (!regions) return;
-
-	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		Region* region = regions->Get(it);
-		RegionOutline* outline = region->GetOutline();
-
-		// XXX: Setting based on surface visiblity probably indicates that the logic should be pushed up to visualization container,
-		// with a method in region for turning on and off individual pieces
-
-		bool visible = region->GetSurface()->GetActor()->GetVisibility();
-
-		outline->GetActor()->SetVisibility(visible && showRegionOutlines);
-	}
-
-	renderer->ResetCameraClippingRange();
-	Render();
+void SliceView::CreateRegionOutlines() {
+	regionOutlinesFilter = vtkSmartPointer<vtkImageSliceOutlines>::New();
+
+	// Colored by label
+	vtkSmartPointer<vtkPolyDataMapper> mapper = vtkSmartPointer<vtkPolyDataMapper>::New();
+	mapper->SetInputConnection(regionOutlinesFilter->GetOutputPort());
+	mapper->SetLookupTable(labelColors);
+	mapper->UseLookupTableScalarRangeOn();
+	mapper->SetScalarModeToUseCellData();
+	mapper->ScalarVisibilityOn();
+
+	regionOutlines = vtkSmartPointer<vtkActor>::New();
+	regionOutlines->SetMapper(mapper);
+	regionOutlines->GetProperty()->LightingOff();
+	regionOutlines->GetProperty()->SetLineWidth(2);
+	regionOutlines->GetProperty()->SetOpacity(0.5);
+	regionOutlines->PickableOff();
+	regionOutlines->VisibilityOff();
 }
 
 void SliceView::ResetCamera() {
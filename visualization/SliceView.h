@@ -6,6 +6,7 @@
 #include "InteractionEnums.h"
 
 class vtkActor;
+class vtkAlgorithmOutput;
 class vtkCylinderSource;
 class vtkImageData;
 class vtkImageSlice;
@@ -16,12 +17,12 @@ class vtkRenderer;
 class vtkRenderWindowInteractor;
 class vtkTextActor;
 
+class vtkImageSliceOutlines;
 class vtkInteractorStyleSlice;
 
 class Brush;
 class Probe;
 class Region;
-class RegionOutline;
 class RegionCollection;
 class SliceLocation;
 
@@ -32,7 +33,8 @@ public:
 
 	void Reset();
 
-	void SetImageData(vtkImageData* data);
+	// If given, the image slice is streamed from the source, only requesting the extent of the slice
+	void SetImageData(vtkImageData* data, vtkAlgorithmOutput* imageSource = nullptr);
 	void SetSegmentationData(vtkImageData* data, RegionCollection* newRegions);
 	void AddRegion(Region* region);
 
@@ -47,6 +49,8 @@ public:
 	void SetCurrentRegion(Region* region);
 
 	void ShowRegion(Region* region, bool show = true);
+	void ShowRegionText(Region* region, bool show = true);
+	void ShowRegionCenter(Region* region, bool show = true);
 	
 	bool GetShowLabelSlice();
 	void ShowLabelSlice(bool show);
@@ -103,6 +107,7 @@ protected:
 	// Data
 	vtkSmartPointer<vtkImageData> data;
 	vtkSmartPointer<vtkImageData> labels;
+	vtkSmartPointer<vtkAlgorithmOutput> dataSource;
 
 	// Rendering
 	vtkSmartPointer<vtkRenderer> renderer;
@@ -122,6 +127,10 @@ protected:
 	vtkSmartPointer<vtkImageSlice> slice;
 	vtkSmartPointer<vtkImageSlice> labelSlice;
 
+	// Outlines of all regions on the current slice
+	vtkSmartPointer<vtkImageSliceOutlines> regionOutlinesFilter;
+	vtkSmartPointer<vtkActor> regionOutlines;
+
 	// Probe
 	Probe* probe;
 
@@ -142,8 +151,9 @@ protected:
 	void CreateLabelSlice();
 	void UpdateLabelSlice();
 
+	void CreateRegionOutlines();
+
 	void AddRegionActors(Region* region);
-	void FilterRegions();
 
 	void ResetCamera();
 
@@ -7,11 +7,15 @@
 
 #include "MainWindow.h"
 
+#include <QDir>
+#include <QFile>
+#include <QStandardPaths>
+#include <QString>
+
 #include <vtkBillboardTextActor3D.h>
 #include <vtkCallbackCommand.h>
 #include <vtkCamera.h>
 #include <vtkExtractVOI.h>
-#include <vtkGeometryFilter.h>
 #include <vtkImageConnectivityFilter.h>
 #include <vtkImageDilateErode3D.h>
 #include <vtkImageFlip.h>
@@ -30,6 +34,7 @@
 #include <vtkLookupTable.h>
 #include <vtkNIFTIImageReader.h>
 #include <vtkNIFTIImageWriter.h>
+#include <vtkNrrdReader.h>
 #include <vtkPointSource.h>
 #include <vtkRenderer.h>
 #include <vtkRenderWindow.h>
@@ -42,14 +47,24 @@
 #include <vtkXMLImageDataReader.h>
 #include <vtkXMLImageDataWriter.h>
 
+#include "vtkBrickedVolumeReader.h"
 #include "vtkInteractorStyleSlice.h"
 #include "vtkInteractorStyleVolume.h"
 
+#include "AutosaveWriter.h"
+#include "BrickedVolumeIO.h"
+#include "EditJournal.h"
 #include "History.h"
+#include "LabelComponents.h"
+#include "LabelIndex.h"
+#include "LabelNeighbors.h"
+#include "MappedVolumeIO.h"
 #include "InteractionEnums.h"
 #include "InteractionCallbacks.h"
 #include "LabelColors.h"
 #include "SegmentorMath.h"
+#include "TIFFStackReader.h"
+#include "VoxelIterator.h"
 #include "SliceView.h"
 #include "VolumeView.h"
 #include "Region.h"
@@ -61,10 +76,18 @@
 VisualizationContainer::VisualizationContainer(vtkRenderWindowInteractor* volumeInteractor, vtkRenderWindowInteractor* sliceInteractor, MainWindow* mainWindow) {
 	data = nullptr;
 	labels = nullptr;
-	history = new History(10);
+	brickReader = nullptr;
+	brickStream = nullptr;
+	brickCacheSize = 1024;
+	history = new History(100, (size_t)1 << 30);
 	numEdits = 0;
 	tempHistory = new History(1);
+	journal = new EditJournal();
+	autosave = new AutosaveWriter();
+	ResetEditExtent(editExtent);
+	ResetEditExtent(tempEditExtent);
 	regions = new RegionCollection();
+	labelIndex = new LabelIndex();
 	currentRegion = nullptr;	
 	hoverLabel = 0;
 	filterRegions = false;
@@ -211,24 +234,33 @@ VisualizationContainer::VisualizationContainer(vtkRenderWindowInteractor* volume
 }
 
 VisualizationContainer::~VisualizationContainer() {
+	delete autosave;
+
+	// Closed normally, so no need for recovery
+	journal->Close(true);
+	delete journal;
 	delete volumeView;
 	delete sliceView;
 	delete history;
 	delete tempHistory;
+	delete labelIndex;
 	delete regions;
 }
 
 VisualizationContainer::FileErrorCode VisualizationContainer::OpenImageFile(const std::string& fileName) {
 	// Get the file extension
-	std::string extension = fileName.substr(fileName.find_last_of(".") + 1);
+	std::string extension = GetFileExtension(fileName);
 
 	// For setting origin
 	vtkSmartPointer<vtkImageChangeInformation> info = vtkSmartPointer<vtkImageChangeInformation>::New();
 	info->SetOutputExtentStart(0, 0, 0);
 	info->SetOutputOrigin(0, 0, 0);
 
+	// Bricked volume reader, kept for streaming slices
+	vtkSmartPointer<vtkBrickedVolumeReader> bricks;
+
 	// Load the data
-	if (extension == "nii") {
+	if (extension == "nii" || extension == "nii.gz") {
 		vtkSmartPointer<vtkNIFTIImageReader> reader = vtkSmartPointer<vtkNIFTIImageReader>::New();
 		reader->SetFileName(fileName.c_str());
 
@@ -246,13 +278,54 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenImageFile(cons
 		
 		info->SetInputConnection(reader->GetOutputPort());
 	}
+	else if (extension == "nrrd" || extension == "nhdr") {
+		// Map uncompressed data without copying, otherwise read it
+		vtkSmartPointer<vtkImageData> mapped = MappedVolumeIO::Read(fileName);
+
+		if (mapped) {
+			info->SetInputDataObject(mapped);
+		}
+		else {
+			vtkSmartPointer<vtkNrrdReader> reader = vtkSmartPointer<vtkNrrdReader>::New();
+			reader->SetFileName(fileName.c_str());
+
+			info->SetInputConnection(reader->GetOutputPort());
+		}
+	}
+	else if (extension == "bvol") {
+		// One reader, with bricks decoded once into its cache. The whole volume is detached from
+		// the reader's output, so slice requests for sub-extents do not replace it.
+		bricks = vtkSmartPointer<vtkBrickedVolumeReader>::New();
+		bricks->SetFileName(fileName.c_str());
+		bricks->SetMaximumCacheSize((size_t)brickCacheSize << 20);
+		bricks->UpdateWholeExtent();
+
+		vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+		volume->ShallowCopy(bricks->GetOutput());
+
+		info->SetInputDataObject(volume);
+	}
 	else {
 		return WrongFileType;
 	}
 
 	info->Update();
 
-	SetImageData(info->GetOutput());
+	if (info->GetOutput()->GetNumberOfPoints() == 0) return WrongFileType;
+
+	if (bricks) {
+		// The slice view only requests bricks intersecting the current slice, through the cache
+		brickReader = bricks;
+
+		// For changing voxel size
+		brickStream = vtkSmartPointer<vtkImageChangeInformation>::New();
+		brickStream->SetInputConnection(brickReader->GetOutputPort());
+
+		SetImageData(info->GetOutput(), brickStream->GetOutputPort());
+	}
+	else {
+		SetImageData(info->GetOutput());
+	}
 	
 	double x, y, z;
 	data->GetSpacing(x, y, z);
@@ -262,7 +335,7 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenImageFile(cons
 
 VisualizationContainer::FileErrorCode VisualizationContainer::OpenImageStack(const std::vector<std::string>& fileNames) {
 	// Get the file extension
-	std::string extension = fileNames[0].substr(fileNames[0].find_last_of(".") + 1);
+	std::string extension = GetFileExtension(fileNames[0]);
 
 	// Set file names to pass to VTK
 	vtkSmartPointer<vtkStringArray> names = vtkSmartPointer<vtkStringArray>::New();
@@ -279,10 +352,20 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenImageStack(con
 
 	// Load the data
 	if (extension == "tif" || extension == "tiff") {
-		vtkSmartPointer<vtkTIFFReader> reader = vtkSmartPointer<vtkTIFFReader>::New();
-		reader->SetFileNames(names);
+		// Decode slices in parallel, falling back to a single reader, e.g. for multi-page files
+		vtkSmartPointer<vtkImageData> stack = TIFFStackReader::Read(fileNames, [this](double progress) {
+			qtWindow->updateProgress(progress);
+		});
 
-		info->SetInputConnection(reader->GetOutputPort());
+		if (stack) {
+			info->SetInputDataObject(stack);
+		}
+		else {
+			vtkSmartPointer<vtkTIFFReader> reader = vtkSmartPointer<vtkTIFFReader>::New();
+			reader->SetFileNames(names);
+
+			info->SetInputConnection(reader->GetOutputPort());
+		}
 	}
 	else {
 		return WrongFileType;
@@ -302,7 +385,7 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenSegmentationFi
 	if (data == nullptr) return NoImageData;
 
 	// Get the file extension
-	std::string extension = fileName.substr(fileName.find_last_of(".") + 1);
+	std::string extension = GetFileExtension(fileName);
 
 	// For setting origin
 	vtkSmartPointer<vtkImageChangeInformation> info = vtkSmartPointer<vtkImageChangeInformation>::New();
@@ -310,7 +393,7 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenSegmentationFi
 	info->SetOutputOrigin(0, 0, 0);
 
 	// Load the data
-	if (extension == "nii") {
+	if (extension == "nii" || extension == "nii.gz") {
 		vtkSmartPointer<vtkNIFTIImageReader> reader = vtkSmartPointer<vtkNIFTIImageReader>::New();
 		reader->SetFileName(fileName.c_str());
 
@@ -328,24 +411,59 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenSegmentationFi
 
 		info->SetInputConnection(reader->GetOutputPort());
 	}
+	else if (extension == "nrrd" || extension == "nhdr") {
+		// Map uncompressed data without copying, otherwise read it
+		vtkSmartPointer<vtkImageData> mapped = MappedVolumeIO::Read(fileName);
+
+		if (mapped) {
+			info->SetInputDataObject(mapped);
+		}
+		else {
+			vtkSmartPointer<vtkNrrdReader> reader = vtkSmartPointer<vtkNrrdReader>::New();
+			reader->SetFileName(fileName.c_str());
+
+			info->SetInputConnection(reader->GetOutputPort());
+		}
+	}
+	else if (extension == "bvol") {
+		// Bricks are decompressed in parallel
+		vtkSmartPointer<vtkBrickedVolumeReader> reader = vtkSmartPointer<vtkBrickedVolumeReader>::New();
+		reader->SetFileName(fileName.c_str());
+		reader->SetMaximumCacheSize(0);
+
+		info->SetInputConnection(reader->GetOutputPort());
+	}
 	else {
 		return WrongFileType;
 	}
 
-	// For casting images
-	vtkSmartPointer<vtkImageCast> cast = vtkSmartPointer<vtkImageCast>::New();
-	cast->SetOutputScalarTypeToUnsignedShort();
-	cast->SetInputConnection(info->GetOutputPort());
-	cast->Update();
+	info->Update();
+
+	if (info->GetOutput()->GetNumberOfPoints() == 0) return WrongFileType;
+
+	vtkSmartPointer<vtkImageData> labelData = info->GetOutput();
+
+	// Cast if necessary, keeping unsigned short data (e.g. a mapped file) in place
+	if (labelData->GetScalarType() != VTK_UNSIGNED_SHORT) {
+		vtkSmartPointer<vtkImageCast> cast = vtkSmartPointer<vtkImageCast>::New();
+		cast->SetOutputScalarTypeToUnsignedShort();
+		cast->SetInputConnection(info->GetOutputPort());
+		cast->Update();
+
+		labelData = cast->GetOutput();
+	}
 
 	// Load metadata
-	std::vector<RegionInfo> metadata = RegionMetadataIO::Read(fileName + ".json");
+	std::vector<RegionInfo> metadata = RegionMetadataIO::Read(RegionMetadataIO::GetFileName(fileName), fileName);
 	
-	if (SetLabelData(cast->GetOutput(), metadata)) {
+	if (SetLabelData(labelData, metadata)) {
 		qtWindow->updateRegions(regions);
 
 		segmentationDataFileName = fileName;
 
+		// Leave any journal from a previous session for recovery
+		if (!HasEditJournal()) StartEditJournal();
+
 		return Success;
 	}
 	else {
@@ -357,7 +475,7 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenSegmentationSt
 	if (data == nullptr) return NoImageData;
 
 	// Get the file extension
-	std::string extension = fileNames[0].substr(fileNames[0].find_last_of(".") + 1);
+	std::string extension = GetFileExtension(fileNames[0]);
 
 	// Set file names to pass to VTK
 	vtkSmartPointer<vtkStringArray> names = vtkSmartPointer<vtkStringArray>::New();
@@ -374,29 +492,50 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenSegmentationSt
 
 	// Load the data
 	if (extension == "tif" || extension == "tiff") {
-		vtkSmartPointer<vtkTIFFReader> reader = vtkSmartPointer<vtkTIFFReader>::New();
-		reader->SetFileNames(names);
+		// Decode slices in parallel, falling back to a single reader, e.g. for multi-page files
+		vtkSmartPointer<vtkImageData> stack = TIFFStackReader::Read(fileNames, [this](double progress) {
+			qtWindow->updateProgress(progress);
+		});
 
-		info->SetInputConnection(reader->GetOutputPort());
+		if (stack) {
+			info->SetInputDataObject(stack);
+		}
+		else {
+			vtkSmartPointer<vtkTIFFReader> reader = vtkSmartPointer<vtkTIFFReader>::New();
+			reader->SetFileNames(names);
+
+			info->SetInputConnection(reader->GetOutputPort());
+		}
 	}
 	else {
 		return WrongFileType;
 	}
 
-	// For casting images
-	vtkSmartPointer<vtkImageCast> cast = vtkSmartPointer<vtkImageCast>::New();
-	cast->SetOutputScalarTypeToUnsignedShort();
-	cast->SetInputConnection(info->GetOutputPort());
-	cast->Update();
+	info->Update();
+
+	vtkSmartPointer<vtkImageData> labelData = info->GetOutput();
+
+	// Cast if necessary
+	if (labelData->GetScalarType() != VTK_UNSIGNED_SHORT) {
+		vtkSmartPointer<vtkImageCast> cast = vtkSmartPointer<vtkImageCast>::New();
+		cast->SetOutputScalarTypeToUnsignedShort();
+		cast->SetInputConnection(info->GetOutputPort());
+		cast->Update();
+
+		labelData = cast->GetOutput();
+	}
 
 	// Load metadata
-	std::vector<RegionInfo> metadata = RegionMetadataIO::Read(fileNames[0] + ".json");
+	std::vector<RegionInfo> metadata = RegionMetadataIO::Read(RegionMetadataIO::GetFileName(fileNames[0]), fileNames[0]);
 
-	if (SetLabelData(cast->GetOutput(), metadata)) {
+	if (SetLabelData(labelData, metadata)) {
 		qtWindow->updateRegions(regions);
 
 		segmentationDataFileName = fileNames[0];
 
+		// Leave any journal from a previous session for recovery
+		if (!HasEditJournal()) StartEditJournal();
+
 		return Success;
 	}
 	else {
@@ -405,7 +544,7 @@ VisualizationContainer::FileErrorCode VisualizationContainer::OpenSegmentationSt
 }
 
 VisualizationContainer::FileErrorCode VisualizationContainer::SaveImageData(const std::string& fileName) {
-	std::string extension = fileName.substr(fileName.find_last_of(".") + 1);
+	std::string extension = GetFileExtension(fileName);
 
 	if (extension == "vti") {
 		vtkSmartPointer<vtkXMLImageDataWriter> writer = vtkSmartPointer<vtkXMLImageDataWriter>::New();
@@ -413,12 +552,15 @@ VisualizationContainer::FileErrorCode VisualizationContainer::SaveImageData(cons
 		writer->SetInputDataObject(data);
 		writer->Update();
 	}
-	else if (extension == "nii") {
+	else if (extension == "nii" || extension == "nii.gz") {
 		vtkSmartPointer<vtkNIFTIImageWriter> writer = vtkSmartPointer<vtkNIFTIImageWriter>::New();
 		writer->SetFileName(fileName.c_str());
 		writer->SetInputDataObject(data);
 		writer->Update();
 	}
+	else if (extension == "bvol") {
+		if (!BrickedVolumeIO::Write(fileName, data)) return WrongFileType;
+	}
 	else if (extension == "tif" || extension == "tiff") {
 		std::string prefix = fileName.substr(0, fileName.find_last_of("."));
 
@@ -449,15 +591,21 @@ VisualizationContainer::FileErrorCode VisualizationContainer::SaveSegmentationDa
 }
 
 VisualizationContainer::FileErrorCode VisualizationContainer::SaveSegmentationData(const std::string& fileName) {
-	std::string extension = fileName.substr(fileName.find_last_of(".") + 1);
+	std::string extension = GetFileExtension(fileName);
 
+	// Labels are mostly runs of zeros, so compress everything with fast settings
 	if (extension == "vti") {
 		vtkSmartPointer<vtkXMLImageDataWriter> writer = vtkSmartPointer<vtkXMLImageDataWriter>::New();
 		writer->SetFileName(fileName.c_str());
 		writer->SetInputDataObject(labels);
+		writer->SetDataModeToAppended();
+		writer->EncodeAppendedDataOff();
+		writer->SetCompressorTypeToZLib();
+		writer->SetCompressionLevel(1);
 		writer->Update();
 	}
-	else if (extension == "nii") {
+	else if (extension == "nii" || extension == "nii.gz") {
+		// Compressed if the file name ends with .gz
 		vtkSmartPointer<vtkNIFTIImageWriter> writer = vtkSmartPointer<vtkNIFTIImageWriter>::New();
 		writer->SetFileName(fileName.c_str());
 		writer->SetInputDataObject(labels);
@@ -465,20 +613,36 @@ VisualizationContainer::FileErrorCode VisualizationContainer::SaveSegmentationDa
 	}
 	else if (extension == "tif" || extension == "tiff") {
 		vtkSmartPointer<vtkTIFFWriter> writer = vtkSmartPointer<vtkTIFFWriter>::New();
-		writer->SetCompressionToNoCompression();
+		writer->SetCompressionToDeflate();
 		writer->SetFileName(fileName.c_str());
 		writer->SetInputDataObject(labels);
 		writer->Update();
 	}
+	else if (extension == "bvol") {
+		// Write bricks from the history, so only bricks changed since the last save to this file are written.
+		// Pending edits are included without pushing, so saving does not add an undo step.
+		const LabelBricks::Snapshot& snapshot = history->GetSnapshot(labels, editExtent);
+
+		if (!BrickedVolumeIO::WriteLabels(fileName, labels->GetDimensions(), labels->GetSpacing(), snapshot, history->GetBrickSize(),
+			fileName == savedLabelsFileName ? &savedLabels : nullptr)) {
+			return WrongFileType;
+		}
+
+		savedLabels = snapshot;
+		savedLabelsFileName = fileName;
+	}
 	else {
 		return WrongFileType;
 	}
 
-	SaveRegionMetadata(fileName + ".json");
+	SaveRegionMetadata(fileName);
 
 	segmentationDataFileName = fileName;
 
 	numEdits = 0;
+
+	// Journal edits from the saved state
+	StartEditJournal();
 	
 	return Success;
 }
@@ -501,6 +665,9 @@ void VisualizationContainer::InitializeLabelData() {
 
 	InitializeLabels();
 
+	// New segmentation, so no saved state to journal from
+	journal->Close(true);
+
 	history->Clear();
 	PushHistory();
 	numEdits = 0;
@@ -547,8 +714,10 @@ void VisualizationContainer::SegmentVolume(double thresholdValue, int smoothing,
 	connectivity->Update();
 
 	labels = connectivity->GetOutput();
+
+	UpdateEditExtent(labels->GetExtent());
 	
-	UpdateLabels(connectivity->GetExtractedRegionExtents());
+	UpdateLabels(connectivity);
 
 /*
 	std::vector<int> sizes;
@@ -617,6 +786,8 @@ void VisualizationContainer::SetVoxelSize(double x, double y, double z) {
 	if (data) {
 		data->SetSpacing(x, y, z);
 
+		if (brickStream) brickStream->SetOutputSpacing(x, y, z);
+
 		sliceView->UpdateVoxelSize();
 	}
 
@@ -653,7 +824,9 @@ void VisualizationContainer::SetInteractionMode(InteractionMode mode) {
 
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 		Region* region = regions->Get(it);
-		region->ShowCenter(interactionMode == DotMode);
+
+		volumeView->ShowRegionCenter(region, interactionMode == DotMode);
+		sliceView->ShowRegionCenter(region, interactionMode == DotMode);
 	}
 
 	UpdateVisibility();
@@ -684,6 +857,22 @@ void VisualizationContainer::PickLabel(double point[3]) {
 	SetCurrentRegion(regions->Get(GetLabel(ijk[0], ijk[1], ijk[2])));
 }
 
+unsigned short VisualizationContainer::PickNearestLabel(double point[3]) {
+	if (!labels || !regions) return 0;
+
+	double* origin = labels->GetOrigin();
+	double* spacing = labels->GetSpacing();
+
+	double p[3];
+	for (int i = 0; i < 3; i++) {
+		p[i] = (point[i] - origin[i]) / spacing[i];
+	}
+
+	Region* region = regions->FindNearestRegion(p);
+
+	return region ? region->GetLabel() : 0;
+}
+
 void VisualizationContainer::Paint(double point[3], bool overwrite) {
 	int ijk[3];
 	PointToIndex(point, ijk);
@@ -826,7 +1015,7 @@ void VisualizationContainer::MouseMove() {
 	sliceView->SetShowProbe(false);
 
 	if (hoverLabel > 0) {
-		regions->Get(hoverLabel)->ShowText(false);
+		sliceView->ShowRegionText(regions->Get(hoverLabel), false);
 	}
 
 	hoverLabel = 0;
@@ -856,13 +1045,13 @@ void VisualizationContainer::MouseMove(double point[3]) {
 	// Hide current hover label if different
 	if (hoverLabel > 0 && hoverLabel != label) {
 		if (regions->Has(hoverLabel)) {
-			regions->Get(hoverLabel)->ShowText(false);
+			sliceView->ShowRegionText(regions->Get(hoverLabel), false);
 		}
 	}
 	
 	// Show label
 	if (label > 0) {		
-		regions->Get(label)->ShowText(true);
+		sliceView->ShowRegionText(regions->Get(label), true);
 	}
 
 	hoverLabel = label;
@@ -938,8 +1127,35 @@ void VisualizationContainer::ShowPlaneRegions() {
 
 	vtkCamera* cam = volumeView->GetRenderer()->GetActiveCamera();
 
+	// Plane in index coordinates, to find regions with extents it crosses
+	double* origin = labels->GetOrigin();
+	double* spacing = labels->GetSpacing();
+
+	double p[3], n[3];
+	for (int i = 0; i < 3; i++) {
+		p[i] = (cam->GetFocalPoint()[i] - origin[i]) / spacing[i];
+		n[i] = cam->GetDirectionOfProjection()[i] * spacing[i];
+	}
+
+	std::vector<Region*> candidates;
+	regions->FindRegions(p, n, candidates);
+
+	// Contour any surfaces needed together
+	std::vector<RegionSurface*> surfaces;
+
+	for (Region* region : candidates) {
+		RegionSurface* surface = region->GetSurface();
+
+		if (surface->NeedsContour()) surfaces.push_back(surface);
+	}
+
+	RegionSurface::UpdateContours(labels, surfaces);
+
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		Region* region = regions->Get(it);
+		regions->Get(it)->SetVisible(false);
+	}
+
+	for (Region* region : candidates) {
 		RegionSurface* surface = region->GetSurface();
 
 		region->SetVisible(surface->IntersectsPlane(cam->GetFocalPoint(), cam->GetDirectionOfProjection()));
@@ -957,60 +1173,24 @@ void VisualizationContainer::ShowNeighborRegions() {
 		int extent[6];
 		currentRegion->GetExtent(extent);
 
-		double a[6];
-		a[0] = extent[0] - neighborRadius;
-		a[1] = extent[1] + neighborRadius;
-		a[2] = extent[2] - neighborRadius;
-		a[3] = extent[3] + neighborRadius;
-		a[4] = extent[4] - neighborRadius;
-		a[5] = extent[5] + neighborRadius;
-		
-		vtkSmartPointer<vtkGeometryFilter> aSurface = vtkSmartPointer<vtkGeometryFilter>::New();
-		aSurface->SetInputConnection(currentRegion->GetCells());
-		aSurface->Update();
-
 		for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-			Region* region = regions->Get(it);
-
-			int b[6];
-			region->GetExtent(b);
-
-			bool intersect = !(
-				b[0] > a[1] || b[1] < a[0] ||
-				b[2] > a[3] || b[3] < a[2] ||
-				b[4] > a[5] || b[5] < a[4]
-			);
-
-			if (intersect) {
-				vtkSmartPointer<vtkGeometryFilter> bSurface = vtkSmartPointer<vtkGeometryFilter>::New();
-				bSurface->SetInputConnection(region->GetCells());
-				bSurface->Update();
+			regions->Get(it)->SetVisible(false);
+		}
 
-				double min = VTK_DOUBLE_MAX;
-				for (int i = 0; i < aSurface->GetOutput()->GetNumberOfPoints(); i++) {
-					double a[3];
-					aSurface->GetOutput()->GetPoint(i, a);
+		currentRegion->SetVisible(true);
 
-					for (int j = 0; j < bSurface->GetOutput()->GetNumberOfPoints(); j++) {
-						double b[3];
-						bSurface->GetOutput()->GetPoint(j, b);
+		// Regions touching at a voxel face, edge or corner come from the adjacency graph. Otherwise one
+		// distance transform of the current region finds all neighbors within the radius.
+		std::vector<unsigned short> neighbors = neighborRadius > 0.0 ?
+			LabelNeighbors::Find(labels, currentRegion->GetLabel(), extent, neighborRadius) :
+			regions->GetAdjacency()->GetNeighbors(currentRegion->GetLabel());
 
-						double d = vtkMath::Distance2BetweenPoints(a, b);
+		for (unsigned short label : neighbors) {
+			Region* region = regions->Get(label);
 
-						if (d < min) min = d;
-					}
-				}
-
-				if (min <= neighborRadius) {
-					region->SetVisible(true);
-					//surface->GetActor()->GetProperty()->SetOpacity(neighborOpacity);
-				}
-				else {
-					region->SetVisible(false);
-				}
-			}
-			else {
-				region->SetVisible(false);
+			if (region) {
+				region->SetVisible(true);
+				//surface->GetActor()->GetProperty()->SetOpacity(neighborOpacity);
 			}
 		}
 	}
@@ -1038,14 +1218,18 @@ void VisualizationContainer::CreateNewRegion(double point[3]) {
 
 	UpdateColors(newLabel);
 
-	// Add first voxel
-	unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(x, y, z));
-	*labelData = newLabel;
-
 	// Create new region
 	int extent[6] = { x, x, y, y, z, z };
 	Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels, extent);
+	newRegion->ClearVoxelStats();
 	regions->Add(newRegion);
+
+	// Add first voxel
+	unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(x, y, z));
+	WriteLabel(labelData, x, y, z, newLabel);
+
+	UpdateEditExtent(x, y, z);
+
 	volumeView->AddRegion(newRegion);
 	sliceView->AddRegion(newRegion);
 
@@ -1064,18 +1248,15 @@ void VisualizationContainer::RelabelCurrentRegion() {
 
 	unsigned short label = currentRegion->GetLabel();
 
-	vtkSmartPointer<vtkImageConnectivityFilter> connectivity = vtkSmartPointer<vtkImageConnectivityFilter>::New();
-	connectivity->SetScalarRange(label, label);
-	connectivity->SetLabelScalarTypeToUnsignedShort();
-	connectivity->SetLabelModeToSizeRank();
-	connectivity->GenerateRegionExtentsOn();
-	connectivity->SetInputDataObject(labels);
-	connectivity->Update();
+	// Components within the region extent
+	const int* regionExtent = currentRegion->GetExtent();
 
-	int numComponents = connectivity->GetNumberOfExtractedRegions();
-	vtkIdTypeArray* componentLabels = connectivity->GetExtractedRegionLabels();
-	vtkIntArray* componentExtents = connectivity->GetExtractedRegionExtents();
-	vtkImageData* connectivityOutput = connectivity->GetOutput();
+	std::vector<int> componentIds;
+	std::vector<LabelComponents::Component> components;
+	int numComponents = LabelComponents::Label(labels, label, regionExtent, componentIds, components);
+
+	int componentsExtent[6];
+	VoxelIterator::ClampExtent(labels, regionExtent, componentsExtent);
 
 	if (numComponents == 0) {
 		RemoveRegion(label);
@@ -1086,42 +1267,33 @@ void VisualizationContainer::RelabelCurrentRegion() {
 
 		for (int i = 0; i < numComponents; i++) {
 			// Get the extent for this component
-			double* componentExtent = componentExtents->GetTuple(i);
-			int extent[6];
-			for (int j = 0; j < 6; j++) {
-				extent[j] = (int)componentExtent[j];
-			}
+			int* extent = components[i].extent;
 
 			if (i == 0) {
 				// Use current region
 				currentRegion->SetExtent(extent);
 			}
 			else {
-				// Label from the connectivity filter
-				unsigned short componentLabel = (unsigned short)componentLabels->GetTuple1(i);
+				int componentId = i + 1;
 
 				// Get label for new region
 				unsigned short newLabel = regions->GetNewLabel();
 
-				// Update label data
-				for (int i = extent[0]; i <= extent[1]; i++) {
-					for (int j = extent[2]; j <= extent[3]; j++) {
-						for (int k = extent[4]; k <= extent[5]; k++) {
-							unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
-							unsigned short* connectivityData = static_cast<unsigned short*>(connectivityOutput->GetScalarPointer(i, j, k));
-
-							if (*connectivityData == componentLabel) *labelData = newLabel;
-						}
-					}
-				}
-
 				UpdateColors(newLabel);
 
-
 				// Create new region
 				Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels, extent);
 				newRegion->SetVisible(true);
+				newRegion->ClearVoxelStats();
 				regions->Add(newRegion);
+
+				// Update label data
+				VoxelIterator::ForEach<unsigned short>(labels, extent, [&](int i, int j, int k, unsigned short& value) {
+					if (componentIds[LabelComponents::GetIndex(componentsExtent, i, j, k)] == componentId) WriteLabel(&value, i, j, k, newLabel);
+				});
+
+				UpdateEditExtent(extent);
+
 				volumeView->AddRegion(newRegion);
 				sliceView->AddRegion(newRegion);
 				
@@ -1143,46 +1315,36 @@ void VisualizationContainer::CleanCurrentRegion() {
 
 	unsigned short label = currentRegion->GetLabel();
 
-	// Remove unconnected voxels
-	vtkSmartPointer<vtkImageConnectivityFilter> connectivity = vtkSmartPointer<vtkImageConnectivityFilter>::New();
-	connectivity->SetScalarRange(label, label);
-	connectivity->SetLabelScalarTypeToUnsignedShort();
-	connectivity->SetLabelModeToSizeRank();
-	connectivity->GenerateRegionExtentsOn();
-	connectivity->SetInputDataObject(labels);
-	connectivity->Update();
+	// Remove unconnected voxels, with components within the region extent
+	const int* regionExtent = currentRegion->GetExtent();
 
-	int numComponents = connectivity->GetNumberOfExtractedRegions();
-	vtkIdTypeArray* componentLabels = connectivity->GetExtractedRegionLabels();
-	vtkIntArray* componentExtents = connectivity->GetExtractedRegionExtents();
-	vtkImageData* connectivityOutput = connectivity->GetOutput();
+	std::vector<int> componentIds;
+	std::vector<LabelComponents::Component> components;
+	int numComponents = LabelComponents::Label(labels, label, regionExtent, componentIds, components);
+
+	int componentsExtent[6];
+	VoxelIterator::ClampExtent(labels, regionExtent, componentsExtent);
 	
 	if (numComponents > 1) {
 		currentRegion->SetModified(true);
 
 		for (int i = 0; i < numComponents; i++) {
 			// Get the extent for this component
-			double* componentExtent = componentExtents->GetTuple(i);
-			int extent[6];
-			for (int j = 0; j < 6; j++) {
-				extent[j] = (int)componentExtent[j];
-			}
+			int* extent = components[i].extent;
 
 			if (i == 0) {
 				// Use current region
 				currentRegion->SetExtent(extent);
 			}
 			else {
+				int componentId = i + 1;
+
 				// Update label data
-				for (int i = extent[0]; i <= extent[1]; i++) {
-					for (int j = extent[2]; j <= extent[3]; j++) {
-						for (int k = extent[4]; k <= extent[5]; k++) {
-							unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));						
+				VoxelIterator::ForEach<unsigned short>(labels, extent, [&](int i, int j, int k, unsigned short& value) {
+					if (componentIds[LabelComponents::GetIndex(componentsExtent, i, j, k)] == componentId) WriteLabel(&value, i, j, k, 0);
+				});
 
-							if (*labelData == label) *labelData = 0;							
-						}
-					}
-				}
+				UpdateEditExtent(extent);
 			}
 		}
 
@@ -1219,16 +1381,12 @@ void VisualizationContainer::CleanCurrentRegion() {
 		floodFillOutput->GetExtent(extent);
 
 		// Update label data
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				for (int k = extent[4]; k <= extent[5]; k++) {
-					unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
-					unsigned short* floodFillData = static_cast<unsigned short*>(floodFillOutput->GetScalarPointer(i, j, k));
+		VoxelIterator::ForEachPair<unsigned short, unsigned short>(labels, floodFillOutput, extent,
+			[&](int i, int j, int k, unsigned short& labelValue, unsigned short& floodFillValue) {
+			if (floodFillValue == label) WriteLabel(&labelValue, i, j, k, label);
+		});
 
-					if (*floodFillData == label) *labelData = label;
-				}
-			}
-		}
+		UpdateEditExtent(extent);
 	}
 	
 	qtWindow->updateRegions(regions);
@@ -1262,15 +1420,11 @@ void VisualizationContainer::MergeWithCurrentRegion(double point[3]) {
 	const int* extent = region->GetExtent();
 
 	// Update label data
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			for (int k = extent[4]; k <= extent[5]; k++) {
-				unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
+	VoxelIterator::ForEach<unsigned short>(labels, extent, [&](int i, int j, int k, unsigned short& value) {
+		if (value == label) WriteLabel(&value, i, j, k, currentLabel);
+	});
 
-				if (*labelData == label) *labelData = currentLabel;
-			}
-		}
-	}
+	UpdateEditExtent(extent);
 
 	// Update current region extent
 	const int* currentExtent = currentRegion->GetExtent();
@@ -1303,6 +1457,8 @@ void VisualizationContainer::SplitCurrentRegion(int numRegions) {
 }
 
 void VisualizationContainer::SplitRegionKMeans(Region* region, int numRegions) {
+	UpdateEditExtent(region->GetExtent());
+
 	vtkSmartPointer<vtkTable> table = region->GetPointTable();
 
 	vtkSmartPointer<vtkKMeansStatistics> kMeans = vtkSmartPointer<vtkKMeansStatistics>::New();
@@ -1330,6 +1486,14 @@ void VisualizationContainer::SplitRegionKMeans(Region* region, int numRegions) {
 		// Get label for new region
 		unsigned short newLabel = regions->GetNewLabel();
 
+		UpdateColors(newLabel);
+
+		// Create new region within the current region extent
+		Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels, region->GetExtent());
+		newRegion->SetVisible(true);
+		newRegion->ClearVoxelStats();
+		regions->Add(newRegion);
+
 		// Update label data
 		for (int j = 0; j < (int)newRegionRows[i - 1].size(); j++) {
 			int row = newRegionRows[i - 1][j];
@@ -1340,15 +1504,11 @@ void VisualizationContainer::SplitRegionKMeans(Region* region, int numRegions) {
 
 			unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(x, y, z));
 
-			*labelData = newLabel;
+			WriteLabel(labelData, x, y, z, newLabel);
 		}
 
-		UpdateColors(newLabel);
+		newRegion->ShrinkExtent();
 
-		// Create new region
-		Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels);
-		newRegion->SetVisible(true);
-		regions->Add(newRegion);
 		volumeView->AddRegion(newRegion);
 		sliceView->AddRegion(newRegion);
 
@@ -1376,6 +1536,8 @@ void VisualizationContainer::SplitRegionIntensity(Region* region, int numRegions
 	int extent[6];
 	region->GetExtent(extent);
 
+	UpdateEditExtent(extent);
+
 	vtkSmartPointer<vtkExtractVOI> voi = vtkSmartPointer<vtkExtractVOI>::New();
 	voi->SetVOI(extent[0], extent[1], extent[2], extent[3], extent[4], extent[5]);
 	voi->SetInputDataObject(data);
@@ -1540,36 +1702,39 @@ void VisualizationContainer::SplitRegionIntensity(Region* region, int numRegions
 			grow.push_back(regionGrow);
 		}
 
+		// Region grow outputs share the extent of the connectivity output, so use the same offset
+		const unsigned short* connectivityOrigin = static_cast<unsigned short*>(connectivityOutput->GetScalarPointer());
+
+		std::vector<const unsigned short*> growData(numComponents);
+		std::vector<unsigned short> growLabels(numComponents);
+
+		for (int c = 0; c < numComponents; c++) {
+			growData[c] = static_cast<unsigned short*>(grow[c]->GetOutput()->GetScalarPointer());
+			growLabels[c] = (unsigned short)componentLabels->GetTuple1(c);
+		}
+
 		// Assign voxels
 		// XXX: Could potentially speed things up here by looking at component extents?
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				for (int k = extent[4]; k <= extent[5]; k++) {
-					// Current label
-					unsigned short* currentLabel = static_cast<unsigned short*>(connectivityOutput->GetScalarPointer(i, j, k));
-
-					if (*currentLabel != 0) continue;
-
-					std::vector<unsigned short> labels;
-					
-					for (int c = 0; c < numComponents; c++) {
-						// Label for this component
-						unsigned short componentLabel = (unsigned short)componentLabels->GetTuple1(c);
-
-						// Check voxel in the region grow for this component
-						unsigned short growLabel = *static_cast<unsigned short*>(grow[c]->GetOutput()->GetScalarPointer(i, j, k));
-
-						if (growLabel == componentLabel) {
-							labels.push_back(componentLabel);
-						}
-					}
+		VoxelIterator::ParallelForEach<unsigned short>(connectivityOutput, extent, [&](int, int, int, unsigned short& currentLabel) {
+			if (currentLabel != 0) return;
 
-					if (labels.size() == 1) {
-						*currentLabel = labels[0];
-					}
+			vtkIdType id = &currentLabel - connectivityOrigin;
+
+			int count = 0;
+			unsigned short newLabel = 0;
+
+			for (int c = 0; c < numComponents; c++) {
+				// Check voxel in the region grow for this component
+				if (growData[c][id] == growLabels[c]) {
+					newLabel = growLabels[c];
+					count++;
 				}
 			}
-		}
+
+			if (count == 1) {
+				currentLabel = newLabel;
+			}
+		});
 
 		connectivityOutput->Modified();
 
@@ -1588,30 +1753,22 @@ void VisualizationContainer::SplitRegionIntensity(Region* region, int numRegions
 	regionExtent[4] = extent[5];
 	regionExtent[5] = extent[4];
 
-	for (int i = extent[0]; i <= extent[1]; i++) {
-		for (int j = extent[2]; j <= extent[3]; j++) {
-			for (int k = extent[4]; k <= extent[5]; k++) {
-				unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
-				unsigned short* connectivityData = static_cast<unsigned short*>(connectivityOutput->GetScalarPointer(i, j, k));
-
-				if (*labelData == label) {
-					if (*connectivityData == componentLabel) {
-						*labelData = label;
-
-						if (i < regionExtent[0]) regionExtent[0] = i;
-						if (i > regionExtent[1]) regionExtent[1] = i; 
-						if (j < regionExtent[2]) regionExtent[2] = j;
-						if (j > regionExtent[3]) regionExtent[3] = j;
-						if (k < regionExtent[4]) regionExtent[4] = k;
-						if (k > regionExtent[5]) regionExtent[5] = k;
-					}
-					else {
-						*labelData = 0;
-					}					
-				}				
+	VoxelIterator::ForEachPair<unsigned short, unsigned short>(labels, connectivityOutput, extent, 
+		[&](int i, int j, int k, unsigned short& labelValue, unsigned short& connectivityValue) {
+		if (labelValue == label) {
+			if (connectivityValue == componentLabel) {
+				if (i < regionExtent[0]) regionExtent[0] = i;
+				if (i > regionExtent[1]) regionExtent[1] = i; 
+				if (j < regionExtent[2]) regionExtent[2] = j;
+				if (j > regionExtent[3]) regionExtent[3] = j;
+				if (k < regionExtent[4]) regionExtent[4] = k;
+				if (k > regionExtent[5]) regionExtent[5] = k;
+			}
+			else {
+				WriteLabel(&labelValue, i, j, k, 0);
 			}
 		}
-	}
+	});
 
 	currentRegion->SetExtent(regionExtent);
 	currentRegion->SetModified(true);
@@ -1636,34 +1793,32 @@ void VisualizationContainer::SplitRegionIntensity(Region* region, int numRegions
 		regionExtent[3] = extent[2];
 		regionExtent[4] = extent[5];
 		regionExtent[5] = extent[4];
-		
-		// Update label data
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				for (int k = extent[4]; k <= extent[5]; k++) {
-					unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
-					unsigned short* connectivityData = static_cast<unsigned short*>(connectivityOutput->GetScalarPointer(i, j, k));
-
-					if (*connectivityData == componentLabel) {
-						*labelData = newLabel;
-
-						if (i < regionExtent[0]) regionExtent[0] = i;
-						if (i > regionExtent[1]) regionExtent[1] = i;
-						if (j < regionExtent[2]) regionExtent[2] = j;
-						if (j > regionExtent[3]) regionExtent[3] = j;
-						if (k < regionExtent[4]) regionExtent[4] = k;
-						if (k > regionExtent[5]) regionExtent[5] = k;
-					}
-				}
-			}
-		}
 
 		UpdateColors(newLabel);
 
 		// Create new region
-		Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels, regionExtent);
+		Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels, extent);
 		newRegion->SetVisible(true);
+		newRegion->ClearVoxelStats();
 		regions->Add(newRegion);
+		
+		// Update label data
+		VoxelIterator::ForEachPair<unsigned short, unsigned short>(labels, connectivityOutput, extent, 
+			[&](int i, int j, int k, unsigned short& labelValue, unsigned short& connectivityValue) {
+			if (connectivityValue == componentLabel) {
+				WriteLabel(&labelValue, i, j, k, newLabel);
+
+				if (i < regionExtent[0]) regionExtent[0] = i;
+				if (i > regionExtent[1]) regionExtent[1] = i;
+				if (j < regionExtent[2]) regionExtent[2] = j;
+				if (j > regionExtent[3]) regionExtent[3] = j;
+				if (k < regionExtent[4]) regionExtent[4] = k;
+				if (k > regionExtent[5]) regionExtent[5] = k;
+			}
+		});
+
+		newRegion->SetExtent(regionExtent);
+
 		volumeView->AddRegion(newRegion);
 		sliceView->AddRegion(newRegion);
 
@@ -1697,63 +1852,44 @@ void VisualizationContainer::SplitRegionIntensity(Region* region, int numRegions
 	qtWindow->updateProgress(1.0);
 }
 
-bool VisualizationContainer::CheckRegionHoles(Region* region) {
-	unsigned short label = region->GetLabel();
+bool VisualizationContainer::ValidateRegion(Region* region) {
+	int extent[6];
+	region->GetPaddedExtent(extent);
 
-	double seed[3];
-	if (region->GetSeed(seed)) {
-		// XXX: Convert to point from index?
-		vtkSmartPointer<vtkPoints> seedPoints = vtkSmartPointer<vtkPoints>::New();
-		seedPoints->SetNumberOfPoints(1);
-		seedPoints->SetPoint(0, seed[0], seed[1], seed[2]);
+	// Fragments and holes in one pass over the padded extent, without stopping at the first
+	// fragment. A valid region needs the whole pass anyway, and an invalid one reports its
+	// largest fragment and hole.
+	LabelComponents::Report report;
+	LabelComponents::Validate(labels, region->GetLabel(), extent, report);
 
-		vtkSmartPointer<vtkImageThreshold> threshold = vtkSmartPointer<vtkImageThreshold>::New();
-		threshold->ThresholdBetween(label, label);
-		threshold->ReplaceInOff();
-		threshold->ReplaceOutOn();
-		threshold->SetOutValue(0);
-		threshold->SetInputConnection(region->GetOutput());
+	bool connected = report.fragments.size() == 1;
+	bool holes = report.holes.size() > 0;
 
-		vtkSmartPointer<vtkImageThresholdConnectivity> floodFill = vtkSmartPointer<vtkImageThresholdConnectivity>::New();
-		floodFill->SetSeedPoints(seedPoints);
-		floodFill->ThresholdBetween(0, 0);
-		floodFill->ReplaceInOff();
-		floodFill->ReplaceOutOn();
-		floodFill->SetOutValue(label);
-		floodFill->SetInputConnection(threshold->GetOutputPort());
-		floodFill->Update();
-
-		vtkImageData* floodFillOutput = floodFill->GetOutput();
-
-		int extent[6];
-		floodFillOutput->GetExtent(extent);
+	if (connected && !holes) return true;
 
-		// Update label data
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				for (int k = extent[4]; k <= extent[5]; k++) {
-					unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, k));
-					unsigned short* floodFillData = static_cast<unsigned short*>(floodFillOutput->GetScalarPointer(i, j, k));
+	QString message;
 
-					if (*floodFillData == label && *labelData != label) return true;
-				}
-			}
-		}
+	if (!connected && holes) {
+		message = "Region is not contiguous and has holes. Please fix before marking as \"done\"";
+	}
+	else if (!connected) {
+		message = "Region is not contiguous. Please fix before marking as \"done\"";
+	}
+	else {
+		message = "Region has holes. Please fix before marking as \"done\"";
 	}
 
-	return false;
-}
+	// Locate the largest detached fragment and the largest hole
+	auto location = [](const LabelComponents::Component& component) {
+		return QString("(%1, %2, %3)").arg(component.voxel[0]).arg(component.voxel[1]).arg(component.voxel[2]);
+	};
 
-bool VisualizationContainer::CheckRegionConnected(Region* region) {
-	unsigned short label = region->GetLabel();
+	if (report.fragments.size() > 1) message += "\n\nFragment at voxel " + location(report.fragments[1]);
+	if (holes) message += "\n\nHole at voxel " + location(report.holes[0]);
 
-	// Test to make sure the region is contiguous
-	vtkSmartPointer<vtkImageConnectivityFilter> connectivity = vtkSmartPointer<vtkImageConnectivityFilter>::New();
-	connectivity->SetScalarRange(label, label);
-	connectivity->SetInputDataObject(labels);
-	connectivity->Update();
+	qtWindow->showMessage(message);
 
-	return connectivity->GetNumberOfExtractedRegions() == 1;
+	return false;
 }
 
 void VisualizationContainer::FillCurrentRegionSlice() {
@@ -1797,14 +1933,14 @@ void VisualizationContainer::FillCurrentRegionSlice() {
 		floodFillOutput->GetExtent(extent);
 
 		// Update label data
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(i, j, z));
-				unsigned short* floodFillData = static_cast<unsigned short*>(floodFillOutput->GetScalarPointer(i, j, z));
+		extent[4] = extent[5] = z;
 
-				if (*floodFillData == label) *labelData = label;
-			}
-		}
+		VoxelIterator::ForEachPair<unsigned short, unsigned short>(labels, floodFillOutput, extent,
+			[&](int i, int j, int k, unsigned short& labelValue, unsigned short& floodFillValue) {
+			if (floodFillValue == label) WriteLabel(&labelValue, i, j, k, label);
+		});
+
+		UpdateEditExtent(extent);
 	}
 
 	qtWindow->updateRegions(regions);
@@ -1990,6 +2126,8 @@ void VisualizationContainer::SetDotAnnotation(double point[3]) {
 	unsigned short* labelData = static_cast<unsigned short*>(labels->GetScalarPointer(x, y, z));
 
 	if (*labelData > 0) {
+		UpdateEditExtent(regions->Get(*labelData)->GetExtent());
+
 		regions->Remove(*labelData);
 
 	}
@@ -2000,13 +2138,18 @@ void VisualizationContainer::SetDotAnnotation(double point[3]) {
 		UpdateColors(newLabel);
 
 		// Set dot label
+		regions->GetAdjacency()->SetLabel(x, y, z, newLabel);
 		*labelData = newLabel;
 
+		UpdateEditExtent(x, y, z);
+
 		// Create new region
 		int extent[6] = { x, x, y, y, z, z };
 		Region* newRegion = new Region(newLabel, labelColors->GetTableValue(newLabel), labels, extent);
 		newRegion->ShowCenter(true);
 
+		newRegion->SetVoxelStats(1);
+
 		regions->Add(newRegion);
 		volumeView->AddRegion(newRegion);
 		sliceView->AddRegion(newRegion);
@@ -2023,6 +2166,8 @@ void VisualizationContainer::SetDotAnnotation(double point[3]) {
 }
 
 bool VisualizationContainer::CheckDots() {
+	UpdateLabelIndex();
+
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 		Region* region = regions->Get(it);
 
@@ -2037,9 +2182,14 @@ bool VisualizationContainer::CheckDots() {
 void VisualizationContainer::ApplyDotAnnotation() {
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 		Region* region = regions->Get(it);
+
+		UpdateEditExtent(region->GetExtent());
+
 		region->ApplyDot(sliceView->GetDotSize());
 	}
 
+	regions->GetAdjacency()->Clear();
+
 	labels->Modified();
 
 	qtWindow->updateRegions(regions);
@@ -2056,20 +2206,7 @@ Region* VisualizationContainer::SetRegionDone(unsigned short label, bool done) {
 
 	if (done) {
 		// Check for problems
-		bool connected = CheckRegionConnected(region);
-		bool holes = CheckRegionHoles(region);
-
-		if (!connected && holes) {
-			qtWindow->showMessage("Region is not contiguous and has holes. Please fix before marking as \"done\"");
-		}
-		else if (!connected) {
-			qtWindow->showMessage("Region is not contiguous. Please fix before marking as \"done\"");
-		}
-		else if (holes) {
-			qtWindow->showMessage("Region is has holes. Please fix before marking as \"done\"");
-		}
-
-		if (!connected || holes) return region;
+		if (!ValidateRegion(region)) return region;
 	}
 
 	region->SetDone(done);
@@ -2115,6 +2252,8 @@ void VisualizationContainer::RemoveRegion(unsigned short label) {
 
 	if (region == currentRegion) SetCurrentRegion(nullptr);
 
+	UpdateEditExtent(region->GetExtent());
+
 	regions->Remove(label);
 
 	qtWindow->updateRegions(regions);
@@ -2288,6 +2427,116 @@ void VisualizationContainer::SetNeighborRadius(double radius) {
 	neighborRadius = radius;
 }
 
+std::string VisualizationContainer::GetFileExtension(const std::string& fileName) {
+	std::string extension = fileName.substr(fileName.find_last_of(".") + 1);
+
+	// Include compressed NIfTI
+	if (extension == "gz" && fileName.size() > 7 && fileName.compare(fileName.size() - 7, 7, ".nii.gz") == 0) {
+		return "nii.gz";
+	}
+
+	return extension;
+}
+
+int VisualizationContainer::GetBrickCacheSize() {
+	return brickCacheSize;
+}
+
+void VisualizationContainer::SetBrickCacheSize(int size) {
+	brickCacheSize = size;
+
+	if (brickReader) brickReader->SetMaximumCacheSize((size_t)brickCacheSize << 20);
+}
+
+bool VisualizationContainer::HasEditJournal() {
+	return labels && !journal->IsOpen() && segmentationDataFileName.size() > 0 &&
+		QFile::exists(EditJournal::GetJournalFileName(segmentationDataFileName).c_str());
+}
+
+bool VisualizationContainer::RecoverEdits() {
+	if (!HasEditJournal()) return false;
+
+	std::string fileName = EditJournal::GetJournalFileName(segmentationDataFileName);
+
+	// Metadata as loaded
+	std::vector<RegionInfo> metadata;
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		metadata.push_back(RegionInfo(regions->Get(it)));
+	}
+
+	// Only touches bricks changed by the journaled edits
+	qint64 validSize;
+	int numRecords = EditJournal::Replay(fileName, labels, metadata, &validSize);
+
+	if (numRecords < 0) return false;
+
+	if (!SetLabelData(labels, metadata)) return false;
+
+	// Recovered edits are unsaved
+	numEdits = numRecords;
+
+	// Keep journaling after the recovered edits
+	journal->Resume(fileName, validSize, history->GetSnapshot(), history->GetRegionInfo());
+
+	qtWindow->updateRegions(regions);
+
+	Render();
+
+	return true;
+}
+
+void VisualizationContainer::DiscardEditJournal() {
+	StartEditJournal();
+}
+
+void VisualizationContainer::Autosave() {
+	// Skip if a save is in flight, or in the middle of an edit
+	if (!labels || numEdits == 0 || autosave->IsBusy() || editExtent[0] <= editExtent[1]) return;
+
+	// Only shares bricks and copies region info, so the GUI thread is not held up
+	const LabelBricks::Snapshot& snapshot = history->GetSnapshot();
+
+	if (snapshot.empty()) return;
+
+	std::vector<RegionInfo> metadata;
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		metadata.push_back(RegionInfo(regions->Get(it)));
+	}
+
+	if (snapshot == autosavedLabels && metadata == autosavedMetadata) return;
+
+	autosavedLabels = snapshot;
+	autosavedMetadata = metadata;
+
+	AutosaveWriter::Job job;
+
+	if (segmentationDataFileName.size() > 0) {
+		job.fileName = segmentationDataFileName;
+	}
+	else {
+		QString directory = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation) + "/autosave";
+		job.fileName = QDir(directory).filePath("segmentation").toStdString();
+	}
+
+	labels->GetDimensions(job.dimensions);
+	labels->GetSpacing(job.spacing);
+	job.labels = snapshot;
+	job.brickSize = history->GetBrickSize();
+	job.metadata.swap(metadata);
+
+	autosave->Start(job);
+}
+
+int VisualizationContainer::GetAutosaveRetention() {
+	return autosave->GetRetention();
+}
+
+void VisualizationContainer::SetAutosaveRetention(int retention) {
+	autosave->SetRetention(retention);
+}
+
 void VisualizationContainer::Render() {
 	volumeView->Render();
 	sliceView->Render();
@@ -2296,31 +2545,37 @@ void VisualizationContainer::Render() {
 void VisualizationContainer::Undo() {
 	if (!labels) return;
 
-	history->Undo(labels, regions);
+	history->Undo(labels, regions, editExtent);
+	ResetEditExtent(editExtent);
 	numEdits--;
 
+	AppendEditJournal();
+
 	// Make sure spacing is correct
 	labels->SetSpacing(data->GetSpacing());
 
 	volumeView->SetRegions(labels, regions);
 	sliceView->SetSegmentationData(labels, regions);
 	qtWindow->updateRegions(regions);
-	Render();
+	UpdateVisibility();
 }
 
 void VisualizationContainer::Redo() {
 	if (!labels) return;
 
-	history->Redo(labels, regions);
+	history->Redo(labels, regions, editExtent);
+	ResetEditExtent(editExtent);
 	numEdits++;
 
+	AppendEditJournal();
+
 	// Make sure spacing is correct
 	labels->SetSpacing(data->GetSpacing());
 
 	volumeView->SetRegions(labels, regions);
 	sliceView->SetSegmentationData(labels, regions);
 	qtWindow->updateRegions(regions);
-	Render();
+	UpdateVisibility();
 }
 
 bool VisualizationContainer::NeedToSave() {
@@ -2351,13 +2606,64 @@ double VisualizationContainer::GetOtsuThreshold() {
 
 void VisualizationContainer::PushTempHistory() {
 	tempHistory->Clear();
-	tempHistory->Push(labels, regions);
+	tempHistory->Push(labels, regions, tempEditExtent);
+	ResetEditExtent(tempEditExtent);
+}
+
+void VisualizationContainer::UpdateLabelIndex() {
+	if (!labels) return;
+
+	// Number of voxels to scan for regions without stats
+	vtkIdType scanSize = 0;
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		Region* region = regions->Get(it);
+
+		if (region->HasVoxelStats()) continue;
+
+		const int* extent = region->GetExtent();
+
+		scanSize += (vtkIdType)(extent[1] - extent[0] + 1) * (extent[3] - extent[2] + 1) * (extent[5] - extent[4] + 1);
+	}
+
+	if (scanSize == 0) return;
+
+	if (scanSize < labels->GetNumberOfPoints()) {
+		// Scan each region
+		for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+			regions->Get(it)->GetNumVoxels();
+		}
+
+		return;
+	}
+
+	// Single pass over all labels
+	labelIndex->Compute(labels);
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		Region* region = regions->Get(it);
+
+		if (region->HasVoxelStats()) continue;
+
+		if (labelIndex->Has(region->GetLabel())) {
+			const LabelIndex::LabelStats& stats = labelIndex->Get(region->GetLabel());
+
+			region->SetVoxelStats(stats.numVoxels);
+		}
+		else {
+			region->SetVoxelStats(0);
+		}
+	}
 }
 
 void VisualizationContainer::PopTempHistory() {
 	if (!labels) return;
 
-	tempHistory->Head(labels, regions);
+	tempHistory->Head(labels, regions, tempEditExtent);
+
+	// Labels may differ anywhere edited since the temp history push
+	UpdateEditExtent(tempEditExtent);
+	ResetEditExtent(tempEditExtent);
 
 	// Make sure spacing is correct
 	labels->SetSpacing(data->GetSpacing());
@@ -2370,7 +2676,7 @@ void VisualizationContainer::PopTempHistory() {
 	Render();
 }
 
-void VisualizationContainer::SetImageData(vtkImageData* imageData) {	
+void VisualizationContainer::SetImageData(vtkImageData* imageData, vtkAlgorithmOutput* imageSource) {	
 /*
 	vtkSmartPointer<vtkImageGradientMagnitude> gradient = vtkSmartPointer<vtkImageGradientMagnitude>::New();
 	gradient->SetInputData(imageData);
@@ -2383,10 +2689,15 @@ void VisualizationContainer::SetImageData(vtkImageData* imageData) {
 	
 	data = imageData;
 
+	if (!imageSource) {
+		brickReader = nullptr;
+		brickStream = nullptr;
+	}
+
 	sliceView->Reset();
 	volumeView->Reset();
 
-	sliceView->SetImageData(data);	
+	sliceView->SetImageData(data, imageSource);	
 	volumeView->SetImageData(data);
 
 	InitializeLabelData();
@@ -2425,6 +2736,8 @@ bool VisualizationContainer::SetLabelData(vtkImageData* labelData, const std::ve
 	
 	UpdateLabels(metadata);
 
+	journal->Close(true);
+
 	history->Clear();
 	PushHistory();
 	numEdits = 0;
@@ -2442,13 +2755,16 @@ void VisualizationContainer::InitializeLabels() {
 	sliceView->SetSegmentationData(labels, regions);
 }
 
-void VisualizationContainer::UpdateLabels(vtkIntArray* extents) {
+void VisualizationContainer::UpdateLabels(vtkImageConnectivityFilter* connectivity) {
 	UpdateColors();
 
-	ExtractRegions(extents);
+	ExtractRegions(connectivity);
 
 	volumeView->SetRegions(labels, regions);
 	sliceView->SetSegmentationData(labels, regions);
+
+	// Creates render components for shown regions
+	UpdateVisibility();
 }
 
 void VisualizationContainer::UpdateLabels(const std::vector<RegionInfo>& metadata) {
@@ -2458,6 +2774,9 @@ void VisualizationContainer::UpdateLabels(const std::vector<RegionInfo>& metadat
 
 	volumeView->SetRegions(labels, regions);
 	sliceView->SetSegmentationData(labels, regions);
+
+	// Creates render components for shown regions
+	UpdateVisibility();
 }
 
 void VisualizationContainer::UpdateColors(unsigned short label) {
@@ -2486,61 +2805,93 @@ void VisualizationContainer::UpdateColors() {
 	labelColors->Build();
 }
 
-void VisualizationContainer::ExtractRegions(vtkIntArray* extents) {
+void VisualizationContainer::ExtractRegions(vtkImageConnectivityFilter* connectivity) {
 	qtWindow->initProgress("Processing segmentation data");
 
-	// Get label info
-	int maxLabel = labels->GetScalarRange()[1];
-
 	// Clear current regions
 
 	// XXX: THIS IS CLEARING ALL VOXELS IN THE LABEL DATA
 	regions->RemoveAll();
-	
-	for (int label = 1; label <= maxLabel; label++) {
-		double* regionExtent = extents->GetTuple(label - 1);
+
+	// Labels, extents, and sizes from the connectivity filter, so no scan is needed
+	vtkIdTypeArray* regionLabels = connectivity->GetExtractedRegionLabels();
+	vtkIdTypeArray* sizes = connectivity->GetExtractedRegionSizes();
+	vtkIntArray* extents = connectivity->GetExtractedRegionExtents();
+
+	vtkIdType numRegions = connectivity->GetNumberOfExtractedRegions();
+
+	for (vtkIdType i = 0; i < numRegions; i++) {
+		unsigned short label = (unsigned short)regionLabels->GetValue(i);
 
 		int extent[6];
-		for (int i = 0; i < 6; i++) {
-			extent[i] = (int)regionExtent[i];
+		for (int j = 0; j < 6; j++) {
+			extent[j] = extents->GetValue(i * 6 + j);
 		}
 
 		Region*	region = new Region(label, labelColors->GetTableValue(label), labels, extent);
-
-		if (region->GetNumVoxels() > 0) {
-			regions->Add(region);
-		}		
-		else {
-			delete region;
-		}
+		region->SetVoxelStats((int)sizes->GetValue(i));
+		regions->Add(region);
 
 		if (interactionMode == DotMode) {
 			region->ApplyDot(sliceView->GetDotSize());
 			region->ShowCenter(true);
 		}
 
-		qtWindow->updateProgress((double)label / maxLabel);
+		qtWindow->updateProgress((double)(i + 1) / numRegions);
 	}
 
+	regions->GetAdjacency()->Build(labels, data);
+
 	currentRegion = nullptr;
 }
 
 void VisualizationContainer::ExtractRegions(const std::vector<RegionInfo>& metadata) {
 	qtWindow->initProgress("Processing segmentation data");
 
-	// Get label info
-	int maxLabel = labels->GetScalarRange()[1];
-
 	// Clear current regions
 
 	// XXX: THIS IS CLEARING ALL VOXELS IN THE LABEL DATA
 	regions->RemoveAll();
 
+	// Stored voxel stats are trusted, so only scan if there is no metadata or some regions lack stats
+	bool scan = metadata.empty();
+
+	for (int i = 0; i < (int)metadata.size(); i++) {
+		if (metadata[i].GetNumVoxels() < 0) scan = true;
+	}
+
+	int maxLabel = 0;
+
+	if (scan) {
+		labelIndex->Compute(labels);
+		maxLabel = labelIndex->GetMaxLabel();
+	}
+
+	int progressTotal = std::max(1, std::max(maxLabel, (int)metadata.size()));
+
 	int regionCount = 0;
 
 	// First try metadata
 	for (int i = 0; i < (int)metadata.size(); i++) {
-		Region* region = new Region(metadata[i], labels);	
+		unsigned short label = metadata[i].GetLabel();
+
+		Region* region = nullptr;
+
+		if (metadata[i].GetNumVoxels() > 0) {
+			// Extent and voxel stats from the metadata
+			region = new Region(metadata[i], labels);
+		}
+		else if (metadata[i].GetNumVoxels() < 0 && labelIndex->Has(label)) {
+			const LabelIndex::LabelStats& stats = labelIndex->Get(label);
+
+			region = new Region(metadata[i], labels, stats.extent);
+			region->SetVoxelStats(stats.numVoxels);
+		}
+
+		if (!region) {
+			regionCount++;
+			continue;
+		}
 
 		const double* color = region->GetColor();
 
@@ -2552,60 +2903,54 @@ void VisualizationContainer::ExtractRegions(const std::vector<RegionInfo>& metad
 			region->SetColor(newColor[0], newColor[1], newColor[2]);
 		}
 
-		if (region->GetNumVoxels() > 0) {
-			regions->Add(region);
-
-			// Update done and verified status
-			if (region->GetDone()) {
-				region->SetDone(true);
-				labelColors->SetTableValue(region->GetLabel(), LabelColors::doneColor);
-			}
+		regions->Add(region);
 
-			if (region->GetVerified()) {
-				region->SetVerified(true);
-				labelColors->SetTableValue(region->GetLabel(), LabelColors::verifiedColor);
-			}
+		// Update done and verified status
+		if (region->GetDone()) {
+			region->SetDone(true);
+			labelColors->SetTableValue(region->GetLabel(), LabelColors::doneColor);
+		}
 
-			if (interactionMode == DotMode) {
-				region->ApplyDot(sliceView->GetDotSize());
-				region->ShowCenter(true);
-			}
+		if (region->GetVerified()) {
+			region->SetVerified(true);
+			labelColors->SetTableValue(region->GetLabel(), LabelColors::verifiedColor);
 		}
-		else {
-			delete region;
+
+		if (interactionMode == DotMode) {
+			region->ApplyDot(sliceView->GetDotSize());
+			region->ShowCenter(true);
 		}
 
 		regionCount++;
 
-		qtWindow->updateProgress((double)(regionCount + 1) / maxLabel);
+		qtWindow->updateProgress((double)(regionCount + 1) / progressTotal);
 	}
 
 	labelColors->Build();
 
-	// Add any remaining
+	// Add any remaining labels found by the scan
 	for (int label = 1; label <= maxLabel; label++) {
-		if (!regions->Has(label)) {
-			Region* region = new Region(label, labelColors->GetTableValue(label), labels);
+		if (!regions->Has(label) && labelIndex->Has(label)) {
+			const LabelIndex::LabelStats& stats = labelIndex->Get(label);
 
-			if (region->GetNumVoxels() > 0) {
-				regions->Add(region);
-			}
-			else {
-				delete region;
-			}
+			Region* region = new Region(label, labelColors->GetTableValue(label), labels, stats.extent);
+			region->SetVoxelStats(stats.numVoxels);
+			regions->Add(region);
 
 			regionCount++;
 
-			qtWindow->updateProgress((double)(regionCount + 1) / maxLabel);
+			qtWindow->updateProgress((double)(regionCount + 1) / progressTotal);
 		}
 	}
 
 	qtWindow->updateProgress(1.0);
 
+	regions->GetAdjacency()->Build(labels, data);
+
 	currentRegion = nullptr;
 }
 
-void VisualizationContainer::SaveRegionMetadata(std::string fileName) {
+void VisualizationContainer::SaveRegionMetadata(std::string segmentationFileName) {
 	std::vector<RegionInfo> metadata;
 
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
@@ -2616,7 +2961,15 @@ void VisualizationContainer::SaveRegionMetadata(std::string fileName) {
 		metadata.push_back(regionMetadata);
 	}
 
-	RegionMetadataIO::Write(fileName, metadata);
+	// Always written, as the sidecars are stamped with the segmentation file just saved
+	RegionMetadataIO::Write(segmentationFileName + ".regions", metadata, segmentationFileName);
+
+	// Keep a legacy JSON sidecar current for other readers, rather than leaving it stale
+	std::string jsonFileName = segmentationFileName + ".json";
+
+	if (QFile::exists(jsonFileName.c_str())) {
+		RegionMetadataIO::Write(jsonFileName, metadata, segmentationFileName);
+	}
 }
 
 int VisualizationContainer::SetLabel(int x, int y, int z, unsigned short label, bool overwrite) {	
@@ -2634,15 +2987,31 @@ int VisualizationContainer::SetLabel(int x, int y, int z, unsigned short label,
 	else if (overwrite ||
 		(label != 0 && old == 0) ||
 		(label == 0 && old == currentRegion->GetLabel())) {
-		*p = label;
+		WriteLabel(p, x, y, z, label);
 		labels->Modified();
 
+		UpdateEditExtent(x, y, z);
+
 		return old;
 	}
 
 	return -1;
 }
 
+void VisualizationContainer::WriteLabel(unsigned short* p, int x, int y, int z, unsigned short label) {
+	if (*p == label) return;
+
+	Region* oldRegion = regions->Get(*p);
+	if (oldRegion) oldRegion->RemoveVoxel(x, y, z);
+
+	Region* newRegion = regions->Get(label);
+	if (newRegion) newRegion->AddVoxel(x, y, z);
+
+	regions->GetAdjacency()->SetLabel(x, y, z, label);
+
+	*p = label;
+}
+
 unsigned short VisualizationContainer::GetLabel(int x, int y, int z) {
 	return *(static_cast<unsigned short*>(labels->GetScalarPointer(x, y, z)));
 }
@@ -2677,8 +3046,43 @@ bool VisualizationContainer::InBounds(int ijk[3]) {
 }
 
 void VisualizationContainer::PushHistory() {
-	history->Push(labels, regions);
+	history->Push(labels, regions, editExtent);
+	ResetEditExtent(editExtent);
 	numEdits++;
+
+	AppendEditJournal();
+}
+
+void VisualizationContainer::StartEditJournal() {
+	if (!labels || segmentationDataFileName.size() == 0) return;
+
+	// Remove the journal for any previous file, as its edits are now saved
+	journal->Close(true);
+	journal->Start(EditJournal::GetJournalFileName(segmentationDataFileName), labels->GetDimensions(), history->GetBrickSize(),
+		history->GetSnapshot(), history->GetRegionInfo());
+}
+
+void VisualizationContainer::AppendEditJournal() {
+	if (journal->IsOpen()) journal->Append(history->GetSnapshot(), history->GetRegionInfo());
+}
+
+void VisualizationContainer::ResetEditExtent(int extent[6]) {
+	extent[0] = extent[2] = extent[4] = VTK_INT_MAX;
+	extent[1] = extent[3] = extent[5] = VTK_INT_MIN;
+}
+
+void VisualizationContainer::UpdateEditExtent(int x, int y, int z) {
+	int extent[6] = { x, x, y, y, z, z };
+	UpdateEditExtent(extent);
+}
+
+void VisualizationContainer::UpdateEditExtent(const int extent[6]) {
+	for (int i = 0; i < 3; i++) {
+		editExtent[2 * i] = std::min(editExtent[2 * i], extent[2 * i]);
+		editExtent[2 * i + 1] = std::max(editExtent[2 * i + 1], extent[2 * i + 1]);
+		tempEditExtent[2 * i] = std::min(tempEditExtent[2 * i], extent[2 * i]);
+		tempEditExtent[2 * i + 1] = std::max(tempEditExtent[2 * i + 1], extent[2 * i + 1]);
+	}
 }
 
 void VisualizationContainer::UpdateVisibility(Region* highlightRegion) {
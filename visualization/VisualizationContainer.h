@@ -8,12 +8,21 @@
 #include <vtkSmartPointer.h>
 
 #include "InteractionEnums.h"
+#include "LabelBricks.h"
+#include "RegionInfo.h"
 #include "RegionMetadataIO.h"
 
 class MainWindow;
 
+class AutosaveWriter;
+class EditJournal;
+
+class vtkBrickedVolumeReader;
+
+class vtkAlgorithmOutput;
+class vtkImageChangeInformation;
+class vtkImageConnectivityFilter;
 class vtkImageData;
-class vtkIntArray;
 class vtkLookupTable;
 class vtkRenderWindowInteractor;
 
@@ -23,6 +32,7 @@ class Region;
 class RegionInfo;
 class RegionCollection;
 class History;
+class LabelIndex;
 
 class VisualizationContainer {
 public:
@@ -65,6 +75,7 @@ public:
 	void SetFilterMode(enum FilterMode mode);
 
 	void PickLabel(double point[3]);
+	unsigned short PickNearestLabel(double point[3]);
 	void Paint(double point[3], bool overwrite = false);
 	void Erase(double point[3]);
 
@@ -135,6 +146,22 @@ public:
 	double GetNeighborRadius();
 	void SetNeighborRadius(double radius);
 
+	// Memory cap for bricks cached when streaming bricked volumes, in megabytes
+	int GetBrickCacheSize();
+	void SetBrickCacheSize(int size);
+
+	// Edits journaled since the segmentation was last saved, left by a session that did not close normally
+	bool HasEditJournal();
+	bool RecoverEdits();
+	void DiscardEditJournal();
+
+	// Write a snapshot in the background if there are unsaved edits
+	void Autosave();
+
+	// Number of autosaves kept
+	int GetAutosaveRetention();
+	void SetAutosaveRetention(int retention);
+
 	void Render();
 
 	void Undo();
@@ -153,6 +180,9 @@ public:
 	void PushTempHistory();
 	void PopTempHistory();
 
+	// Compute voxel stats for any regions without them
+	void UpdateLabelIndex();
+
 protected:
 	// Qt main window
 	MainWindow* qtWindow;
@@ -161,6 +191,11 @@ protected:
 	vtkSmartPointer<vtkImageData> data;
 	vtkSmartPointer<vtkImageData> labels;
 
+	// Streams bricks for the slice view when the data is a bricked volume
+	vtkSmartPointer<vtkBrickedVolumeReader> brickReader;
+	vtkSmartPointer<vtkImageChangeInformation> brickStream;
+	int brickCacheSize;
+
 	// History
 	History* history;
 	int numEdits;
@@ -168,8 +203,13 @@ protected:
 	// Separate history for segmentation interface
 	History* tempHistory;
 
+	// Extent of label edits since the last history push, and since the last temp history push
+	int editExtent[6];
+	int tempEditExtent[6];
+
 	// Regions
 	RegionCollection* regions;
+	LabelIndex* labelIndex;
 	Region* currentRegion;
 	unsigned short hoverLabel;
 
@@ -193,36 +233,52 @@ protected:
 	// Current segmentation data filename
 	std::string segmentationDataFileName;
 
+	// Labels as last saved, for only writing changed bricks
+	LabelBricks::Snapshot savedLabels;
+	std::string savedLabelsFileName;
+
+	// Journal of edits since the last save
+	EditJournal* journal;
+
+	// Background autosave, with the labels and metadata last autosaved
+	AutosaveWriter* autosave;
+	LabelBricks::Snapshot autosavedLabels;
+	std::vector<RegionInfo> autosavedMetadata;
+
 	// Brush radius
 	int brushRadius;
 
 	// Neighbor radius
 	double neighborRadius;
 
-	void SetImageData(vtkImageData* imageData);
+	// Extension without the leading dot, including compound extensions such as nii.gz
+	static std::string GetFileExtension(const std::string& fileName);
+
+	void SetImageData(vtkImageData* imageData, vtkAlgorithmOutput* imageSource = nullptr);
 	bool SetLabelData(vtkImageData* labelData, const std::vector<RegionInfo>& metadata);
 
 	void InitializeLabels();
-	void UpdateLabels(vtkIntArray* extents);
+	void UpdateLabels(vtkImageConnectivityFilter* connectivity);
 	void UpdateLabels(const std::vector<RegionInfo>& metadata);
 	void UpdateColors();
 	void UpdateColors(unsigned short label);
 
 	void ExtractRegions();
-	void ExtractRegions(vtkIntArray* extents);
+	void ExtractRegions(vtkImageConnectivityFilter* connectivity);
 	void ExtractRegions(const std::vector<RegionInfo>& metadata);
 
 	void SplitRegionKMeans(Region* region, int numRegions);
 	void SplitRegionIntensity(Region* region, int numRegions);
 
-	bool CheckRegionConnected(Region* region);
-	bool CheckRegionHoles(Region* region);
+	// Shows a message and returns false if the region is not contiguous or has holes
+	bool ValidateRegion(Region* region);
 
 	// Region metadata
 	void LoadRegionMetadata(std::string fileName);
-	void SaveRegionMetadata(std::string fileName);
+	void SaveRegionMetadata(std::string segmentationFileName);
 
 	int SetLabel(int x, int y, int z, unsigned short label, bool overwrite = false);
+	void WriteLabel(unsigned short* p, int x, int y, int z, unsigned short label);
 	unsigned short GetLabel(int x, int y, int z);
 
 	double GetValue(int x, int y, int z);
@@ -236,6 +292,13 @@ protected:
 
 	void PushHistory();
 
+	void StartEditJournal();
+	void AppendEditJournal();
+
+	void ResetEditExtent(int extent[6]);
+	void UpdateEditExtent(int x, int y, int z);
+	void UpdateEditExtent(const int extent[6]);
+
 	void UpdateVisibility(Region* highlightRegion = nullptr);
 };
 
@@ -4,6 +4,7 @@
 #include <vtkCallbackCommand.h>
 #include <vtkCamera.h>
 #include <vtkColorTransferFunction.h>
+#include <vtkCompositePolyDataMapper2.h>
 #include <vtkCubeAxesActor.h>
 #include <vtkCubeSource.h>
 #include <vtkExtractVOI.h>
@@ -12,11 +13,14 @@
 #include <vtkImageMask.h>
 #include <vtkInteractorStyle.h>
 #include <vtkLight.h>
+#include <vtkMath.h>
+#include <vtkMultiBlockDataSet.h>
 #include <vtkOutlineCornerFilter.h>
 #include <vtkPassThrough.h>
 #include <vtkPiecewiseFunction.h>
 #include <vtkPlane.h>
 #include <vtkPlaneSource.h>
+#include <vtkPolyData.h>
 #include <vtkPolyDataMapper.h>
 #include <vtkProperty.h>
 #include <vtkRenderer.h>
@@ -40,7 +44,10 @@
 #include "RegionCenter3D.h"
 #include "RegionCollection.h"
 #include "SegmentorMath.h"
+#include "SurfaceDecimator.h"
+#include "VoxelIterator.h"
 
+#include <algorithm>
 #include <vector>
 
 double rescale(double value, double min, double max) {
@@ -53,6 +60,14 @@ void VolumeView::cameraChange(vtkObject* caller, unsigned long eventId, void* cl
 	pipeline->UpdatePlane();
 }
 
+void VolumeView::renderStart(vtkObject* caller, unsigned long eventId, void* clientData, void *callData) {
+	VolumeView* pipeline = static_cast<VolumeView*>(clientData);
+
+	pipeline->UpdateSurfaces();
+	pipeline->UpdateLevelOfDetail();
+	pipeline->UpdateSurfaceBatch();
+}
+
 VolumeView::VolumeView(vtkRenderWindowInteractor* interactor) {
 	data = nullptr;
 	labels = nullptr;
@@ -64,9 +79,14 @@ VolumeView::VolumeView(vtkRenderWindowInteractor* interactor) {
 	regions = nullptr;
 	currentRegion = nullptr;
 	highlightRegion = nullptr;
+	highlightLabel = 0;
 
 	visibleOpacity = 1.0;
 
+	// Surfaces smaller than this on screen, in pixels, are drawn decimated
+	decimator = new SurfaceDecimator();
+	lowDetailSize = 100.0;
+
 	// Rendering
 	renderer = vtkSmartPointer<vtkRenderer>::New();
 
@@ -82,6 +102,12 @@ VolumeView::VolumeView(vtkRenderWindowInteractor* interactor) {
 	cameraCallback->SetClientData(this);
 	renderer->GetActiveCamera()->AddObserver(vtkCommand::ModifiedEvent, cameraCallback);
 
+	// Render callback, to contour changed surfaces together before they are drawn
+	vtkSmartPointer<vtkCallbackCommand> renderCallback = vtkSmartPointer<vtkCallbackCommand>::New();
+	renderCallback->SetCallback(renderStart);
+	renderCallback->SetClientData(this);
+	renderer->AddObserver(vtkCommand::StartEvent, renderCallback);
+
 	// Probe
 	probe = new Probe(1.1, true);
 
@@ -92,6 +118,9 @@ VolumeView::VolumeView(vtkRenderWindowInteractor* interactor) {
 
 	renderer->AddActor(brush->GetActor());
 
+	// Surface batch
+	CreateSurfaceBatch();
+
 	// Plane
 	CreatePlane();
 
@@ -120,6 +149,7 @@ VolumeView::VolumeView(vtkRenderWindowInteractor* interactor) {
 }
 
 VolumeView::~VolumeView() {
+	delete decimator;
 }
 
 void VolumeView::Reset() {
@@ -129,6 +159,11 @@ void VolumeView::Reset() {
 	SetCurrentRegion(nullptr);
 	HighlightRegion(nullptr);
 
+	decimator->Clear();
+
+	surfaceBlocks->SetNumberOfBlocks(0);
+	surfaceBlocks->Modified();
+
 	probe->GetActor()->VisibilityOff();
 	brush->GetActor()->VisibilityOff();
 	plane->VisibilityOff();
@@ -174,6 +209,20 @@ void VolumeView::UpdateVoxelSize(vtkImageData* data) {
 	brush->UpdateBrush();
 	UpdatePlane(data);
 	UpdateAxes(data);
+
+	// Contours are cached in world coordinates, so all surfaces are contoured again at the new spacing
+	if (regions) {
+		for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+			Region* region = regions->Get(it);
+
+			if (region->HasSurface()) region->GetSurface()->InvalidateContour();
+		}
+	}
+
+	decimator->Clear();
+
+	surfaceBlocks->SetNumberOfBlocks(0);
+	surfaceBlocks->Modified();
 }
 
 void VolumeView::SetRegions(vtkImageData* imageLabels, RegionCollection* newRegions) {
@@ -183,9 +232,17 @@ void VolumeView::SetRegions(vtkImageData* imageLabels, RegionCollection* newRegi
 	// Reset
 	currentRegion = nullptr;
 	highlightRegion = nullptr;
+	highlightLabel = 0;
 
+	// Surfaces are created when regions are first shown
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		AddRegion(regions->Get(it));
+		Region* region = regions->Get(it);
+
+		if (region->GetShowCenter()) ShowRegionCenter(region, true);
+
+#ifdef SHOW_REGION_BOX
+		renderer->AddActor(region->GetBox());
+#endif
 	}
 
 	// Update probe
@@ -212,20 +269,9 @@ void VolumeView::SetRegions(vtkImageData* imageLabels, RegionCollection* newRegi
 }
 
 void VolumeView::AddRegion(Region* region) {
-	RegionSurface* surface = region->GetSurface();
-	RegionHighlight3D* highlight = region->GetHighlight3D();
-	RegionCenter3D* center = region->GetCenter3D();
-
-	surface->SetSmoothSurface(smoothSurfaces);
-	surface->SetSmoothShading(smoothShading);
-	surface->SetRenderMode(volumeRendering ? RegionSurface::CullFrontFace : RegionSurface::Normal);
-
-	highlight->GetActor()->VisibilityOff();
-	highlight->SetCamera(renderer->GetActiveCamera());
+	ShowRegion(region, true);
 
-	renderer->AddActor(surface->GetActor());
-	renderer->AddActor(highlight->GetActor());
-	renderer->AddActor(center->GetActor());
+	if (region->GetShowCenter()) ShowRegionCenter(region, true);
 
 #ifdef SHOW_REGION_BOX
 	renderer->AddActor(region->GetBox());
@@ -249,22 +295,207 @@ void VolumeView::SetCurrentRegion(Region* region) {
 void VolumeView::HighlightRegion(Region* region) {
 	if (!regions) return;
 
-	highlightRegion = region;
+	// Only the highlighted region keeps a highlight. The previous region may have been removed, so
+	// look it up by label.
+	Region* previous = regions->Get(highlightLabel);
 
-	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		regions->Get(it)->GetHighlight3D()->GetActor()->VisibilityOff();
-	}
+	if (previous && previous != region && previous->HasHighlight3D()) previous->ReleaseHighlight3D();
+
+	highlightRegion = region;
+	highlightLabel = region ? region->GetLabel() : 0;
 
 	if (highlightRegion) {
-		highlightRegion->GetHighlight3D()->Update();
-		highlightRegion->GetHighlight3D()->GetActor()->VisibilityOn();
+		RegionHighlight3D* highlight = highlightRegion->GetHighlight3D();
+
+		if (highlight->GetActor()->GetNumberOfConsumers() == 0) {
+			highlight->SetCamera(renderer->GetActiveCamera());
+			renderer->AddActor(highlight->GetActor());
+		}
+
+		highlight->Update();
+		highlight->GetActor()->VisibilityOn();
 	}
 
 	renderer->ResetCameraClippingRange();
 }
 
 void VolumeView::ShowRegion(Region* region, bool show) {
-	region->GetSurface()->GetActor()->SetVisibility(show);
+	if (!show && !region->HasSurface()) return;
+
+	// May have been created elsewhere, so check if it has been added
+	RegionSurface* surface = region->GetSurface();
+
+	if (surface->GetActor()->GetNumberOfConsumers() == 0) {
+		surface->SetSmoothSurface(smoothSurfaces);
+		surface->SetSmoothShading(smoothShading);
+		surface->SetRenderMode(volumeRendering ? RegionSurface::CullFrontFace : RegionSurface::Normal);
+
+		renderer->AddActor(surface->GetActor());
+	}
+
+	surface->GetActor()->SetVisibility(show);
+}
+
+void VolumeView::UpdateSurfaces() {
+	if (!regions || !labels) return;
+
+	// Hidden surfaces are contoured when shown
+	std::vector<RegionSurface*> surfaces;
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		Region* region = regions->Get(it);
+
+		if (!region->HasSurface()) continue;
+
+		RegionSurface* surface = region->GetSurface();
+
+		if (surface->NeedsContour() && surface->GetActor()->GetVisibility()) surfaces.push_back(surface);
+	}
+
+	RegionSurface::UpdateContours(labels, surfaces);
+}
+
+void VolumeView::UpdateLevelOfDetail() {
+	if (!regions) return;
+
+	// Results are matched by label and contour time, so stale ones are dropped
+	std::vector<SurfaceDecimator::Result> results = decimator->TakeResults();
+
+	for (const SurfaceDecimator::Result& result : results) {
+		Region* region = regions->Get(result.label);
+
+		if (region && region->HasSurface()) region->GetSurface()->SetLowDetailContour(result.polyData, result.contourTime);
+	}
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		Region* region = regions->Get(it);
+
+		if (!region->HasSurface()) continue;
+
+		RegionSurface* surface = region->GetSurface();
+
+		if (!surface->GetActor()->GetVisibility()) continue;
+
+		// Regions being worked on are always drawn at full detail
+		bool lowDetail = region != currentRegion && region != highlightRegion && GetProjectedSize(surface) < lowDetailSize;
+
+		if (lowDetail && surface->NeedsLowDetailContour()) {
+			decimator->Add(region->GetLabel(), surface->GetContourTime(), surface->GetContour());
+			surface->SetLowDetailContourRequested();
+		}
+
+		surface->SetLowDetail(lowDetail);
+	}
+}
+
+void VolumeView::UpdateSurfaceBatch() {
+	if (!regions) return;
+
+	unsigned int numBlocks = 0;
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		numBlocks = std::max(numBlocks, (unsigned int)regions->Get(it)->GetLabel() + 1);
+	}
+
+	bool modified = false;
+
+	if (surfaceBlocks->GetNumberOfBlocks() != numBlocks) {
+		surfaceBlocks->SetNumberOfBlocks(numBlocks);
+		modified = true;
+	}
+
+	std::vector<bool> batched(numBlocks, false);
+
+	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
+		Region* region = regions->Get(it);
+
+		if (!region->HasSurface()) continue;
+
+		RegionSurface* surface = region->GetSurface();
+
+		bool batch = region != currentRegion && region != highlightRegion;
+
+		surface->SetBatched(batch);
+
+		// The actor holds the block's visibility and properties
+		vtkActor* actor = surface->GetActor();
+
+		if (!batch || !actor->GetVisibility()) continue;
+
+		unsigned short label = region->GetLabel();
+
+		vtkPolyData* output = surface->GetOutput();
+
+		if (surfaceBlocks->GetBlock(label) != output) {
+			surfaceBlocks->SetBlock(label, output);
+			modified = true;
+		}
+		else if (output->GetMTime() > surfaceBatchTime) {
+			modified = true;
+		}
+
+		batched[label] = true;
+
+		// Blocks are at flat index label + 1, after the root
+		if (modified || actor->GetMTime() > surfaceBatchTime) {
+			surfaceBatchMapper->SetBlockColor(label + 1, actor->GetProperty()->GetColor());
+			surfaceBatchMapper->SetBlockOpacity(label + 1, actor->GetProperty()->GetOpacity());
+			surfaceBatchMapper->SetBlockVisibility(label + 1, true);
+		}
+	}
+
+	for (unsigned int i = 0; i < numBlocks; i++) {
+		if (!batched[i] && surfaceBlocks->GetBlock(i)) {
+			surfaceBlocks->SetBlock(i, nullptr);
+			surfaceBatchMapper->SetBlockVisibility(i + 1, false);
+			modified = true;
+		}
+	}
+
+	if (modified) surfaceBlocks->Modified();
+
+	surfaceBatchTime.Modified();
+}
+
+double VolumeView::GetProjectedSize(RegionSurface* surface) {
+	double bounds[6];
+	surface->GetContour()->GetBounds(bounds);
+
+	double center[3] = {
+		(bounds[0] + bounds[1]) / 2,
+		(bounds[2] + bounds[3]) / 2,
+		(bounds[4] + bounds[5]) / 2
+	};
+
+	double radius = sqrt(
+		(bounds[1] - bounds[0]) * (bounds[1] - bounds[0]) +
+		(bounds[3] - bounds[2]) * (bounds[3] - bounds[2]) +
+		(bounds[5] - bounds[4]) * (bounds[5] - bounds[4])) / 2;
+
+	vtkCamera* camera = renderer->GetActiveCamera();
+	double height = renderer->GetSize()[1];
+
+	// Diameter of the bounding sphere in pixels
+	if (camera->GetParallelProjection()) {
+		return radius / camera->GetParallelScale() * height;
+	}
+
+	double* position = camera->GetPosition();
+	double distance = sqrt(vtkMath::Distance2BetweenPoints(position, center));
+
+	if (distance <= radius) return VTK_DOUBLE_MAX;
+
+	return radius / (distance * tan(vtkMath::RadiansFromDegrees(camera->GetViewAngle()) / 2)) * height;
+}
+
+void VolumeView::ShowRegionCenter(Region* region, bool show) {
+	if (show) {
+		RegionCenter3D* center = region->GetCenter3D();
+
+		if (center->GetActor()->GetNumberOfConsumers() == 0) renderer->AddActor(center->GetActor());
+	}
+
+	region->ShowCenter(show);
 }
 
 void VolumeView::SetShowProbe(bool show) {
@@ -302,7 +533,9 @@ void VolumeView::SetSmoothSurfaces(bool smooth) {
 	smoothSurfaces = smooth;
 
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		regions->Get(it)->GetSurface()->SetSmoothSurface(smoothSurfaces);
+		Region* region = regions->Get(it);
+
+		if (region->HasSurface()) region->GetSurface()->SetSmoothSurface(smoothSurfaces);
 	}
 
 	Render();
@@ -320,7 +553,9 @@ void VolumeView::SetSmoothShading(bool smooth) {
 	smoothShading = smooth;
 
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		regions->Get(it)->GetSurface()->SetSmoothShading(smoothShading);
+		Region* region = regions->Get(it);
+
+		if (region->HasSurface()) region->GetSurface()->SetSmoothShading(smoothShading);
 	}
 
 	Render();
@@ -340,9 +575,13 @@ void VolumeView::SetVolumeRendering(bool useVolumeRendering) {
 	volume->SetVisibility(volumeRendering);
 	
 	for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
-		regions->Get(it)->GetSurface()->SetRenderMode(volumeRendering ? RegionSurface::CullFrontFace : RegionSurface::Normal);
+		Region* region = regions->Get(it);
+
+		if (region->HasSurface()) region->GetSurface()->SetRenderMode(volumeRendering ? RegionSurface::CullFrontFace : RegionSurface::Normal);
 	}
 
+	RegionSurface::ApplyRenderMode(surfaceBatch->GetProperty(), volumeRendering ? RegionSurface::CullFrontFace : RegionSurface::Normal);
+
 	Render();
 }
 
@@ -387,6 +626,9 @@ void VolumeView::UpdateVisibleOpacity(bool apply) {
 	if (regions) {
 		for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 			Region* region = regions->Get(it);
+
+			if (!region->HasSurface()) continue;
+
 			RegionSurface* surface = region->GetSurface();
 
 			double o = !apply || region == currentRegion ? 1 : visibleOpacity;
@@ -413,29 +655,18 @@ void VolumeView::UpdateVolumeMask(bool filter) {
 
 		const int* extent = mask->GetExtent();
 
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				for (int k = extent[4]; k <= extent[5]; k++) {
-					unsigned char* p = static_cast<unsigned char*>(mask->GetScalarPointer(i, j, k));
-					*p = 0;
-				}
-			}
-		}
+		VoxelIterator::ParallelForEach<unsigned char>(mask, extent, [](int, int, int, unsigned char& value) {
+			value = 0;
+		});
 
 		for (RegionCollection::Iterator it = regions->Begin(); it != regions->End(); it++) {
 			Region* region = regions->Get(it);
 			const int* extent = region->GetExtent();
 			
 			if (region == currentRegion || region->GetVisible()) {
-				for (int i = extent[0]; i <= extent[1]; i++) {
-					for (int j = extent[2]; j <= extent[3]; j++) {
-						for (int k = extent[4]; k <= extent[5]; k++) {
-							// Current label
-							unsigned char* p = static_cast<unsigned char*>(mask->GetScalarPointer(i, j, k));
-							*p = 1;
-						}
-					}
-				}
+				VoxelIterator::ForEach<unsigned char>(mask, extent, [](int, int, int, unsigned char& value) {
+					value = 1;
+				});
 			}
 		}
 
@@ -450,14 +681,9 @@ void VolumeView::UpdateVolumeMask(bool filter) {
 
 		const int* extent = mask->GetExtent();
 
-		for (int i = extent[0]; i <= extent[1]; i++) {
-			for (int j = extent[2]; j <= extent[3]; j++) {
-				for (int k = extent[4]; k <= extent[5]; k++) {
-					unsigned char* p = static_cast<unsigned char*>(mask->GetScalarPointer(i, j, k));
-					*p = 1;
-				}
-			}
-		}
+		VoxelIterator::ParallelForEach<unsigned char>(mask, extent, [](int, int, int, unsigned char& value) {
+			value = 1;
+		});
 
 		mask->Modified();
 
@@ -604,6 +830,25 @@ void VolumeView::UpdateVolumeRenderer() {
 	style->SetWindowLevel(window, level);
 }
 
+void VolumeView::CreateSurfaceBatch() {
+	surfaceBlocks = vtkSmartPointer<vtkMultiBlockDataSet>::New();
+
+	surfaceBatchMapper = vtkSmartPointer<vtkCompositePolyDataMapper2>::New();
+	surfaceBatchMapper->SetInputDataObject(surfaceBlocks);
+	surfaceBatchMapper->ScalarVisibilityOff();
+
+	// Match region surfaces
+	surfaceBatch = vtkSmartPointer<vtkActor>::New();
+	surfaceBatch->SetMapper(surfaceBatchMapper);
+	surfaceBatch->GetProperty()->SetDiffuse(1.0);
+	surfaceBatch->GetProperty()->SetAmbient(0.1);
+	surfaceBatch->GetProperty()->SetSpecular(0.0);
+
+	RegionSurface::ApplyRenderMode(surfaceBatch->GetProperty(), RegionSurface::Normal);
+
+	renderer->AddActor(surfaceBatch);
+}
+
 void VolumeView::CreatePlane() {
 	planeSource = vtkSmartPointer<vtkPlaneSource>::New();
 	planeSource->SetXResolution(100);
@@ -2,6 +2,7 @@
 #define VolumeView_H
 
 #include <vtkSmartPointer.h>
+#include <vtkTimeStamp.h>
 
 #include <vector>
 
@@ -10,10 +11,12 @@
 class vtkActor;
 class vtkBox;
 class vtkColorTransferFunction;
+class vtkCompositePolyDataMapper2;
 class vtkCubeAxesActor;
 class vtkImageCast;
 class vtkImageData;
 class vtkLookupTable;
+class vtkMultiBlockDataSet;
 class vtkImageMapToColors;
 class vtkImageMask;
 class vtkPiecewiseFunction;
@@ -34,6 +37,7 @@ class Probe;
 class Region;
 class RegionSurface;
 class RegionCollection;
+class SurfaceDecimator;
 
 class VolumeView {
 public:
@@ -59,6 +63,16 @@ public:
 	void HighlightRegion(Region* region);
 
 	void ShowRegion(Region* region, bool show = true);
+	void ShowRegionCenter(Region* region, bool show = true);
+
+	// Contour all shown surfaces whose regions have changed
+	void UpdateSurfaces();
+
+	// Draw decimated surfaces for regions that are small on screen
+	void UpdateLevelOfDetail();
+
+	// Draw surfaces other than the current and highlighted regions' with one composite mapper
+	void UpdateSurfaceBatch();
 
 	bool GetSmoothSurfaces();
 	void SetSmoothSurfaces(bool smooth);
@@ -107,6 +121,7 @@ protected:
 	
 	Region* currentRegion;
 	Region* highlightRegion;
+	unsigned short highlightLabel;
 
 	// Rendering
 	vtkSmartPointer<vtkRenderer> renderer;
@@ -115,6 +130,18 @@ protected:
 	// Regions
 	RegionCollection* regions;
 
+	// Level of detail
+	SurfaceDecimator* decimator;
+	double lowDetailSize;
+	double GetProjectedSize(RegionSurface* surface);
+
+	// Surface batch, with one block per label
+	vtkSmartPointer<vtkMultiBlockDataSet> surfaceBlocks;
+	vtkSmartPointer<vtkCompositePolyDataMapper2> surfaceBatchMapper;
+	vtkSmartPointer<vtkActor> surfaceBatch;
+	vtkTimeStamp surfaceBatchTime;
+	void CreateSurfaceBatch();
+
 	// Probe
 	Probe* probe;
 
@@ -155,6 +182,7 @@ protected:
 	double visibleOpacity;
 
 	static void cameraChange(vtkObject* caller, unsigned long eventId, void* clientData, void *callData);
+	static void renderStart(vtkObject* caller, unsigned long eventId, void* clientData, void *callData);
 };
 
 #endif
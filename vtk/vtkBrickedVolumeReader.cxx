@@ -0,0 +1,237 @@
+#include "vtkBrickedVolumeReader.h"
+
+#include "vtkDataObject.h"
+#include "vtkImageData.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkObjectFactory.h"
+#include "vtkSMPTools.h"
+#include "vtkStreamingDemandDrivenPipeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "BrickCache.h"
+
+vtkStandardNewMacro(vtkBrickedVolumeReader);
+
+namespace {
+	// Copy the intersection of each brick with the output extent, in parallel over bricks
+	class CopyBricks {
+	public:
+		CopyBricks(const std::string& fileName, const BrickedVolumeIO::Manifest& manifest, BrickCache* cache, vtkImageData* output, const int brickRange[6])
+		: success(true), fileName(fileName), manifest(manifest), cache(cache), output(output) {
+			BrickedVolumeIO::GetNumberOfBricks(manifest, numBricks);
+			output->GetExtent(extent);
+			scalarSize = output->GetScalarSize();
+
+			for (int i = 0; i < 6; i++) {
+				this->brickRange[i] = brickRange[i];
+			}
+		}
+
+		void operator()(vtkIdType begin, vtkIdType end) {
+			int nx = brickRange[1] - brickRange[0] + 1;
+			int ny = brickRange[3] - brickRange[2] + 1;
+
+			for (vtkIdType index = begin; index < end; index++) {
+				int brickIndex[3] = {
+					brickRange[0] + (int)(index % nx),
+					brickRange[2] + (int)(index / nx % ny),
+					brickRange[4] + (int)(index / ((vtkIdType)nx * ny))
+				};
+
+				BrickCache::BrickPointer brick = GetBrick(brickIndex);
+
+				if (!brick) {
+					success = false;
+					continue;
+				}
+
+				int brickExtent[6];
+				BrickedVolumeIO::GetBrickExtent(manifest, brickIndex, brickExtent);
+
+				// Intersection with the output extent
+				int copyExtent[6];
+				for (int i = 0; i < 3; i++) {
+					copyExtent[2 * i] = std::max(brickExtent[2 * i], extent[2 * i]);
+					copyExtent[2 * i + 1] = std::min(brickExtent[2 * i + 1], extent[2 * i + 1]);
+				}
+
+				size_t rowSize = (size_t)(copyExtent[1] - copyExtent[0] + 1) * scalarSize;
+				size_t brickRowSize = (size_t)(brickExtent[1] - brickExtent[0] + 1) * scalarSize;
+				size_t brickRows = brickExtent[3] - brickExtent[2] + 1;
+
+				for (int k = copyExtent[4]; k <= copyExtent[5]; k++) {
+					for (int j = copyExtent[2]; j <= copyExtent[3]; j++) {
+						void* p = output->GetScalarPointer(copyExtent[0], j, k);
+
+						if (brick->empty()) {
+							memset(p, 0, rowSize);
+						}
+						else {
+							size_t offset = ((k - brickExtent[4]) * brickRows + (j - brickExtent[2])) * brickRowSize +
+								(size_t)(copyExtent[0] - brickExtent[0]) * scalarSize;
+
+							memcpy(p, brick->data() + offset, rowSize);
+						}
+					}
+				}
+			}
+		}
+
+		std::atomic<bool> success;
+
+	protected:
+		std::string fileName;
+		const BrickedVolumeIO::Manifest& manifest;
+		BrickCache* cache;
+		vtkImageData* output;
+		int numBricks[3];
+		int brickRange[6];
+		int extent[6];
+		int scalarSize;
+
+		BrickCache::BrickPointer GetBrick(const int brickIndex[3]) {
+			vtkIdType key = brickIndex[0] + (vtkIdType)numBricks[0] * (brickIndex[1] + (vtkIdType)numBricks[1] * brickIndex[2]);
+
+			BrickCache::BrickPointer brick = cache->Get(key);
+
+			if (brick) return brick;
+
+			std::shared_ptr<std::vector<unsigned char>> newBrick = std::make_shared<std::vector<unsigned char>>();
+
+			if (!BrickedVolumeIO::ReadBrick(fileName, manifest, brickIndex, *newBrick)) return nullptr;
+
+			cache->Insert(key, newBrick);
+
+			return newBrick;
+		}
+	};
+}
+
+//----------------------------------------------------------------------------
+vtkBrickedVolumeReader::vtkBrickedVolumeReader()
+{
+	this->FileName = nullptr;
+	this->Cache.reset(new BrickCache((size_t)1 << 30));
+
+	this->SetNumberOfInputPorts(0);
+}
+
+//----------------------------------------------------------------------------
+vtkBrickedVolumeReader::~vtkBrickedVolumeReader()
+{
+	this->SetFileName(nullptr);
+}
+
+//----------------------------------------------------------------------------
+void vtkBrickedVolumeReader::SetMaximumCacheSize(size_t size)
+{
+	this->Cache->SetMaxMemory(size);
+}
+
+//----------------------------------------------------------------------------
+size_t vtkBrickedVolumeReader::GetMaximumCacheSize()
+{
+	return this->Cache->GetMaxMemory();
+}
+
+//----------------------------------------------------------------------------
+size_t vtkBrickedVolumeReader::GetCacheSize()
+{
+	return this->Cache->GetMemorySize();
+}
+
+//----------------------------------------------------------------------------
+// Read the manifest and report the whole extent
+int vtkBrickedVolumeReader::RequestInformation(
+	vtkInformation *vtkNotUsed(request),
+	vtkInformationVector **vtkNotUsed(inputVector),
+	vtkInformationVector *outputVector)
+{
+	if (this->FileName == nullptr)
+	{
+		vtkErrorMacro(<< "No file name.");
+		return 0;
+	}
+	if (!BrickedVolumeIO::ReadManifest(this->FileName, this->Manifest))
+	{
+		vtkErrorMacro(<< "Could not read manifest " << this->FileName);
+		return 0;
+	}
+
+	// Cached bricks are only valid for the file they were read from
+	if (this->CacheFileName != this->FileName)
+	{
+		this->Cache->Clear();
+		this->CacheFileName = this->FileName;
+	}
+
+	vtkInformation* outInfo = outputVector->GetInformationObject(0);
+
+	int wholeExtent[6] = {
+		0, this->Manifest.dimensions[0] - 1,
+		0, this->Manifest.dimensions[1] - 1,
+		0, this->Manifest.dimensions[2] - 1
+	};
+	double origin[3] = { 0, 0, 0 };
+
+	outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), wholeExtent, 6);
+	outInfo->Set(vtkDataObject::SPACING(), this->Manifest.spacing, 3);
+	outInfo->Set(vtkDataObject::ORIGIN(), origin, 3);
+	outInfo->Set(vtkAlgorithm::CAN_PRODUCE_SUB_EXTENT(), 1);
+
+	vtkDataObject::SetPointDataActiveScalarInfo(outInfo, this->Manifest.scalarType, 1);
+
+	return 1;
+}
+
+//----------------------------------------------------------------------------
+// Read bricks intersecting the update extent
+int vtkBrickedVolumeReader::RequestData(
+	vtkInformation *vtkNotUsed(request),
+	vtkInformationVector **vtkNotUsed(inputVector),
+	vtkInformationVector *outputVector)
+{
+	vtkInformation* outInfo = outputVector->GetInformationObject(0);
+	vtkImageData* output = vtkImageData::GetData(outputVector, 0);
+
+	if (output == nullptr)
+	{
+		vtkErrorMacro(<< "Output data is nullptr.");
+		return 0;
+	}
+
+	int updateExtent[6];
+	outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), updateExtent);
+
+	output->SetExtent(updateExtent);
+	output->AllocateScalars(this->Manifest.scalarType, 1);
+
+	if (output->GetNumberOfPoints() == 0) return 1;
+
+	// Range of brick indices
+	int brickRange[6];
+	for (int i = 0; i < 6; i++)
+	{
+		brickRange[i] = updateExtent[i] / this->Manifest.brickSize;
+	}
+
+	vtkIdType numBricks = (vtkIdType)(brickRange[1] - brickRange[0] + 1) *
+		(brickRange[3] - brickRange[2] + 1) *
+		(brickRange[5] - brickRange[4] + 1);
+
+	CopyBricks copy(this->FileName, this->Manifest, this->Cache.get(), output, brickRange);
+	vtkSMPTools::For(0, numBricks, copy);
+
+	if (!copy.success)
+	{
+		vtkErrorMacro(<< "Could not read bricks for " << this->FileName);
+		return 0;
+	}
+
+	return 1;
+}
@@ -0,0 +1,51 @@
+#ifndef vtkBrickedVolumeReader_h
+#define vtkBrickedVolumeReader_h
+
+#include <vtkImageAlgorithm.h>
+#include <vtkSetGet.h>
+
+#include <memory>
+#include <string>
+
+#include "BrickedVolumeIO.h"
+
+class BrickCache;
+
+// Streaming reader for bricked volumes. Only bricks intersecting the update extent are read,
+// so downstream filters requesting a sub-extent (e.g. a streaming reslice mapper) avoid
+// loading the whole volume. Decompressed bricks are kept in an LRU cache.
+class vtkBrickedVolumeReader : public vtkImageAlgorithm
+{
+public:
+	static vtkBrickedVolumeReader* New();
+	vtkTypeMacro(vtkBrickedVolumeReader, vtkImageAlgorithm);
+
+	vtkSetStringMacro(FileName);
+	vtkGetStringMacro(FileName);
+
+	// Cache memory cap in bytes, zero to disable caching
+	void SetMaximumCacheSize(size_t size);
+	size_t GetMaximumCacheSize();
+
+	size_t GetCacheSize();
+
+protected:
+	vtkBrickedVolumeReader();
+	~vtkBrickedVolumeReader() override;
+
+	char* FileName;
+
+	BrickedVolumeIO::Manifest Manifest;
+
+	std::string CacheFileName;
+	std::unique_ptr<BrickCache> Cache;
+
+	int RequestInformation(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+	int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+
+private:
+	vtkBrickedVolumeReader(const vtkBrickedVolumeReader&) = delete;
+	void operator=(const vtkBrickedVolumeReader&) = delete;
+};
+
+#endif
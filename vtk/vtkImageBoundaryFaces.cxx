@@ -0,0 +1,263 @@
+#include "vtkImageBoundaryFaces.h"
+
+#include "vtkCellArray.h"
+#include "vtkFloatArray.h"
+#include "vtkIdTypeArray.h"
+#include "vtkImageData.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkObjectFactory.h"
+#include "vtkPointData.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkSMPTools.h"
+#include "vtkSmartPointer.h"
+
+#include <vector>
+
+vtkStandardNewMacro(vtkImageBoundaryFaces);
+
+namespace {
+	// Voxel selection over the input extent, with voxels outside the extent unselected
+	template <class T>
+	class Selection {
+	public:
+		Selection(vtkImageData* input, double lower, double upper)
+		: lower(lower), upper(upper) {
+			input->GetDimensions(dims);
+			scalars = static_cast<T*>(input->GetScalarPointer());
+		}
+
+		bool operator()(int i, int j, int k) const {
+			if (i < 0 || j < 0 || k < 0 || i >= dims[0] || j >= dims[1] || k >= dims[2]) return false;
+
+			double value = scalars[i + dims[0] * ((vtkIdType)j + (vtkIdType)dims[1] * k)];
+
+			return value >= lower && value <= upper;
+		}
+
+		int dims[3];
+
+	private:
+		T* scalars;
+		double lower;
+		double upper;
+	};
+
+	template <class T>
+	void ExtractFaces(vtkImageData* input, double lower, double upper, vtkPolyData* output) {
+		Selection<T> selected(input, lower, upper);
+
+		const int* dims = selected.dims;
+
+		// Corner lattice
+		int cx = dims[0] + 1;
+		int cy = dims[1] + 1;
+		int cz = dims[2] + 1;
+
+		// A corner is on the boundary if its eight surrounding voxels are not all the same, which
+		// can be decided per corner, so points are numbered within each corner plane in parallel
+		std::vector<int> cornerIds((size_t)cx * cy * cz);
+		std::vector<vtkIdType> planeOffsets(cz + 1, 0);
+
+		vtkSMPTools::For(0, cz, [&](vtkIdType begin, vtkIdType end) {
+			for (int kc = (int)begin; kc < (int)end; kc++) {
+				int* ids = &cornerIds[(size_t)cx * cy * kc];
+				int count = 0;
+
+				for (int jc = 0; jc < cy; jc++) {
+					for (int ic = 0; ic < cx; ic++, ids++) {
+						bool first = selected(ic, jc, kc);
+						bool boundary = false;
+
+						for (int n = 1; n < 8 && !boundary; n++) {
+							boundary = selected(ic - (n & 1), jc - ((n >> 1) & 1), kc - ((n >> 2) & 1)) != first;
+						}
+
+						*ids = boundary ? count++ : -1;
+					}
+				}
+
+				planeOffsets[kc + 1] = count;
+			}
+		});
+
+		for (int kc = 0; kc < cz; kc++) {
+			planeOffsets[kc + 1] += planeOffsets[kc];
+		}
+
+		vtkIdType numPoints = planeOffsets[cz];
+
+		// Points at voxel corners
+		const int* extent = input->GetExtent();
+		const double* origin = input->GetOrigin();
+		const double* spacing = input->GetSpacing();
+
+		vtkSmartPointer<vtkFloatArray> coordinates = vtkSmartPointer<vtkFloatArray>::New();
+		coordinates->SetNumberOfComponents(3);
+		coordinates->SetNumberOfTuples(numPoints);
+
+		float* pointData = coordinates->GetPointer(0);
+
+		vtkSMPTools::For(0, cz, [&](vtkIdType begin, vtkIdType end) {
+			for (int kc = (int)begin; kc < (int)end; kc++) {
+				const int* ids = &cornerIds[(size_t)cx * cy * kc];
+				float* p = pointData + 3 * planeOffsets[kc];
+
+				float z = (float)(origin[2] + (extent[4] + kc - 0.5) * spacing[2]);
+
+				for (int jc = 0; jc < cy; jc++) {
+					float y = (float)(origin[1] + (extent[2] + jc - 0.5) * spacing[1]);
+
+					for (int ic = 0; ic < cx; ic++, ids++) {
+						if (*ids < 0) continue;
+
+						*p++ = (float)(origin[0] + (extent[0] + ic - 0.5) * spacing[0]);
+						*p++ = y;
+						*p++ = z;
+					}
+				}
+			}
+		});
+
+		// Count exposed faces per voxel slice
+		std::vector<vtkIdType> sliceOffsets(dims[2] + 1, 0);
+
+		vtkSMPTools::For(0, dims[2], [&](vtkIdType begin, vtkIdType end) {
+			for (int k = (int)begin; k < (int)end; k++) {
+				vtkIdType count = 0;
+
+				for (int j = 0; j < dims[1]; j++) {
+					for (int i = 0; i < dims[0]; i++) {
+						if (!selected(i, j, k)) continue;
+
+						count +=
+							!selected(i - 1, j, k) + !selected(i + 1, j, k) +
+							!selected(i, j - 1, k) + !selected(i, j + 1, k) +
+							!selected(i, j, k - 1) + !selected(i, j, k + 1);
+					}
+				}
+
+				sliceOffsets[k + 1] = count;
+			}
+		});
+
+		for (int k = 0; k < dims[2]; k++) {
+			sliceOffsets[k + 1] += sliceOffsets[k];
+		}
+
+		vtkIdType numFaces = sliceOffsets[dims[2]];
+
+		// Quads in legacy cell array layout, written in place per slice
+		vtkSmartPointer<vtkIdTypeArray> connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+		connectivity->SetNumberOfValues(numFaces * 5);
+
+		vtkIdType* cellData = connectivity->GetPointer(0);
+
+		auto cornerId = [&](int ic, int jc, int kc) {
+			return planeOffsets[kc] + cornerIds[ic + (size_t)cx * (jc + (size_t)cy * kc)];
+		};
+
+		vtkSMPTools::For(0, dims[2], [&](vtkIdType begin, vtkIdType end) {
+			for (int k = (int)begin; k < (int)end; k++) {
+				vtkIdType* c = cellData + 5 * sliceOffsets[k];
+
+				auto addFace = [&](vtkIdType a, vtkIdType b, vtkIdType d, vtkIdType e) {
+					*c++ = 4;
+					*c++ = a;
+					*c++ = b;
+					*c++ = d;
+					*c++ = e;
+				};
+
+				for (int j = 0; j < dims[1]; j++) {
+					for (int i = 0; i < dims[0]; i++) {
+						if (!selected(i, j, k)) continue;
+
+						// Counterclockwise seen from outside
+						if (!selected(i - 1, j, k)) addFace(cornerId(i, j, k), cornerId(i, j, k + 1), cornerId(i, j + 1, k + 1), cornerId(i, j + 1, k));
+						if (!selected(i + 1, j, k)) addFace(cornerId(i + 1, j, k), cornerId(i + 1, j + 1, k), cornerId(i + 1, j + 1, k + 1), cornerId(i + 1, j, k + 1));
+						if (!selected(i, j - 1, k)) addFace(cornerId(i, j, k), cornerId(i + 1, j, k), cornerId(i + 1, j, k + 1), cornerId(i, j, k + 1));
+						if (!selected(i, j + 1, k)) addFace(cornerId(i, j + 1, k), cornerId(i, j + 1, k + 1), cornerId(i + 1, j + 1, k + 1), cornerId(i + 1, j + 1, k));
+						if (!selected(i, j, k - 1)) addFace(cornerId(i, j, k), cornerId(i, j + 1, k), cornerId(i + 1, j + 1, k), cornerId(i + 1, j, k));
+						if (!selected(i, j, k + 1)) addFace(cornerId(i, j, k + 1), cornerId(i + 1, j, k + 1), cornerId(i + 1, j + 1, k + 1), cornerId(i, j + 1, k + 1));
+					}
+				}
+			}
+		});
+
+		vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+		points->SetData(coordinates);
+
+		vtkSmartPointer<vtkCellArray> polys = vtkSmartPointer<vtkCellArray>::New();
+		polys->SetCells(numFaces, connectivity);
+
+		output->SetPoints(points);
+		output->SetPolys(polys);
+	}
+}
+
+//----------------------------------------------------------------------------
+vtkImageBoundaryFaces::vtkImageBoundaryFaces()
+{
+	this->LowerThreshold = 1;
+	this->UpperThreshold = VTK_DOUBLE_MAX;
+}
+
+//----------------------------------------------------------------------------
+vtkImageBoundaryFaces::~vtkImageBoundaryFaces()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkImageBoundaryFaces::ThresholdBetween(double lower, double upper)
+{
+	if (this->LowerThreshold != lower || this->UpperThreshold != upper)
+	{
+		this->LowerThreshold = lower;
+		this->UpperThreshold = upper;
+		this->Modified();
+	}
+}
+
+//----------------------------------------------------------------------------
+// Extract exposed faces of selected voxels
+int vtkImageBoundaryFaces::RequestData(
+	vtkInformation *vtkNotUsed(request),
+	vtkInformationVector **inputVector,
+	vtkInformationVector *outputVector)
+{
+	vtkImageData* input = vtkImageData::GetData(inputVector[0], 0);
+	vtkPolyData* output = vtkPolyData::GetData(outputVector, 0);
+
+	if (input == nullptr)
+	{
+		vtkErrorMacro(<< "Input data is nullptr.");
+		return 0;
+	}
+	if (output == nullptr)
+	{
+		vtkErrorMacro(<< "Output data is nullptr.");
+		return 0;
+	}
+
+	if (input->GetNumberOfPoints() == 0 || input->GetPointData()->GetScalars() == nullptr) return 1;
+
+	switch (input->GetScalarType())
+	{
+		vtkTemplateMacro(ExtractFaces<VTK_TT>(input, this->LowerThreshold, this->UpperThreshold, output));
+
+	default:
+		vtkErrorMacro(<< "Unsupported scalar type.");
+		return 0;
+	}
+
+	return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageBoundaryFaces::FillInputPortInformation(int vtkNotUsed(port), vtkInformation *info)
+{
+	info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData");
+	return 1;
+}
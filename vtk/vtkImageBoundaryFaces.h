@@ -0,0 +1,38 @@
+#ifndef vtkImageBoundaryFaces_h
+#define vtkImageBoundaryFaces_h
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSetGet.h>
+
+// Extracts the exposed faces of voxels with scalars in a range, as quads with outward normals.
+// Faces are shared between a selected voxel and an unselected neighbor or the image boundary,
+// and points are shared between faces. Produces the same surface as converting voxels to
+// hexahedra, thresholding, and extracting geometry, without building the hexahedral grid.
+class vtkImageBoundaryFaces : public vtkPolyDataAlgorithm
+{
+public:
+	static vtkImageBoundaryFaces* New();
+	vtkTypeMacro(vtkImageBoundaryFaces, vtkPolyDataAlgorithm);
+
+	// Inclusive scalar range for selected voxels
+	void ThresholdBetween(double lower, double upper);
+
+	vtkGetMacro(LowerThreshold, double);
+	vtkGetMacro(UpperThreshold, double);
+
+protected:
+	vtkImageBoundaryFaces();
+	~vtkImageBoundaryFaces() override;
+
+	double LowerThreshold;
+	double UpperThreshold;
+
+	int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+	int FillInputPortInformation(int port, vtkInformation *info) override;
+
+private:
+	vtkImageBoundaryFaces(const vtkImageBoundaryFaces&) = delete;
+	void operator=(const vtkImageBoundaryFaces&) = delete;
+};
+
+#endif
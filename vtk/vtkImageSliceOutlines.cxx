@@ -0,0 +1,289 @@
+#include "vtkImageSliceOutlines.h"
+
+#include "vtkCellArray.h"
+#include "vtkCellData.h"
+#include "vtkFloatArray.h"
+#include "vtkIdTypeArray.h"
+#include "vtkImageData.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkObjectFactory.h"
+#include "vtkPoints.h"
+#include "vtkPolyData.h"
+#include "vtkSMPTools.h"
+#include "vtkSmartPointer.h"
+#include "vtkUnsignedShortArray.h"
+
+#include <cmath>
+
+vtkStandardNewMacro(vtkImageSliceOutlines);
+
+//----------------------------------------------------------------------------
+vtkImageSliceOutlines::vtkImageSliceOutlines()
+{
+	this->Axis = 2;
+	this->Position = 0.0;
+	this->DefaultVisible = true;
+	this->MaximumCachedSlices = 16;
+	this->CacheTime = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkImageSliceOutlines::~vtkImageSliceOutlines()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceOutlines::SetSlice(int axis, double position)
+{
+	if (axis < 0 || axis > 2) return;
+
+	if (this->Axis != axis || this->Position != position) {
+		this->Axis = axis;
+		this->Position = position;
+		this->Modified();
+	}
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceOutlines::SetLabelVisible(unsigned short label, bool visible)
+{
+	if (this->IsLabelVisible(label) == visible) return;
+
+	if (label >= this->LabelVisible.size()) {
+		this->LabelVisible.resize(label + 1, this->DefaultVisible);
+	}
+
+	this->LabelVisible[label] = visible;
+	this->Modified();
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceOutlines::SetAllLabelsVisible(bool visible)
+{
+	this->LabelVisible.clear();
+	this->DefaultVisible = visible;
+	this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkImageSliceOutlines::IsLabelVisible(unsigned short label)
+{
+	return label < this->LabelVisible.size() ? this->LabelVisible[label] : this->DefaultVisible;
+}
+
+//----------------------------------------------------------------------------
+void vtkImageSliceOutlines::ClearCache()
+{
+	this->Cache.clear();
+	this->Modified();
+}
+
+//----------------------------------------------------------------------------
+const vtkImageSliceOutlines::SegmentList& vtkImageSliceOutlines::GetSegments(vtkImageData* input, int slice)
+{
+	std::pair<int, int> key(this->Axis, slice);
+
+	std::map<std::pair<int, int>, SegmentList>::iterator it = this->Cache.find(key);
+
+	if (it != this->Cache.end()) return it->second;
+
+	if ((int)this->Cache.size() >= this->MaximumCachedSlices) this->Cache.clear();
+
+	SegmentList& segments = this->Cache[key];
+	this->TraceSlice(input, slice, segments);
+
+	return segments;
+}
+
+//----------------------------------------------------------------------------
+// Trace edges between pixels with different labels, in parallel over rows
+void vtkImageSliceOutlines::TraceSlice(vtkImageData* input, int slice, SegmentList& segments)
+{
+	int* dims = input->GetDimensions();
+	const unsigned short* scalars = static_cast<const unsigned short*>(input->GetScalarPointer());
+
+	// In-plane axes
+	int a = this->Axis;
+	int u = a == 0 ? 1 : 0;
+	int v = a == 2 ? 1 : 2;
+
+	int nu = dims[u];
+	int nv = dims[v];
+
+	vtkIdType stride[3] = { 1, dims[0], (vtkIdType)dims[0] * dims[1] };
+
+	const unsigned short* sliceScalars = scalars + slice * stride[a];
+
+	// Zero outside the slice
+	auto get = [&](int iu, int iv) -> unsigned short {
+		if (iu < 0 || iv < 0 || iu >= nu || iv >= nv) return 0;
+
+		return sliceScalars[iu * stride[u] + iv * stride[v]];
+	};
+
+	// Row iv holds edges to the right of and above pixels in that row, starting outside
+	std::vector<SegmentList> rows(nv + 1);
+
+	vtkSMPTools::For(0, nv + 1, [&](vtkIdType begin, vtkIdType end) {
+		for (vtkIdType row = begin; row < end; row++) {
+			int iv = (int)row - 1;
+			SegmentList& rowSegments = rows[row];
+
+			auto add = [&](unsigned short label, int u0, int v0, int u1, int v1) {
+				if (label == 0) return;
+
+				Segment segment = { label, u0, v0, u1, v1 };
+				rowSegments.push_back(segment);
+			};
+
+			for (int iu = -1; iu < nu; iu++) {
+				unsigned short label = get(iu, iv);
+				unsigned short right = get(iu + 1, iv);
+				unsigned short above = get(iu, iv + 1);
+
+				// Pixel p spans corners p and p + 1
+				if (label != right) {
+					add(label, iu + 1, iv, iu + 1, iv + 1);
+					add(right, iu + 1, iv, iu + 1, iv + 1);
+				}
+
+				if (label != above) {
+					add(label, iu, iv + 1, iu + 1, iv + 1);
+					add(above, iu, iv + 1, iu + 1, iv + 1);
+				}
+			}
+		}
+	});
+
+	size_t numSegments = 0;
+	for (size_t i = 0; i < rows.size(); i++) {
+		numSegments += rows[i].size();
+	}
+
+	segments.clear();
+	segments.reserve(numSegments);
+
+	for (size_t i = 0; i < rows.size(); i++) {
+		segments.insert(segments.end(), rows[i].begin(), rows[i].end());
+	}
+}
+
+//----------------------------------------------------------------------------
+// Output visible label outlines for the current slice
+int vtkImageSliceOutlines::RequestData(
+	vtkInformation *vtkNotUsed(request),
+	vtkInformationVector **inputVector,
+	vtkInformationVector *outputVector)
+{
+	vtkImageData* input = vtkImageData::GetData(inputVector[0], 0);
+	vtkPolyData* output = vtkPolyData::GetData(outputVector, 0);
+
+	if (input == nullptr) {
+		vtkErrorMacro(<< "Input data is nullptr.");
+		return 0;
+	}
+	if (output == nullptr) {
+		vtkErrorMacro(<< "Output data is nullptr.");
+		return 0;
+	}
+
+	if (input->GetNumberOfPoints() == 0) return 1;
+
+	if (input->GetScalarType() != VTK_UNSIGNED_SHORT || input->GetNumberOfScalarComponents() != 1) {
+		vtkErrorMacro(<< "Labels must be single component unsigned short.");
+		return 0;
+	}
+
+	// Edits invalidate all traced slices
+	if (input->GetMTime() != this->CacheTime) {
+		this->Cache.clear();
+		this->CacheTime = input->GetMTime();
+	}
+
+	int* extent = input->GetExtent();
+	int* dims = input->GetDimensions();
+	double* origin = input->GetOrigin();
+	double* spacing = input->GetSpacing();
+
+	int a = this->Axis;
+	int u = a == 0 ? 1 : 0;
+	int v = a == 2 ? 1 : 2;
+
+	// Nearest slice
+	int slice = (int)std::floor((this->Position - origin[a]) / spacing[a] + 0.5) - extent[2 * a];
+
+	if (slice < 0 || slice >= dims[a]) return 1;
+
+	const SegmentList& segments = this->GetSegments(input, slice);
+
+	vtkIdType numVisible = 0;
+	for (size_t i = 0; i < segments.size(); i++) {
+		if (this->IsLabelVisible(segments[i].Label)) numVisible++;
+	}
+
+	vtkSmartPointer<vtkFloatArray> coordinates = vtkSmartPointer<vtkFloatArray>::New();
+	coordinates->SetNumberOfComponents(3);
+	coordinates->SetNumberOfTuples(numVisible * 2);
+
+	vtkSmartPointer<vtkIdTypeArray> connectivity = vtkSmartPointer<vtkIdTypeArray>::New();
+	connectivity->SetNumberOfValues(numVisible * 3);
+
+	vtkSmartPointer<vtkUnsignedShortArray> labels = vtkSmartPointer<vtkUnsignedShortArray>::New();
+	labels->SetName("Labels");
+	labels->SetNumberOfValues(numVisible);
+
+	float* p = coordinates->GetPointer(0);
+	vtkIdType* c = connectivity->GetPointer(0);
+
+	// Corner c is half a voxel before pixel c
+	auto corner = [&](int axis, int index) {
+		return (float)(origin[axis] + (extent[2 * axis] + index - 0.5) * spacing[axis]);
+	};
+
+	float w = (float)(origin[a] + (extent[2 * a] + slice) * spacing[a]);
+
+	vtkIdType n = 0;
+	for (size_t i = 0; i < segments.size(); i++) {
+		const Segment& segment = segments[i];
+
+		if (!this->IsLabelVisible(segment.Label)) continue;
+
+		float p0[3], p1[3];
+		p0[a] = p1[a] = w;
+		p0[u] = corner(u, segment.U0);
+		p0[v] = corner(v, segment.V0);
+		p1[u] = corner(u, segment.U1);
+		p1[v] = corner(v, segment.V1);
+
+		for (int j = 0; j < 3; j++) *p++ = p0[j];
+		for (int j = 0; j < 3; j++) *p++ = p1[j];
+
+		*c++ = 2;
+		*c++ = 2 * n;
+		*c++ = 2 * n + 1;
+
+		labels->SetValue(n, segment.Label);
+
+		n++;
+	}
+
+	vtkSmartPointer<vtkPoints> points = vtkSmartPointer<vtkPoints>::New();
+	points->SetData(coordinates);
+
+	vtkSmartPointer<vtkCellArray> lines = vtkSmartPointer<vtkCellArray>::New();
+	lines->SetCells(numVisible, connectivity);
+
+	output->SetPoints(points);
+	output->SetLines(lines);
+	output->GetCellData()->SetScalars(labels);
+
+	return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkImageSliceOutlines::FillInputPortInformation(int vtkNotUsed(port), vtkInformation *info)
+{
+	info->Set(vtkAlgorithm::INPUT_REQUIRED_DATA_TYPE(), "vtkImageData");
+	return 1;
+}
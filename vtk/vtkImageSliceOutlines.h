@@ -0,0 +1,70 @@
+#ifndef vtkImageSliceOutlines_h
+#define vtkImageSliceOutlines_h
+
+#include <vtkPolyDataAlgorithm.h>
+#include <vtkSetGet.h>
+
+#include <map>
+#include <utility>
+#include <vector>
+
+// Outlines of labels on an axis-aligned slice of a label image, as line segments along pixel
+// edges with the label as cell scalars. All labels are traced in one pass over the slice.
+// Traced slices are cached by index, and the cache is cleared when the labels are modified,
+// so revisiting slices or changing label visibility does not retrace.
+class vtkImageSliceOutlines : public vtkPolyDataAlgorithm
+{
+public:
+	static vtkImageSliceOutlines* New();
+	vtkTypeMacro(vtkImageSliceOutlines, vtkPolyDataAlgorithm);
+
+	// Slice normal axis and world position along it
+	void SetSlice(int axis, double position);
+
+	// Labels not set visible are traced but not output
+	void SetLabelVisible(unsigned short label, bool visible);
+	void SetAllLabelsVisible(bool visible);
+
+	vtkSetMacro(MaximumCachedSlices, int);
+	vtkGetMacro(MaximumCachedSlices, int);
+
+	void ClearCache();
+
+protected:
+	vtkImageSliceOutlines();
+	~vtkImageSliceOutlines() override;
+
+	int Axis;
+	double Position;
+
+	std::vector<bool> LabelVisible;
+	bool DefaultVisible;
+
+	// Pixel edge, in corner indices of the slice
+	struct Segment {
+		unsigned short Label;
+		int U0, V0, U1, V1;
+	};
+
+	typedef std::vector<Segment> SegmentList;
+
+	std::map<std::pair<int, int>, SegmentList> Cache;
+	int MaximumCachedSlices;
+
+	// Label modified time the cache was traced at
+	vtkMTimeType CacheTime;
+
+	const SegmentList& GetSegments(vtkImageData* input, int slice);
+	void TraceSlice(vtkImageData* input, int slice, SegmentList& segments);
+
+	bool IsLabelVisible(unsigned short label);
+
+	int RequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+	int FillInputPortInformation(int port, vtkInformation *info) override;
+
+private:
+	vtkImageSliceOutlines(const vtkImageSliceOutlines&) = delete;
+	void operator=(const vtkImageSliceOutlines&) = delete;
+};
+
+#endif